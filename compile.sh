@@ -1,3 +1,14 @@
 #!/bin/sh
 
-gcc src/*.c -o riscv_sim
+# libriscv_sim: everything but the command line, see src/include/sim.h
+mkdir -p obj
+for f in $(ls src/*.c | grep -v src/main.c); do
+  gcc -O2 -c $f -o obj/$(basename $f .c).o
+done
+rm -f libriscv_sim.a
+ar rcs libriscv_sim.a obj/*.o
+
+gcc -O2 src/main.c libriscv_sim.a -o riscv_sim -lpthread
+gcc -O2 tools/trace2log.c libriscv_sim.a -o trace2log -lpthread
+gcc -O2 tools/bench_logfmt.c libriscv_sim.a -o bench_logfmt -lpthread
+gcc -O2 tools/bench_mem.c -o bench_mem
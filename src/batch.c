@@ -0,0 +1,251 @@
+#include "include/batch.h"
+#include <time.h>
+#include <unistd.h>
+
+static void *batch_thread(void *arg);
+
+static uint64_t batch_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+/* path with its ".bin" replaced by ext, and by ".copy" ext for the copies of a binary listed again */
+static char *batch_name(const char *path, uint32_t copy, const char *ext) {
+  size_t len = strlen(path);
+  if (len > 4 && strcmp(path + len - 4, ".bin") == 0) len -= 4;
+  char *name = (char *)malloc(len + strlen(ext) + 12);
+  if (name == NULL) return NULL;
+  memcpy(name, path, len);
+  if (copy) sprintf(name + len, ".%u%s", copy, ext);
+  else strcpy(name + len, ext);
+  return name;
+}
+
+
+int batch_create(BATCH *batch, const SIM_CONFIG *config, uint64_t max_insts, int threads) {
+
+  if (batch == NULL || config == NULL) return -1;
+
+  if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads <= 0) threads = 1;
+  if (threads > BATCH_MAX_THREADS) threads = BATCH_MAX_THREADS;
+  memset(batch, 0, sizeof(BATCH));
+  batch->config = *config;
+  // the jobs already run in parallel, each one formats its log alone
+  if (batch->config.log_threads == 0) batch->config.log_threads = 1;
+  batch->max_insts = max_insts;
+  batch->num_threads = threads;
+  batch->workers = (BATCH_WORKER *)calloc(threads, sizeof(BATCH_WORKER));
+  if (batch->workers == NULL) return -2;
+  for (int i = 0; i < threads; i++) {
+    batch->workers[i].batch = batch;
+    batch->workers[i].index = i;
+    pthread_mutex_init(&batch->workers[i].queue.lock, NULL);
+  }
+  return 0;
+}
+
+
+int batch_add(BATCH *batch, const char *path) {
+
+  if (batch->num_jobs == batch->max_jobs) {
+    uint32_t max = batch->max_jobs ? 2 * batch->max_jobs : 64;
+    BATCH_JOB *grown = (BATCH_JOB *)realloc(batch->jobs, max * sizeof(BATCH_JOB));
+    if (grown == NULL) return -2;
+    batch->jobs = grown;
+    batch->max_jobs = max;
+  }
+  // each job writes files of its own, even for the same binary
+  uint32_t copy = 0;
+  for (uint32_t j = 0; j < batch->num_jobs; j++) copy += strcmp(batch->jobs[j].path, path) == 0;
+  BATCH_JOB *job = &batch->jobs[batch->num_jobs];
+  memset(job, 0, sizeof(BATCH_JOB));
+  job->path = strdup(path);
+  job->log_path = batch_name(path, copy, batch->config.log_format == TRACE_BIN ? ".log.bin" : ".log.txt");
+  job->out_path = batch_name(path, copy, ".out");
+  if (job->path == NULL || job->log_path == NULL || job->out_path == NULL) {
+    free(job->path);
+    free(job->log_path);
+    free(job->out_path);
+    return -2;
+  }
+  batch->num_jobs++;
+  return 0;
+}
+
+
+int batch_add_manifest(BATCH *batch, const char *path) {
+  char line[4096], full[8192];
+  const char *slash = strrchr(path, '/');
+  int dir = slash ? (int)(slash - path + 1) : 0;     // length of the directory of the manifest
+
+  FILE *file = fopen(path, "r");
+  if (file == NULL) return -1;
+  while (fgets(line, sizeof(line), file)) {
+    // trim the line, skip comments and blank lines
+    char *p = line, *end = line + strlen(line);
+    while (*p == ' ' || *p == '\t') p++;
+    while (end > p && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) end--;
+    *end = 0;
+    if (*p == 0 || *p == '#') continue;
+    if (*p == '/') snprintf(full, sizeof(full), "%s", p);
+    else snprintf(full, sizeof(full), "%.*s%s", dir, path, p);
+    if (batch_add(batch, full) != 0) {
+      fclose(file);
+      return -2;
+    }
+  }
+  fclose(file);
+  return 0;
+}
+
+
+/* next job of a worker: the front of its queue, else the back of another one */
+static int batch_take(BATCH_WORKER *w, uint32_t *job) {
+  BATCH *batch = w->batch;
+  int found = 0;
+
+  pthread_mutex_lock(&w->queue.lock);
+  if (w->queue.head < w->queue.tail) {
+    *job = w->queue.jobs[w->queue.head++];
+    found = 1;
+  }
+  pthread_mutex_unlock(&w->queue.lock);
+  if (found) return 1;
+
+  for (int i = 1; i < batch->num_active && !found; i++) {
+    BATCH_QUEUE *q = &batch->workers[(w->index + i) % batch->num_active].queue;
+    pthread_mutex_lock(&q->lock);
+    if (q->head < q->tail) {
+      *job = q->jobs[--q->tail];
+      found = 1;
+    }
+    pthread_mutex_unlock(&q->lock);
+  }
+  if (found) w->steals++;
+  return found;
+}
+
+
+/* one guest binary from start to end */
+static void batch_job(BATCH_WORKER *w, BATCH_JOB *job) {
+  SIM_CONFIG config = w->batch->config;
+  uint64_t start = batch_now_ns();
+
+  config.log_path = job->log_path;
+  config.out_path = job->out_path;
+  job->thread = w->index;
+  SIM *sim = (SIM *)malloc(sizeof(SIM));
+  if (sim == NULL) {
+    job->error = -2;
+    return;
+  }
+  job->error = sim_create(sim, &config);
+  if (job->error == 0) job->error = sim_load_file(sim, job->path);
+  if (job->error == 0) {
+    job->status = sim_run(sim, w->batch->max_insts);
+    if (job->status == SIM_FAULT) {
+      job->fault_addr = sim->ram->fault_addr;
+      job->fault_pc = sim_get_pc(sim);
+    }
+    sim_finish(sim);
+    job->insts = sim->insts;
+    job->exit_code = sim_exit_code(sim);
+  }
+  sim_destroy(sim);
+  job->wall_ns = batch_now_ns() - start;
+}
+
+
+static void *batch_thread(void *arg) {
+  BATCH_WORKER *w = (BATCH_WORKER *)arg;
+  uint32_t job;
+
+  while (batch_take(w, &job)) batch_job(w, &w->batch->jobs[job]);
+  return NULL;
+}
+
+
+int batch_run(BATCH *batch) {
+  int threads = batch->num_threads;
+  uint64_t start = batch_now_ns();
+
+  if (batch->num_jobs == 0) return 0;
+  // no more threads than jobs
+  if ((uint32_t)threads > batch->num_jobs) threads = batch->num_jobs;
+  batch->num_active = threads;
+
+  // deal the jobs in turn, so the start of the list is taken first
+  for (int i = 0; i < threads; i++) {
+    BATCH_QUEUE *q = &batch->workers[i].queue;
+    q->jobs = (uint32_t *)malloc((batch->num_jobs / threads + 1) * sizeof(uint32_t));
+    if (q->jobs == NULL) return -2;
+    q->head = q->tail = 0;
+  }
+  for (uint32_t j = 0; j < batch->num_jobs; j++) {
+    BATCH_QUEUE *q = &batch->workers[j % threads].queue;
+    q->jobs[q->tail++] = j;
+  }
+
+  // worker 0 is the calling thread
+  int started = 1;
+  for (; started < threads; started++) {
+    if (pthread_create(&batch->workers[started].thread, NULL, batch_thread, &batch->workers[started]) != 0) break;
+  }
+  // the jobs of the threads not started are stolen by the others
+  batch_thread(&batch->workers[0]);
+  for (int i = 1; i < started; i++) pthread_join(batch->workers[i].thread, NULL);
+  batch->wall_ns = batch_now_ns() - start;
+  return 0;
+}
+
+
+uint32_t batch_report(BATCH *batch, FILE *out) {
+  uint64_t insts = 0, busy_ns = 0, slowest_ns = 0, steals = 0;
+  uint32_t failed = 0;
+
+  fprintf(out, "job  thread  result           instructions      wall ms     MIPS  binary\n");
+  for (uint32_t j = 0; j < batch->num_jobs; j++) {
+    BATCH_JOB *job = &batch->jobs[j];
+    char result[32];
+    if (job->error) snprintf(result, sizeof(result), "error %d", job->error);
+    else if (job->status == SIM_FAULT) snprintf(result, sizeof(result), "fault %08x", job->fault_addr);
+    else if (job->status == SIM_RUNNING) snprintf(result, sizeof(result), "stopped");
+    else snprintf(result, sizeof(result), "exit %d", job->exit_code);
+    if (job->error || job->status == SIM_FAULT || (job->status == SIM_EXITED && job->exit_code != 0)) failed++;
+    fprintf(out, "%3u  %6d  %-16s %12llu %12.3f %8.2f  %s\n", j, job->thread, result,
+            (unsigned long long)job->insts, job->wall_ns / 1e6,
+            job->wall_ns ? job->insts * 1e3 / job->wall_ns : 0.0, job->path);
+    if (job->status == SIM_FAULT) fprintf(out, "     guest access fault at address %08x, PC=%08x\n", job->fault_addr, job->fault_pc);
+    insts += job->insts;
+    busy_ns += job->wall_ns;
+    if (job->wall_ns > slowest_ns) slowest_ns = job->wall_ns;
+  }
+  for (int i = 0; i < batch->num_active; i++) steals += batch->workers[i].steals;
+  fprintf(out, "jobs:                %u, %u failed\n", batch->num_jobs, failed);
+  fprintf(out, "threads:             %d, %llu jobs stolen\n", batch->num_active, (unsigned long long)steals);
+  fprintf(out, "instructions:        %llu\n", (unsigned long long)insts);
+  fprintf(out, "wall time:           %.3f ms, slowest job %.3f ms, jobs one after the other %.3f ms\n",
+          batch->wall_ns / 1e6, slowest_ns / 1e6, busy_ns / 1e6);
+  fprintf(out, "aggregate MIPS:      %.2f\n", batch->wall_ns ? insts * 1e3 / batch->wall_ns : 0.0);
+  return failed;
+}
+
+
+void batch_dispose(BATCH *batch) {
+
+  for (uint32_t j = 0; j < batch->num_jobs; j++) {
+    free(batch->jobs[j].path);
+    free(batch->jobs[j].log_path);
+    free(batch->jobs[j].out_path);
+  }
+  free(batch->jobs);
+  for (int i = 0; batch->workers && i < batch->num_threads; i++) {
+    pthread_mutex_destroy(&batch->workers[i].queue.lock);
+    free(batch->workers[i].queue.jobs);
+  }
+  free(batch->workers);
+  free(batch);
+}
@@ -0,0 +1,176 @@
+#include "include/block.h"
+#include "include/predecode.h"
+
+static inline uint32_t block_hash(uint32_t pc) {
+  return (pc >> 2) & ((1 << BLOCK_HASH_BITS) - 1);
+}
+
+/* control transfers end a block, and system calls which may end the run */
+static int block_ends(uint8_t op) {
+  switch (op) {
+  case OP_JAL: case OP_JALR:
+  case OP_BEQ: case OP_BNE: case OP_BLT: case OP_BGE: case OP_BLTU: case OP_BGEU:
+  case OP_ECALL:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static BLOCK *block_translate(BLOCK_CACHE *bc, uint32_t pc);
+
+
+int block_create(BLOCK_CACHE *bc, PREDECODE *pd) {
+
+  if (bc == NULL) return -1;
+
+  memset(bc, 0, sizeof(BLOCK_CACHE));
+  bc->num_pages = pd->num_pages;
+  bc->pages = (BLOCK **)calloc(bc->num_pages ? bc->num_pages : 1, sizeof(BLOCK *));
+  if (bc->pages == NULL) return -2;
+  bc->pd = pd;
+  return 0;
+}
+
+
+BLOCK *block_lookup(BLOCK_CACHE *bc, uint32_t pc) {
+
+  for (BLOCK *b = bc->hash[block_hash(pc)]; b; b = b->hash_next) {
+    if (b->pc == pc) {
+      bc->hashed++;
+      return b;
+    }
+  }
+  return block_translate(bc, pc);
+}
+
+
+static BLOCK *block_translate(BLOCK_CACHE *bc, uint32_t pc) {
+  PREDECODE *pd = bc->pd;
+  uint32_t page = pc >> PREDECODE_PAGE_BITS;
+  uint32_t len = 0;
+  BLOCK *b;
+
+  // same end condition as the main loop, checked once when translating
+  if ((uint64_t)pc + 4 > pd->limit) return NULL;
+
+  b = (BLOCK *)malloc(sizeof(BLOCK) + (BLOCK_MAX_INSTS + 1) * sizeof(DECODED));
+  if (b == NULL) return NULL;
+
+  for (uint32_t a = pc; len < BLOCK_MAX_INSTS; a += 4) {
+    // instructions must lie in the page of the block and before the end of the code
+    if ((uint64_t)a + 4 > pd->limit || ((a + 3) >> PREDECODE_PAGE_BITS) != page) break;
+    b->uops[len] = *predecode_fetch(pd, a);
+    if (block_ends(b->uops[len++].op)) break;
+  }
+  memset(&b->uops[len], 0, sizeof(DECODED));
+  b->uops[len].op = OP_LOOKUP;
+  if (pd->labels) b->uops[len].label = pd->labels[OP_LOOKUP];
+  // keep only the micro-ops used
+  BLOCK *fit = (BLOCK *)realloc(b, sizeof(BLOCK) + (len + 1) * sizeof(DECODED));
+  if (fit) b = fit;
+
+  b->pc = pc;
+  b->len = len;
+  b->execs = 0;
+  memset(b->next, 0, sizeof(b->next));
+  b->in = NULL;
+  b->native = NULL;
+  b->hash_next = bc->hash[block_hash(pc)];
+  bc->hash[block_hash(pc)] = b;
+  b->page_next = bc->pages[page];
+  bc->pages[page] = b;
+
+  bc->translated++;
+  bc->translated_insts += len;
+  return b;
+}
+
+
+void block_invalidate(BLOCK_CACHE *bc, uint32_t addr, uint8_t size) {
+  uint32_t page = addr >> PREDECODE_PAGE_BITS;
+  uint32_t end = addr + (size >> 3);
+
+  if (page >= bc->num_pages) return;
+
+  for (BLOCK **pb = &bc->pages[page]; *pb; ) {
+    BLOCK *b = *pb;
+    if (addr < b->pc + 4 * b->len && end > b->pc) {
+      // unlink from page list and hash bucket
+      *pb = b->page_next;
+      for (BLOCK **hb = &bc->hash[block_hash(b->pc)]; *hb; hb = &(*hb)->hash_next) {
+        if (*hb == b) {
+          *hb = b->hash_next;
+          break;
+        }
+      }
+      // and from the chains, to it (maybe its own) and from it
+      for (BLOCK_LINK *l = b->in; l; l = l->in_next) l->to = NULL;
+      b->in = NULL;
+      block_chain(&b->next[0], NULL);
+      block_chain(&b->next[1], NULL);
+      bc->invalidated++;
+      // the running block is still read by the engine, until it leaves it
+      if (b == bc->running) {
+        bc->dead = b;
+        bc->left = 1;
+      } else {
+        free(b);
+      }
+    } else {
+      pb = &b->page_next;
+    }
+  }
+}
+
+
+void block_free_dead(BLOCK_CACHE *bc) {
+
+  free(bc->dead);
+  bc->dead = NULL;
+  bc->left = 0;
+}
+
+
+void block_drop_native(BLOCK_CACHE *bc) {
+
+  // counted again from 0, so the hot blocks reach the threshold and are compiled again
+  for (uint32_t i = 0; i < (1u << BLOCK_HASH_BITS); i++)
+    for (BLOCK *b = bc->hash[i]; b; b = b->hash_next) {
+      b->native = NULL;
+      b->execs = 0;
+    }
+  if (bc->dead) {
+    bc->dead->native = NULL;
+    bc->dead->execs = 0;
+  }
+}
+
+
+void block_stats(BLOCK_CACHE *bc, uint64_t insts, FILE *out) {
+  uint64_t hits = bc->chained + bc->hashed;
+
+  fprintf(out, "blocks entered:      %llu\n", (unsigned long long)bc->entered);
+  fprintf(out, "block hit rate:      %.2f%% (chained %.2f%%, hash %.2f%%)\n",
+          bc->entered ? 100.0 * hits / bc->entered : 0.0,
+          bc->entered ? 100.0 * bc->chained / bc->entered : 0.0,
+          bc->entered ? 100.0 * bc->hashed / bc->entered : 0.0);
+  fprintf(out, "blocks translated:   %llu (avg %.2f insts)\n", (unsigned long long)bc->translated,
+          bc->translated ? (double)bc->translated_insts / bc->translated : 0.0);
+  fprintf(out, "avg executed block:  %.2f insts\n", bc->entered ? (double)insts / bc->entered : 0.0);
+  fprintf(out, "blocks invalidated:  %llu\n", (unsigned long long)bc->invalidated);
+}
+
+
+void block_dispose(BLOCK_CACHE *bc) {
+
+  for (uint32_t i = 0; i < (1u << BLOCK_HASH_BITS); i++) {
+    for (BLOCK *b = bc->hash[i], *n; b; b = n) {
+      n = b->hash_next;
+      free(b);
+    }
+  }
+  free(bc->dead);
+  free(bc->pages);
+  free(bc);
+}
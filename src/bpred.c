@@ -0,0 +1,443 @@
+#include "include/bpred.h"
+
+#define BPRED_PCS_INIT      1024        // entries of the branch table at first
+
+#define TAGE_TABLES         4
+#define TAGE_TAG_BITS       9
+#define TAGE_AGING          (1u << 18)  // branches between two halvings of the useful counters
+
+/* history lengths of the tagged tables, geometric up to the 64 branches kept */
+static const uint32_t tage_lengths[TAGE_TABLES] = {5, 12, 27, 64};
+
+static const char *bpred_kinds[] = {"bimodal", "gshare", "tage"};
+
+
+/* 2-bit saturating counter, taken from 2 */
+static inline void bpred_count(uint8_t *ctr, int taken) {
+  if (taken) {
+    if (*ctr < 3) (*ctr)++;
+  } else if (*ctr > 0) {
+    (*ctr)--;
+  }
+}
+
+
+/* Bimodal */
+
+typedef struct {
+  PREDICTOR pred;       // first, the predictor is used through it
+  uint32_t mask;
+  uint8_t *ctr;
+} BIMODAL;
+
+static int bimodal_predict(PREDICTOR *pred, uint32_t pc) {
+  BIMODAL *b = (BIMODAL *)pred;
+  return b->ctr[(pc >> 2) & b->mask] >= 2;
+}
+
+static void bimodal_update(PREDICTOR *pred, uint32_t pc, int taken) {
+  BIMODAL *b = (BIMODAL *)pred;
+  bpred_count(&b->ctr[(pc >> 2) & b->mask], taken);
+}
+
+
+/* Gshare */
+
+typedef struct {
+  PREDICTOR pred;
+  uint32_t mask;
+  uint32_t hist;        // outcomes of the last branches, the last one in bit 0
+  uint8_t *ctr;
+} GSHARE;
+
+static int gshare_predict(PREDICTOR *pred, uint32_t pc) {
+  GSHARE *g = (GSHARE *)pred;
+  return g->ctr[((pc >> 2) ^ g->hist) & g->mask] >= 2;
+}
+
+static void gshare_update(PREDICTOR *pred, uint32_t pc, int taken) {
+  GSHARE *g = (GSHARE *)pred;
+  bpred_count(&g->ctr[((pc >> 2) ^ g->hist) & g->mask], taken);
+  g->hist = ((g->hist << 1) | (uint32_t)taken) & g->mask;
+}
+
+
+/* TAGE: the longest history with a matching tag predicts, the base when none does */
+
+typedef struct {
+  uint16_t tag;
+  int8_t ctr;           // -4 to 3, taken from 0
+  uint8_t u;            // useful, 0 to 3, only entries not useful are replaced
+} TAGE_ENTRY;
+
+typedef struct {
+  PREDICTOR pred;
+  uint32_t bits;        // log2 of the base counters, the tagged tables have a quarter of it
+  uint8_t *base;
+  TAGE_ENTRY *tables[TAGE_TABLES];
+  uint64_t hist;        // outcomes of the last 64 branches, the last one in bit 0
+  uint32_t branches;    // until the next aging
+  /* the branch being predicted */
+  uint32_t index[TAGE_TABLES];
+  uint32_t tag[TAGE_TABLES];
+  int provider;         // table of the prediction, -1 for the base
+  int taken;            // prediction given
+  int alt_taken;        // prediction without the provider
+} TAGE;
+
+/* the last len outcomes of the history folded to bits */
+static inline uint32_t tage_fold(uint64_t hist, uint32_t len, uint32_t bits) {
+  if (len < 64) hist &= (1ull << len) - 1;
+  uint32_t fold = 0;
+  for (; hist; hist >>= bits) fold ^= (uint32_t)hist & ((1u << bits) - 1);
+  return fold;
+}
+
+static int tage_predict(PREDICTOR *pred, uint32_t pc) {
+  TAGE *t = (TAGE *)pred;
+  uint32_t bits = t->bits - 2;
+  int alt = -1;
+
+  t->provider = -1;
+  for (int i = TAGE_TABLES - 1; i >= 0; i--) {
+    uint32_t len = tage_lengths[i];
+    t->index[i] = ((pc >> 2) ^ (pc >> (2 + bits)) ^ tage_fold(t->hist, len, bits)) & ((1u << bits) - 1);
+    t->tag[i] = ((pc >> 2) ^ tage_fold(t->hist, len, TAGE_TAG_BITS) ^
+                 (tage_fold(t->hist, len, TAGE_TAG_BITS - 1) << 1)) & ((1u << TAGE_TAG_BITS) - 1);
+    if (t->tables[i][t->index[i]].tag != t->tag[i]) continue;
+    if (t->provider < 0) t->provider = i;
+    else if (alt < 0) alt = i;
+  }
+  int base = t->base[(pc >> 2) & ((1u << t->bits) - 1)] >= 2;
+  t->alt_taken = alt >= 0 ? t->tables[alt][t->index[alt]].ctr >= 0 : base;
+  if (t->provider < 0) return t->taken = base;
+  const TAGE_ENTRY *e = &t->tables[t->provider][t->index[t->provider]];
+  // an entry just allocated is not trusted yet
+  if (e->u == 0 && (e->ctr == 0 || e->ctr == -1)) return t->taken = t->alt_taken;
+  return t->taken = e->ctr >= 0;
+}
+
+static void tage_update(PREDICTOR *pred, uint32_t pc, int taken) {
+  TAGE *t = (TAGE *)pred;
+  int p = t->provider;
+
+  if (p >= 0) {
+    TAGE_ENTRY *e = &t->tables[p][t->index[p]];
+    if ((e->ctr >= 0) != t->alt_taken) {
+      if ((e->ctr >= 0) == taken) {
+        if (e->u < 3) e->u++;
+      } else if (e->u > 0) {
+        e->u--;
+      }
+    }
+    if (taken && e->ctr < 3) e->ctr++;
+    else if (!taken && e->ctr > -4) e->ctr--;
+  } else {
+    bpred_count(&t->base[(pc >> 2) & ((1u << t->bits) - 1)], taken);
+  }
+
+  /* a misprediction takes an entry of a longer history, else makes them less useful */
+  if (t->taken != taken && p < TAGE_TABLES - 1) {
+    int i = p + 1;
+    while (i < TAGE_TABLES && t->tables[i][t->index[i]].u) i++;
+    if (i < TAGE_TABLES) {
+      TAGE_ENTRY *e = &t->tables[i][t->index[i]];
+      e->tag = (uint16_t)t->tag[i];
+      e->ctr = taken ? 0 : -1;
+      e->u = 0;
+    } else {
+      for (i = p + 1; i < TAGE_TABLES; i++) t->tables[i][t->index[i]].u--;
+    }
+  }
+  if (++t->branches == TAGE_AGING) {
+    t->branches = 0;
+    for (int i = 0; i < TAGE_TABLES; i++)
+      for (uint32_t j = 0; j < (1u << (t->bits - 2)); j++) t->tables[i][j].u >>= 1;
+  }
+  t->hist = (t->hist << 1) | (uint64_t)taken;
+}
+
+
+static void bimodal_dispose(PREDICTOR *pred) {
+  BIMODAL *b = (BIMODAL *)pred;
+  free(b->ctr);
+  free(b);
+}
+
+static void gshare_dispose(PREDICTOR *pred) {
+  GSHARE *g = (GSHARE *)pred;
+  free(g->ctr);
+  free(g);
+}
+
+static void tage_dispose(PREDICTOR *pred) {
+  TAGE *t = (TAGE *)pred;
+  free(t->base);
+  for (int i = 0; i < TAGE_TABLES; i++) free(t->tables[i]);
+  free(t);
+}
+
+
+/* a predictor of 2^bits counters, weakly not taken; NULL when it can not be allocated */
+static PREDICTOR *bpred_predictor(BPRED_KIND kind, uint32_t bits) {
+  size_t n = (size_t)1 << bits;
+
+  if (kind == BPRED_BIMODAL) {
+    BIMODAL *b = (BIMODAL *)calloc(1, sizeof(BIMODAL));
+    if (b == NULL || (b->ctr = (uint8_t *)malloc(n)) == NULL) {
+      free(b);
+      return NULL;
+    }
+    memset(b->ctr, 1, n);
+    b->mask = (uint32_t)n - 1;
+    b->pred.predict = bimodal_predict;
+    b->pred.update = bimodal_update;
+    b->pred.dispose = bimodal_dispose;
+    return &b->pred;
+  }
+  if (kind == BPRED_GSHARE) {
+    GSHARE *g = (GSHARE *)calloc(1, sizeof(GSHARE));
+    if (g == NULL || (g->ctr = (uint8_t *)malloc(n)) == NULL) {
+      free(g);
+      return NULL;
+    }
+    memset(g->ctr, 1, n);
+    g->mask = (uint32_t)n - 1;
+    g->pred.predict = gshare_predict;
+    g->pred.update = gshare_update;
+    g->pred.dispose = gshare_dispose;
+    return &g->pred;
+  }
+  TAGE *t = (TAGE *)calloc(1, sizeof(TAGE));
+  if (t == NULL) return NULL;
+  t->bits = bits;
+  t->pred.predict = tage_predict;
+  t->pred.update = tage_update;
+  t->pred.dispose = tage_dispose;
+  t->base = (uint8_t *)malloc(n);
+  int failed = t->base == NULL;
+  for (int i = 0; i < TAGE_TABLES; i++) {
+    // tag 0 of an empty entry matches, as an entry not useful yet
+    t->tables[i] = (TAGE_ENTRY *)calloc(n / 4, sizeof(TAGE_ENTRY));
+    failed |= t->tables[i] == NULL;
+  }
+  if (failed) {
+    tage_dispose(&t->pred);
+    return NULL;
+  }
+  memset(t->base, 1, n);
+  return &t->pred;
+}
+
+
+int bpred_parse(BPRED_CONFIG *config, const char *text) {
+  char *end;
+
+  config->num = 0;
+  while (*text) {
+    if (config->num == BPRED_MAX) return -1;
+    size_t len = strcspn(text, ":,");
+    int kind = -1;
+    for (int k = 0; k < 3; k++)
+      if (strlen(bpred_kinds[k]) == len && strncmp(text, bpred_kinds[k], len) == 0) kind = k;
+    if (kind < 0) return -1;
+    uint32_t bits = BPRED_BITS;
+    text += len;
+    if (*text == ':') {
+      bits = strtoul(text + 1, &end, 0);
+      if (end == text + 1) return -1;
+      text = end;
+    }
+    // the tagged tables of TAGE have a quarter of the entries
+    if (bits < (kind == BPRED_TAGE ? 6 : 1) || bits > 24) return -1;
+    config->kind[config->num] = (BPRED_KIND)kind;
+    config->bits[config->num++] = bits;
+    if (*text == ',' && text[1]) text++;
+    else if (*text) return -1;
+  }
+  return config->num ? 0 : -1;
+}
+
+
+int bpred_create(BPRED *bpred, const BPRED_CONFIG *config) {
+  const BPRED_CONFIG *c = config;
+
+  if (bpred == NULL || c == NULL) return -1;
+  memset(bpred, 0, sizeof(BPRED));
+  if (c->num == 0 || c->num > BPRED_MAX || c->btb == 0 || (c->btb & (c->btb - 1)) || c->ras == 0) return -1;
+
+  bpred->config = *c;
+  for (uint32_t i = 0; i < c->num; i++) {
+    if (c->kind[i] > BPRED_TAGE || c->bits[i] < (c->kind[i] == BPRED_TAGE ? 6 : 1) || c->bits[i] > 24) return -1;
+    bpred->preds[i] = bpred_predictor(c->kind[i], c->bits[i]);
+    if (bpred->preds[i] == NULL) return -2;
+    snprintf(bpred->names[i], sizeof(bpred->names[i]), "%s:%u", bpred_kinds[c->kind[i]], c->bits[i]);
+    bpred->preds[i]->name = bpred->names[i];
+  }
+  bpred->btb_pc = (uint32_t *)malloc(c->btb * sizeof(uint32_t));
+  bpred->btb_target = (uint32_t *)calloc(c->btb, sizeof(uint32_t));
+  bpred->ras = (uint32_t *)calloc(c->ras, sizeof(uint32_t));
+  bpred->max_pcs = BPRED_PCS_INIT;
+  bpred->pcs = (BPRED_PC *)calloc(bpred->max_pcs, sizeof(BPRED_PC));
+  if (bpred->btb_pc == NULL || bpred->btb_target == NULL || bpred->ras == NULL || bpred->pcs == NULL) return -2;
+  memset(bpred->btb_pc, 0xFF, c->btb * sizeof(uint32_t));
+  return 0;
+}
+
+
+/* counts of the branch at pc, NULL when they can not be kept */
+static BPRED_PC *bpred_pc(BPRED *bpred, uint32_t pc) {
+  uint32_t mask = bpred->max_pcs - 1;
+  uint32_t h = (pc >> 2) * 2654435761u & mask;
+
+  while (bpred->pcs[h].used && bpred->pcs[h].pc != pc) h = (h + 1) & mask;
+  if (bpred->pcs[h].used) return &bpred->pcs[h];
+  if (2 * (bpred->num_pcs + 1) > bpred->max_pcs) {
+    // grow at half full, branches that do not fit are dropped from the statistics only
+    BPRED_PC *grown = (BPRED_PC *)calloc(2 * bpred->max_pcs, sizeof(BPRED_PC));
+    if (grown) {
+      uint32_t gmask = 2 * bpred->max_pcs - 1;
+      for (uint32_t i = 0; i < bpred->max_pcs; i++) {
+        if (!bpred->pcs[i].used) continue;
+        uint32_t g = (bpred->pcs[i].pc >> 2) * 2654435761u & gmask;
+        while (grown[g].used) g = (g + 1) & gmask;
+        grown[g] = bpred->pcs[i];
+      }
+      free(bpred->pcs);
+      bpred->pcs = grown;
+      bpred->max_pcs *= 2;
+      mask = gmask;
+      h = (pc >> 2) * 2654435761u & mask;
+      while (bpred->pcs[h].used) h = (h + 1) & mask;
+    } else if (bpred->num_pcs + 1 >= bpred->max_pcs) {
+      return NULL;
+    }
+  }
+  bpred->pcs[h].used = 1;
+  bpred->pcs[h].pc = pc;
+  bpred->num_pcs++;
+  return &bpred->pcs[h];
+}
+
+
+void bpred_branch(BPRED *bpred, const DECODED *dec, uint32_t pc, uint32_t next_pc) {
+  const BPRED_CONFIG *c = &bpred->config;
+  BPRED_PC *e = bpred_pc(bpred, pc);
+  int taken = next_pc != pc + 4;
+  int link = dec->op <= OP_JALR && (dec->rd == 1 || dec->rd == 5);
+
+  if (e) {
+    e->execs++;
+    e->taken += dec->op <= OP_JALR || taken;
+  }
+
+  /* direction of the conditional branches, by each predictor */
+  if (dec->op >= OP_BEQ) {
+    bpred->branches++;
+    bpred->taken += taken;
+    for (uint32_t i = 0; i < c->num; i++) {
+      PREDICTOR *pred = bpred->preds[i];
+      if (pred->predict(pred, pc) != taken) {
+        bpred->misses[i]++;
+        if (e) e->misses[i]++;
+      }
+      pred->update(pred, pc, taken);
+    }
+    if (!taken) return;
+  }
+
+  /* target: returns pop the RAS, the others are looked up in the BTB */
+  if (dec->op == OP_JALR && (dec->rs1 == 1 || dec->rs1 == 5) && !(link && dec->rd == dec->rs1)) {
+    bpred->returns++;
+    int hit = 0;
+    if (bpred->ras_count) {
+      bpred->ras_top = (bpred->ras_top + c->ras - 1) % c->ras;
+      bpred->ras_count--;
+      hit = bpred->ras[bpred->ras_top] == next_pc;
+    }
+    if (!hit) {
+      bpred->ras_misses++;
+      if (e) e->targets++;
+    }
+  } else {
+    uint32_t i = (pc >> 2) & (c->btb - 1);
+    bpred->jumps++;
+    if (bpred->btb_pc[i] != pc || bpred->btb_target[i] != next_pc) {
+      bpred->btb_misses++;
+      if (e) e->targets++;
+      bpred->btb_pc[i] = pc;
+      bpred->btb_target[i] = next_pc;
+    }
+  }
+  // a call, or the second half of a coroutine swap, pushes its return address
+  if (link) {
+    bpred->ras[bpred->ras_top] = pc + 4;
+    bpred->ras_top = (bpred->ras_top + 1) % c->ras;
+    if (bpred->ras_count < c->ras) bpred->ras_count++;
+  }
+}
+
+
+/* mispredictions of a branch, of all the predictors and of its targets */
+static uint64_t bpred_pc_misses(const BPRED_PC *e) {
+  uint64_t misses = e->targets;
+  for (uint32_t i = 0; i < BPRED_MAX; i++) misses += e->misses[i];
+  return misses;
+}
+
+static int bpred_pc_cmp(const void *a, const void *b) {
+  const BPRED_PC *x = (const BPRED_PC *)a, *y = (const BPRED_PC *)b;
+  uint64_t mx = bpred_pc_misses(x), my = bpred_pc_misses(y);
+  if (mx != my) return mx < my ? 1 : -1;
+  return x->pc < y->pc ? -1 : x->pc > y->pc;
+}
+
+
+void bpred_stats(BPRED *bpred, FILE *out) {
+  const BPRED_CONFIG *c = &bpred->config;
+  double kilo = bpred->insts ? bpred->insts / 1000.0 : 1.0;
+
+  fprintf(out, "cond. branches:      %llu, %llu taken (%.2f%%)\n", (unsigned long long)bpred->branches,
+          (unsigned long long)bpred->taken, bpred->branches ? 100.0 * bpred->taken / bpred->branches : 0.0);
+  for (uint32_t i = 0; i < c->num; i++) {
+    fprintf(out, "%-20s %llu mispredicted (%.2f%%), %.2f MPKI\n", bpred->names[i],
+            (unsigned long long)bpred->misses[i],
+            bpred->branches ? 100.0 * bpred->misses[i] / bpred->branches : 0.0, bpred->misses[i] / kilo);
+  }
+  fprintf(out, "BTB:                 %u entries, %llu taken branches and jumps, %llu targets missed (%.2f%%)\n",
+          c->btb, (unsigned long long)bpred->jumps, (unsigned long long)bpred->btb_misses,
+          bpred->jumps ? 100.0 * bpred->btb_misses / bpred->jumps : 0.0);
+  fprintf(out, "RAS:                 %u entries, %llu returns, %llu mispredicted (%.2f%%)\n",
+          c->ras, (unsigned long long)bpred->returns, (unsigned long long)bpred->ras_misses,
+          bpred->returns ? 100.0 * bpred->ras_misses / bpred->returns : 0.0);
+  if (bpred->num_pcs == 0) return;
+
+  BPRED_PC *top = (BPRED_PC *)malloc(bpred->num_pcs * sizeof(BPRED_PC));
+  if (top == NULL) return;
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < bpred->max_pcs; i++)
+    if (bpred->pcs[i].used) top[n++] = bpred->pcs[i];
+  qsort(top, n, sizeof(BPRED_PC), bpred_pc_cmp);
+  fprintf(out, "mispredictions by PC:\n  %-8s %12s %7s", "PC", "executed", "taken");
+  for (uint32_t i = 0; i < c->num; i++) fprintf(out, " %12s", bpred->names[i]);
+  fprintf(out, " %12s\n", "target");
+  for (uint32_t i = 0; i < n && i < BPRED_TOP_PCS && bpred_pc_misses(&top[i]); i++) {
+    fprintf(out, "  %08x %12llu %6.1f%%", top[i].pc, (unsigned long long)top[i].execs,
+            100.0 * top[i].taken / top[i].execs);
+    for (uint32_t j = 0; j < c->num; j++) fprintf(out, " %12llu", (unsigned long long)top[i].misses[j]);
+    fprintf(out, " %12llu\n", (unsigned long long)top[i].targets);
+  }
+  free(top);
+}
+
+
+void bpred_dispose(BPRED *bpred) {
+
+  for (uint32_t i = 0; i < BPRED_MAX; i++)
+    if (bpred->preds[i]) bpred->preds[i]->dispose(bpred->preds[i]);
+  free(bpred->btb_pc);
+  free(bpred->btb_target);
+  free(bpred->ras);
+  free(bpred->pcs);
+  free(bpred);
+}
@@ -0,0 +1,105 @@
+#include "include/bus.h"
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t bus_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+/* UART: bytes sent go to the output buffer, it is always ready */
+static uint32_t bus_uart_load(void *dev, uint32_t offset, uint8_t size) {
+  (void)dev; (void)size;
+  return offset == 4 ? 1 : 0;
+}
+
+static void bus_uart_store(void *dev, uint32_t offset, uint32_t value, uint8_t size) {
+  LOGFMT_OUT *out = &((BUS *)dev)->uart;
+  (void)size;
+
+  if (offset != 0) return;
+  if (out->len == out->size) logfmt_out_flush(out);
+  out->buf[out->len++] = (char)value;
+}
+
+
+/* Timer: 64-bit nanoseconds read as two words, low word first */
+static uint32_t bus_timer_load(void *dev, uint32_t offset, uint8_t size) {
+  BUS *bus = (BUS *)dev;
+  (void)size;
+
+  if (offset == 0) {
+    uint64_t t = bus_now_ns() - bus->start_ns;
+    bus->timer_hi = (uint32_t)(t >> 32);
+    return (uint32_t)t;
+  }
+  return offset == 4 ? bus->timer_hi : 0;
+}
+
+static void bus_timer_store(void *dev, uint32_t offset, uint32_t value, uint8_t size) {
+  (void)dev; (void)offset; (void)value; (void)size;
+}
+
+
+/* Halt: the engines stop when halted is set by a store */
+static uint32_t bus_halt_load(void *dev, uint32_t offset, uint8_t size) {
+  (void)dev; (void)offset; (void)size;
+  return 0;
+}
+
+static void bus_halt_store(void *dev, uint32_t offset, uint32_t value, uint8_t size) {
+  BUS *bus = (BUS *)dev;
+  (void)size;
+
+  if (offset != 0) return;
+  bus->halted = 1;
+  bus->exit_code = value;
+}
+
+
+int bus_create(BUS *bus, int out) {
+
+  if (bus == NULL) return -1;
+  memset(bus, 0, sizeof(BUS));
+  if (logfmt_out_create(&bus->uart, out, BUS_UART_BUF) != 0) return -2;
+  bus->start_ns = bus_now_ns();
+  bus_map(bus, BUS_UART, BUS_REGION_SIZE, bus_uart_load, bus_uart_store, bus);
+  bus_map(bus, BUS_TIMER, BUS_REGION_SIZE, bus_timer_load, bus_timer_store, bus);
+  bus_map(bus, BUS_HALT, BUS_REGION_SIZE, bus_halt_load, bus_halt_store, bus);
+  return 0;
+}
+
+
+int bus_map(BUS *bus, uint32_t base, uint32_t size, BUS_LOAD_FN load, BUS_STORE_FN store, void *dev) {
+
+  if (bus->num_regions == BUS_MAX_REGIONS) return -2;
+  BUS_REGION *r = &bus->regions[bus->num_regions++];
+  r->base = base;
+  r->size = size;
+  r->load = load;
+  r->store = store;
+  r->dev = dev;
+  return 0;
+}
+
+
+void bus_flush(BUS *bus) {
+
+  logfmt_out_flush(&bus->uart);
+}
+
+
+void bus_stats(BUS *bus, FILE *out) {
+
+  fprintf(out, "device loads:        %llu\n", (unsigned long long)bus->loads);
+  fprintf(out, "device stores:       %llu\n", (unsigned long long)bus->stores);
+}
+
+
+void bus_dispose(BUS *bus) {
+
+  logfmt_out_dispose(&bus->uart);
+  free(bus);
+}
@@ -0,0 +1,258 @@
+#include "include/cache.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CACHE_PCS_INIT      1024        // entries of the misses per pc table at first
+
+
+/* sets of a geometry: power of two lines and sets, so no line number can be CACHE_EMPTY; 0 if not valid */
+static uint32_t cache_sets(const CACHE_CONFIG *c) {
+
+  if (c->line < 4 || (c->line & (c->line - 1)) || c->ways == 0 || c->ways > CACHE_MAX_WAYS) return 0;
+  if (c->size % (c->ways * c->line)) return 0;
+  uint32_t sets = c->size / (c->ways * c->line);
+  if (sets & (sets - 1)) return 0;
+  if (c->policy == CACHE_PLRU && (c->ways & (c->ways - 1))) return 0;
+  return sets;
+}
+
+
+int cache_parse(CACHE_CONFIG *config, const char *text) {
+  char *end;
+
+  memset(config, 0, sizeof(CACHE_CONFIG));
+  config->policy = CACHE_LRU;
+  unsigned long long size = strtoull(text, &end, 0);
+  if (*end == 'K' || *end == 'k') size <<= 10, end++;
+  else if (*end == 'M' || *end == 'm') size <<= 20, end++;
+  if (end == text || *end != ':' || size == 0 || size > (1u << 30)) return -1;
+  text = end + 1;
+  config->size = (uint32_t)size;
+  config->ways = strtoul(text, &end, 0);
+  if (end == text || *end != ':') return -1;
+  text = end + 1;
+  config->line = strtoul(text, &end, 0);
+  if (end == text) return -1;
+  // policy and write mode, in any order
+  while (*end == ':') {
+    text = end + 1;
+    end = strchr(text, ':');
+    if (end == NULL) end = (char *)text + strlen(text);
+    size_t len = end - text;
+    if (len == 3 && strncmp(text, "lru", 3) == 0) config->policy = CACHE_LRU;
+    else if (len == 4 && strncmp(text, "plru", 4) == 0) config->policy = CACHE_PLRU;
+    else if (len == 6 && strncmp(text, "random", 6) == 0) config->policy = CACHE_RANDOM;
+    else if (len == 2 && strncmp(text, "wb", 2) == 0) config->write_through = 0;
+    else if (len == 2 && strncmp(text, "wt", 2) == 0) config->write_through = 1;
+    else return -1;
+  }
+  return *end == 0 && cache_sets(config) ? 0 : -1;
+}
+
+
+int cache_create(CACHE *cache, const char *name, const CACHE_CONFIG *config) {
+  const CACHE_CONFIG *c = config;
+
+  if (cache == NULL || c == NULL) return -1;
+  memset(cache, 0, sizeof(CACHE));
+  uint32_t sets = cache_sets(c);
+  if (sets == 0) return -1;
+
+  cache->name = name;
+  cache->config = *c;
+  cache->sets = sets;
+  cache->stride = (c->ways + 3) & ~3u;
+  while ((1u << cache->line_bits) < c->line) cache->line_bits++;
+  cache->seed = 0x2545F491;
+  size_t n = (size_t)sets * cache->stride;
+  void *tags = NULL;
+  if (posix_memalign(&tags, 16, n * sizeof(uint32_t)) != 0) return -2;
+  cache->tags = (uint32_t *)tags;
+  memset(cache->tags, 0xFF, n * sizeof(uint32_t));
+  cache->used = (uint64_t *)calloc(n, sizeof(uint64_t));
+  cache->plru = (uint64_t *)calloc(sets, sizeof(uint64_t));
+  cache->dirty = (uint8_t *)calloc(n, 1);
+  cache->max_pcs = CACHE_PCS_INIT;
+  cache->pcs = (CACHE_PC *)calloc(cache->max_pcs, sizeof(CACHE_PC));
+  if (cache->used == NULL || cache->plru == NULL || cache->dirty == NULL || cache->pcs == NULL) return -2;
+  return 0;
+}
+
+
+/* way of a set holding the line, -1 if none */
+static inline int cache_find(const uint32_t *tags, uint32_t stride, uint32_t line) {
+#if defined(__SSE2__)
+  __m128i key = _mm_set1_epi32((int)line);
+  for (uint32_t w = 0; w < stride; w += 4) {
+    __m128i eq = _mm_cmpeq_epi32(_mm_load_si128((const __m128i *)(tags + w)), key);
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+    if (mask) return (int)w + __builtin_ctz(mask);
+  }
+#else
+  for (uint32_t w = 0; w < stride; w++)
+    if (tags[w] == line) return (int)w;
+#endif
+  return -1;
+}
+
+
+/* the tree bits on the path to the way point away from it */
+static inline void cache_plru_touch(uint64_t *bits, uint32_t way, uint32_t ways) {
+  for (uint32_t node = way + ways; node > 1; node >>= 1) {
+    if (node & 1) *bits &= ~(1ull << (node >> 1));
+    else *bits |= 1ull << (node >> 1);
+  }
+}
+
+
+static inline uint32_t cache_plru_victim(uint64_t bits, uint32_t ways) {
+  uint32_t node = 1;
+  while (node < ways) node = 2 * node + ((bits >> node) & 1);
+  return node - ways;
+}
+
+
+/* way of a set replaced on a miss: an empty one, else by the policy */
+static uint32_t cache_victim(CACHE *cache, uint32_t set) {
+  const uint32_t *tags = cache->tags + (size_t)set * cache->stride;
+  uint32_t ways = cache->config.ways;
+
+  for (uint32_t w = 0; w < ways; w++)
+    if (tags[w] == CACHE_EMPTY) return w;
+  if (cache->config.policy == CACHE_PLRU) return cache_plru_victim(cache->plru[set], ways);
+  if (cache->config.policy == CACHE_RANDOM) {
+    uint32_t x = cache->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    cache->seed = x;
+    return x % ways;
+  }
+  const uint64_t *used = cache->used + (size_t)set * cache->stride;
+  uint32_t victim = 0;
+  for (uint32_t w = 1; w < ways; w++)
+    if (used[w] < used[victim]) victim = w;
+  return victim;
+}
+
+
+/* one more miss of the instruction at pc */
+static void cache_miss_pc(CACHE *cache, uint32_t pc) {
+  uint32_t mask = cache->max_pcs - 1;
+
+  if (2 * (cache->num_pcs + 1) > cache->max_pcs) {
+    // grow at half full, entries that do not fit are dropped from the statistics only
+    CACHE_PC *grown = (CACHE_PC *)calloc(2 * cache->max_pcs, sizeof(CACHE_PC));
+    if (grown) {
+      uint32_t gmask = 2 * cache->max_pcs - 1;
+      for (uint32_t i = 0; i < cache->max_pcs; i++) {
+        if (!cache->pcs[i].used) continue;
+        uint32_t h = (cache->pcs[i].pc >> 2) * 2654435761u & gmask;
+        while (grown[h].used) h = (h + 1) & gmask;
+        grown[h] = cache->pcs[i];
+      }
+      free(cache->pcs);
+      cache->pcs = grown;
+      cache->max_pcs *= 2;
+      mask = gmask;
+    } else if (cache->num_pcs + 1 >= cache->max_pcs) {
+      return;
+    }
+  }
+  uint32_t h = (pc >> 2) * 2654435761u & mask;
+  while (cache->pcs[h].used && cache->pcs[h].pc != pc) h = (h + 1) & mask;
+  if (!cache->pcs[h].used) {
+    cache->pcs[h].used = 1;
+    cache->pcs[h].pc = pc;
+    cache->num_pcs++;
+  }
+  cache->pcs[h].misses++;
+}
+
+
+int cache_access(CACHE *cache, uint32_t addr, int write, uint32_t pc) {
+  uint32_t line = addr >> cache->line_bits;
+  uint32_t set = line & (cache->sets - 1);
+  size_t base = (size_t)set * cache->stride;
+  int wt = cache->config.write_through;
+
+  cache->clock++;
+  if (write) cache->writes++;
+  else cache->reads++;
+  int way = cache_find(cache->tags + base, cache->stride, line);
+  int hit = way >= 0;
+  if (!hit) {
+    if (write) cache->write_misses++;
+    else cache->read_misses++;
+    cache_miss_pc(cache, pc);
+    // write-through does not allocate on a store
+    if (write && wt) {
+      cache->mem_writes++;
+      return 0;
+    }
+    way = (int)cache_victim(cache, set);
+    if (cache->dirty[base + way]) cache->writebacks++;
+    cache->tags[base + way] = line;
+    cache->dirty[base + way] = 0;
+  }
+  if (write) {
+    if (wt) cache->mem_writes++;
+    else cache->dirty[base + way] = 1;
+  }
+  cache->used[base + way] = cache->clock;
+  if (cache->config.policy == CACHE_PLRU) cache_plru_touch(&cache->plru[set], (uint32_t)way, cache->config.ways);
+  return hit;
+}
+
+
+static int cache_pc_cmp(const void *a, const void *b) {
+  const CACHE_PC *x = (const CACHE_PC *)a, *y = (const CACHE_PC *)b;
+  if (x->misses != y->misses) return x->misses < y->misses ? 1 : -1;
+  return x->pc < y->pc ? -1 : x->pc > y->pc;
+}
+
+
+void cache_stats(CACHE *cache, FILE *out) {
+  const CACHE_CONFIG *c = &cache->config;
+  static const char *policies[] = {"LRU", "PLRU", "random"};
+  uint64_t accesses = cache->reads + cache->writes;
+  uint64_t misses = cache->read_misses + cache->write_misses;
+
+  fprintf(out, "%-4s cache:          %u bytes, %u ways, %u-byte lines, %u sets, %s, %s\n", cache->name,
+          c->size, c->ways, c->line, cache->sets, policies[c->policy], c->write_through ? "write-through" : "write-back");
+  fprintf(out, "%-4s accesses:       %llu, %llu misses (%.3f%%)\n", cache->name, (unsigned long long)accesses,
+          (unsigned long long)misses, accesses ? 100.0 * misses / accesses : 0.0);
+  if (cache->writes) {
+    fprintf(out, "%-4s reads/writes:   %llu/%llu, misses %llu/%llu\n", cache->name,
+            (unsigned long long)cache->reads, (unsigned long long)cache->writes,
+            (unsigned long long)cache->read_misses, (unsigned long long)cache->write_misses);
+    if (c->write_through) fprintf(out, "%-4s memory writes:  %llu\n", cache->name, (unsigned long long)cache->mem_writes);
+    else fprintf(out, "%-4s write-backs:    %llu\n", cache->name, (unsigned long long)cache->writebacks);
+  }
+  if (cache->num_pcs == 0) return;
+
+  CACHE_PC *top = (CACHE_PC *)malloc(cache->num_pcs * sizeof(CACHE_PC));
+  if (top == NULL) return;
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < cache->max_pcs; i++)
+    if (cache->pcs[i].used) top[n++] = cache->pcs[i];
+  qsort(top, n, sizeof(CACHE_PC), cache_pc_cmp);
+  fprintf(out, "%-4s misses by PC:  ", cache->name);
+  for (uint32_t i = 0; i < n && i < CACHE_TOP_PCS; i++)
+    fprintf(out, "%s%08x %llu (%.1f%%)", i ? ", " : "", top[i].pc, (unsigned long long)top[i].misses,
+            100.0 * top[i].misses / misses);
+  fprintf(out, "\n");
+  free(top);
+}
+
+
+void cache_dispose(CACHE *cache) {
+
+  free(cache->tags);
+  free(cache->used);
+  free(cache->plru);
+  free(cache->dirty);
+  free(cache->pcs);
+  free(cache);
+}
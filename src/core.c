@@ -1,12 +1,59 @@
 #include "include/core.h"
-
-INST inst;
+#include "include/block.h"
+#include "include/bus.h"
+#include "include/predecode.h"
+#include "include/sys.h"
 
 uint32_t core_load(CORE *core, uint32_t addr, uint8_t size) {
+  if (CORE_LOAD_FAST(core, addr)) return ram_load(core->ram, addr, size);
+  return core_load_slow(core, addr, size);
+}
+int core_store(CORE *core, uint32_t addr, uint32_t value, uint8_t size) {
+  if (CORE_STORE_FAST(core, addr)) {
+    ram_store(core->ram, addr, value, size);
+    return 0;
+  }
+  return core_store_slow(core, addr, value, size);
+}
+uint32_t core_load_slow(CORE *core, uint32_t addr, uint8_t size) {
+  if (addr >= core->ram_limit && core->bus) {
+    BUS_REGION *r = bus_find(core->bus, addr);
+    if (r) {
+      core->bus->loads++;
+      return r->load(r->dev, addr - r->base, size);
+    }
+  }
+  // RAM above the devices base, or past the RAM and the guard faults
   return ram_load(core->ram, addr, size);
 }
-void core_store(CORE *core, uint32_t addr, uint32_t value, uint8_t size) {
+int core_store_slow(CORE *core, uint32_t addr, uint32_t value, uint8_t size) {
+  if (addr >= core->ram_limit && core->bus) {
+    BUS_REGION *r = bus_find(core->bus, addr);
+    if (r) {
+      core->bus->stores++;
+      r->store(r->dev, addr - r->base, value, size);
+      // returning to 0 ends the run of the main loop, the other engines check the result
+      if (core->bus->halted) core->pc = 0;
+      return core->bus->halted ? CORE_STORE_HALT : 0;
+    }
+  }
   ram_store(core->ram, addr, value, size);
+  // drop predecoded instructions and blocks overwritten by this store
+  if (addr < core->code_limit) {
+    predecode_invalidate(core->pd, addr, size);
+    if (core->bc) {
+      block_invalidate(core->bc, addr, size);
+      if (core->bc->left) return CORE_STORE_LEAVE;
+    }
+  }
+  return 0;
+}
+void core_code_written(CORE *core, uint32_t addr, uint32_t len) {
+  if (core->pd == NULL) return;
+  for (uint64_t a = addr & ~3u; a < (uint64_t)addr + len && a < core->code_limit; a += 4) {
+    predecode_invalidate(core->pd, (uint32_t)a, 32);
+    if (core->bc) block_invalidate(core->bc, (uint32_t)a, 32);
+  }
 }
 
 /* ref: https://riscv.org/wp-content/uploads/2017/05/riscv-spec-v2.2.pdf*/
@@ -44,13 +91,82 @@ static inline int32_t b_imm(uint32_t inst_raw) {
 }
 /* */
 
+/* Mnemonic written to log.txt, it depends only on the instruction word */
+void core_disasm(uint32_t inst_raw, char *mne, size_t size) {
+  INST d;
+  core_decode(inst_raw, &d);
+  switch (d.opcode) {
+  case 0x3:
+    snprintf(mne, size, "LOAD____dest=%02d_width=%02d_base=%02d_offset=%04d", d.rd, d.funct3, d.rs1, i_imm(inst_raw));
+    break;
+  case 0x23:
+    snprintf(mne, size, "STORE___width=%02d_base=%02d_src=%02d_offset=%04d", d.funct3, d.rs1, d.rs2, s_imm(inst_raw));
+    break;
+  case 0x13: {
+    const char *func3 = "";
+    switch (d.funct3) {
+    case 0x0: func3 = "ADDI"; break;
+    case 0x4: func3 = "XORI"; break;
+    case 0x6: func3 = "ORI";  break;
+    case 0x7: func3 = "ANDI"; break;
+    default: ;
+    }
+    snprintf(mne, size, "OP-IMM__dest=%02d_func=%s_src=%02d_I-imm=%04d", d.rd, func3, d.rs2, i_imm(inst_raw));
+  } break;
+  case 0x33: {
+    const char *func37 = "";
+    if (d.funct3 == 0x0 && d.funct7 == 0x0) func37 = "ADD";
+    else if (d.funct3 == 0x0 && d.funct7 == 0x1) func37 = "MUL";
+    else if (d.funct3 == 0x0 && d.funct7 == 0x20) func37 = "SUB";
+    else if (d.funct3 == 0x4 && d.funct7 == 0x0) func37 = "XOR";
+    else if (d.funct3 == 0x6 && d.funct7 == 0x0) func37 = "OR";
+    else if (d.funct3 == 0x7 && d.funct7 == 0x0) func37 = "AND";
+    snprintf(mne, size, "OP______dest=%02d_func=%s_src1=%02d_src2=%02d", d.rd, func37, d.rs1, d.rs2);
+  } break;
+  case 0x37:
+    snprintf(mne, size, "LUI_____dest=%02d_U-imm=%07d", d.rd, u_imm(inst_raw));
+    break;
+  case 0x17:
+    snprintf(mne, size, "AUIPC___dest=%02d_U-imm=%07d", d.rd, u_imm(inst_raw));
+    break;
+  case 0x6F:
+    snprintf(mne, size, "JAL_____dest=%02d_offset=%07d", d.rd, j_imm(inst_raw));
+    break;
+  case 0x67:
+    snprintf(mne, size, "JALR____dest=%02d_base=%02d_offset=%07d", d.rd, d.rs1, i_imm(inst_raw));
+    break;
+  case 0x63: {
+    const char *func3 = "";
+    switch (d.funct3) {
+    case 0x0: func3 = "BEQ";  break;
+    case 0x1: func3 = "BNE";  break;
+    case 0x4: func3 = "BLT";  break;
+    case 0x5: func3 = "BGE";  break;
+    case 0x6: func3 = "BLTU"; break;
+    case 0x7: func3 = "BGEU"; break;
+    default: ;
+    }
+    snprintf(mne, size, "BRANCH__func=%s_src1=%02d_src2=%02d_offset=%07d", func3, d.rs1, d.rs2, b_imm(inst_raw));
+  } break;
+  case 0x73:
+    if (inst_raw == 0x73) {
+      snprintf(mne, size, "SYSTEM__func=ECALL");
+      break;
+    }
+    if (size) mne[0] = 0;
+    break;
+  default:
+    if (size) mne[0] = 0;
+  }
+}
+
 void core_execute(CORE *core, uint32_t inst_raw, RLOG *log) {
+  INST inst;
   core_decode(inst_raw, &inst);
-  log->rs1 = inst.rs1;
+  // x0 reads and logs as zero, like the sink register of the other engines
+  core->regs[0] = 0;
   log->h_rs1 = core->regs[inst.rs1];
-  log->rs2 = inst.rs2;
   log->h_rs2 = core->regs[inst.rs2];
-  core->regs[0] = 0;
   
   switch (inst.opcode) {
 		  
@@ -63,38 +179,36 @@ void core_execute(CORE *core, uint32_t inst_raw, RLOG *log) {
     switch (inst.funct3) {
     // BYTE
 		case 0x0: {
-      val = (int8_t)core_load(core, addr, 8);
+      val = (int8_t)core_load8(core, addr);
       core->regs[inst.rd] = val;
     } break;
 	// HALF WORD
     case 0x1: {
-      val = (int16_t)core_load(core, addr, 16);
+      val = (int16_t)core_load16(core, addr);
       core->regs[inst.rd] = val;
     } break;
 	// WORD
     case 0x2: {
-      val = (int32_t)core_load(core, addr, 32);
+      val = (int32_t)core_load32(core, addr);
       core->regs[inst.rd] = val;
     } break;
 	// BYTE UNSIGNED
     case 0x4: {
-      val = core_load(core, addr, 8);
+      val = core_load8(core, addr);
       core->regs[inst.rd] = val;
     } break;
 	// HALF WORD UNSIGNED
     case 0x5: {
-      val = core_load(core, addr, 16);
+      val = core_load16(core, addr);
       core->regs[inst.rd] = val;
     } break;
 	// WORD UNSIGNED
     case 0x6: {
-      val = core_load(core, addr, 32);
+      val = core_load32(core, addr);
       core->regs[inst.rd] = val;
     } break;
     default: ;
     }
-	//write mne description on log struct
-    snprintf(log->mne, sizeof(log->mne), "LOAD____dest=%02d_width=%02d_base=%02d_offset=%04d",inst.rd, inst.funct3, inst.rs1, imm);
   } break;
   
   //STORE
@@ -105,95 +219,73 @@ void core_execute(CORE *core, uint32_t inst_raw, RLOG *log) {
     uint32_t val = core->regs[inst.rs2];
     switch (inst.funct3) {
 	// BYTE
-    case 0x0: core_store(core, addr, val, 8); break;
+    case 0x0: core_store8(core, addr, val); break;
 	// HALF WORD
-    case 0x1: core_store(core, addr, val, 16); break;
+    case 0x1: core_store16(core, addr, val); break;
 	// WORD
-    case 0x2: core_store(core, addr, val, 32); break;
+    case 0x2: core_store32(core, addr, val); break;
     default: ;
     }
-    //write mne description on log struct
-    snprintf(log->mne, sizeof(log->mne), "STORE___width=%02d_base=%02d_src=%02d_offset=%04d", inst.funct3, inst.rs1, inst.rs2, imm);
   } break;
   
   //I-type Integer computation
   // ADDI, ANDI, ORI, XORI
   case 0x13: {
     int32_t imm = i_imm(inst_raw);
-	char func3[5] = "";
     switch (inst.funct3) {
 	// ADDI
     case 0x0: {
       core->regs[inst.rd] = core->regs[inst.rs1] + imm;
-	  strncpy(func3, "ADDI", 5);
     } break;
 	// XORI
     case 0x4: {
       core->regs[inst.rd] = core->regs[inst.rs1] ^ imm;
-	  strncpy(func3, "XORI", 5);
     } break;
 	//ORI
     case 0x6: {
       core->regs[inst.rd] = core->regs[inst.rs1] | imm;
-	  strncpy(func3, "ORI", 5);
     } break;
 	// ANDI
     case 0x7: {
       core->regs[inst.rd] = core->regs[inst.rs1] & imm;
-	  strncpy(func3, "ANDI", 5);
     } break;
     default: ;
     }
-	//write mne description on log struct
-    snprintf(log->mne, sizeof(log->mne), "OP-IMM__dest=%02d_func=%s_src=%02d_I-imm=%04d", inst.rd, &func3[0], inst.rs2, imm);
   } break;
 
   // The R-type Integer computation
   case 0x33: {
-	char func37[5] = "";
 	// ADD
     if (inst.funct3 == 0x0 && inst.funct7 == 0x0) {
       core->regs[inst.rd] = core->regs[inst.rs1] + core->regs[inst.rs2];
-	  strncpy(func37, "ADD", 5);
 	// MUL
     } else if (inst.funct3 == 0x0 && inst.funct7 == 0x1) {
       core->regs[inst.rd] = core->regs[inst.rs1] * core->regs[inst.rs2];
-	  strncpy(func37, "MUL", 5);
 	// SUB
     } else if (inst.funct3 == 0x0 && inst.funct7 == 0x20) {
       core->regs[inst.rd] = core->regs[inst.rs1] - core->regs[inst.rs2];
-	  strncpy(func37, "SUB", 5);
 	// XOR
     } else if (inst.funct3 == 0x4 && inst.funct7 == 0x0) {
       core->regs[inst.rd] = core->regs[inst.rs1] ^ core->regs[inst.rs2];
-	  strncpy(func37, "XOR", 5);
 	// OR
     } else if (inst.funct3 == 0x6 && inst.funct7 == 0x0) {
       core->regs[inst.rd] = core->regs[inst.rs1] | core->regs[inst.rs2];
-	  strncpy(func37, "OR", 5);
 	// AND
     } else if (inst.funct3 == 0x7 && inst.funct7 == 0x0) {
       core->regs[inst.rd] = core->regs[inst.rs1] & core->regs[inst.rs2];
-	  strncpy(func37, "AND", 5);
     }
-	//write mne description on log struct
-    snprintf(log->mne, sizeof(log->mne), "OP______dest=%02d_func=%s_src1=%02d_src2=%02d", inst.rd, &func37[0], inst.rs1, inst.rs2);
   } break;
 
   // LUI
   case 0x37: {
     int32_t imm = u_imm(inst_raw);
     core->regs[inst.rd] = imm;
-	//write mne description on log struct
-    snprintf(log->mne, sizeof(log->mne), "LUI_____dest=%02d_U-imm=%07d", inst.rd, imm);
   } break;
 
   // AUIPC
   case 0x17: {
     int32_t imm = u_imm(inst_raw);
     core->regs[inst.rd] = (core->pc - 4) + imm;
-	//write mne description on log struct
-    snprintf(log->mne, sizeof(log->mne), "AUIPC___dest=%02d_U-imm=%07d", inst.rd, imm);
   } break;
 
   // JAL
@@ -202,69 +294,251 @@ void core_execute(CORE *core, uint32_t inst_raw, RLOG *log) {
     core->regs[inst.rd] = core->pc;
     int32_t jmp_addr = imm + (core->pc - 4);
     core->pc = jmp_addr;
-	//write mne description on log struct
-    snprintf(log->mne, sizeof(log->mne), "JAL_____dest=%02d_offset=%07d", inst.rd, imm);
   } break;
 
   // JALR
   case 0x67: {
-    core->regs[inst.rd] = core->pc;
+    // the target is read before rd is written, rd may be rs1
     int32_t imm = i_imm(inst_raw);
     int32_t jmp_addr = core->regs[inst.rs1] + imm;
+    core->regs[inst.rd] = core->pc;
     core->pc = jmp_addr;
-	//write mne description on log struct
-    snprintf(log->mne, sizeof(log->mne), "JALR____dest=%02d_base=%02d_offset=%07d", inst.rd, inst.rs1, imm);
   } break;
 
   // BRANCH Conditional branches: BEQ, BNE, BLT[U], BGE[U]
   case 0x63: {
     int32_t imm = b_imm(inst_raw);
-	char func3[5] = "";
     switch (inst.funct3) {
 	// BEQ
     case 0x0: {
       int c = core->regs[inst.rs1] == core->regs[inst.rs2];
       if (c) core->pc += imm - 4;
-	  strncpy(func3, "BEQ", 5);
     } break;
 	// BNE
     case 0x1: {
       int c = core->regs[inst.rs1] != core->regs[inst.rs2];
       if (c) core->pc += imm - 4;
-	  strncpy(func3, "BNE", 5);
     } break;
 	// BLT
     case 0x4: {
       int c = ((int32_t)core->regs[inst.rs1]) < ((int32_t)core->regs[inst.rs2]);
       if (c) core->pc += imm - 4;
-      strncpy(func3, "BLT", 5);
     } break;
 	// BGE
     case 0x5: {
       int c = ((int32_t)core->regs[inst.rs1]) >= ((int32_t)core->regs[inst.rs2]);
       if (c) core->pc += imm - 4;
-      strncpy(func3, "BGE", 5);
     } break;
 	// BLTU
     case 0x6: {
       int c = core->regs[inst.rs1] < core->regs[inst.rs2];
       if (c) core->pc += imm - 4;
-      strncpy(func3, "BLTU", 5);
     } break;
 	// BGEU
     case 0x7: {
       int c = core->regs[inst.rs1] >= core->regs[inst.rs2];
       if (c) core->pc += imm - 4;
-      strncpy(func3, "BGEU", 5);
     } break;
     default: ;
     }
-	//write mne description on log struct
-    snprintf(log->mne, sizeof(log->mne), "BRANCH__func=%s_src1=%02d_src2=%02d_offset=%07d", &func3[0], inst.rs1, inst.rs2, imm);
   } break;
+
+  // SYSTEM, only ECALL: system call of the guest
+  case 0x73:
+    if (inst_raw == 0x73 && core->sys) sys_ecall(core->sys, core, core->regs);
+    break;
   default: ;
   }
 
-  log->rd = inst.rd;
+  core->regs[0] = 0;
   log->h_rd = core->regs[inst.rd];
-}
\ No newline at end of file
+}
+
+/* Handlers of the predecoded instructions, one per resolved instruction */
+/* They follow core_execute() step by step so both produce the same log */
+static void exec_nop(CORE *core, const DECODED *d) {
+  (void)core; (void)d;
+}
+static void exec_lb(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = (int8_t)core_load8(core, core->regs[d->rs1] + d->imm);
+}
+static void exec_lh(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = (int16_t)core_load16(core, core->regs[d->rs1] + d->imm);
+}
+static void exec_lw(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core_load32(core, core->regs[d->rs1] + d->imm);
+}
+static void exec_lbu(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core_load8(core, core->regs[d->rs1] + d->imm);
+}
+static void exec_lhu(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core_load16(core, core->regs[d->rs1] + d->imm);
+}
+static void exec_sb(CORE *core, const DECODED *d) {
+  core_store8(core, core->regs[d->rs1] + d->imm, core->regs[d->rs2]);
+}
+static void exec_sh(CORE *core, const DECODED *d) {
+  core_store16(core, core->regs[d->rs1] + d->imm, core->regs[d->rs2]);
+}
+static void exec_sw(CORE *core, const DECODED *d) {
+  core_store32(core, core->regs[d->rs1] + d->imm, core->regs[d->rs2]);
+}
+static void exec_addi(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core->regs[d->rs1] + d->imm;
+}
+static void exec_xori(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core->regs[d->rs1] ^ d->imm;
+}
+static void exec_ori(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core->regs[d->rs1] | d->imm;
+}
+static void exec_andi(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core->regs[d->rs1] & d->imm;
+}
+static void exec_add(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core->regs[d->rs1] + core->regs[d->rs2];
+}
+static void exec_mul(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core->regs[d->rs1] * core->regs[d->rs2];
+}
+static void exec_sub(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core->regs[d->rs1] - core->regs[d->rs2];
+}
+static void exec_xor(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core->regs[d->rs1] ^ core->regs[d->rs2];
+}
+static void exec_or(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core->regs[d->rs1] | core->regs[d->rs2];
+}
+static void exec_and(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core->regs[d->rs1] & core->regs[d->rs2];
+}
+static void exec_lui(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = d->imm;
+}
+static void exec_auipc(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = (core->pc - 4) + d->imm;
+}
+static void exec_jal(CORE *core, const DECODED *d) {
+  core->regs[d->rd] = core->pc;
+  int32_t jmp_addr = d->imm + (core->pc - 4);
+  core->pc = jmp_addr;
+}
+static void exec_jalr(CORE *core, const DECODED *d) {
+  int32_t jmp_addr = core->regs[d->rs1] + d->imm;
+  core->regs[d->rd] = core->pc;
+  core->pc = jmp_addr;
+}
+static void exec_beq(CORE *core, const DECODED *d) {
+  if (core->regs[d->rs1] == core->regs[d->rs2]) core->pc += d->imm - 4;
+}
+static void exec_bne(CORE *core, const DECODED *d) {
+  if (core->regs[d->rs1] != core->regs[d->rs2]) core->pc += d->imm - 4;
+}
+static void exec_blt(CORE *core, const DECODED *d) {
+  if ((int32_t)core->regs[d->rs1] < (int32_t)core->regs[d->rs2]) core->pc += d->imm - 4;
+}
+static void exec_bge(CORE *core, const DECODED *d) {
+  if ((int32_t)core->regs[d->rs1] >= (int32_t)core->regs[d->rs2]) core->pc += d->imm - 4;
+}
+static void exec_bltu(CORE *core, const DECODED *d) {
+  if (core->regs[d->rs1] < core->regs[d->rs2]) core->pc += d->imm - 4;
+}
+static void exec_bgeu(CORE *core, const DECODED *d) {
+  if (core->regs[d->rs1] >= core->regs[d->rs2]) core->pc += d->imm - 4;
+}
+static void exec_ecall(CORE *core, const DECODED *d) {
+  (void)d;
+  if (core->sys) sys_ecall(core->sys, core, core->regs);
+}
+
+/* Handler of each OP_*, FILL and LOOKUP never execute */
+static const EXEC_FN exec_table[OP_COUNT] = {
+  [OP_FILL] = exec_nop, [OP_LOOKUP] = exec_nop, [OP_NOP] = exec_nop,
+  [OP_LB] = exec_lb, [OP_LH] = exec_lh, [OP_LW] = exec_lw, [OP_LBU] = exec_lbu, [OP_LHU] = exec_lhu,
+  [OP_SB] = exec_sb, [OP_SH] = exec_sh, [OP_SW] = exec_sw,
+  [OP_ADDI] = exec_addi, [OP_XORI] = exec_xori, [OP_ORI] = exec_ori, [OP_ANDI] = exec_andi,
+  [OP_ADD] = exec_add, [OP_MUL] = exec_mul, [OP_SUB] = exec_sub,
+  [OP_XOR] = exec_xor, [OP_OR] = exec_or, [OP_AND] = exec_and,
+  [OP_LUI] = exec_lui, [OP_AUIPC] = exec_auipc, [OP_JAL] = exec_jal, [OP_JALR] = exec_jalr,
+  [OP_BEQ] = exec_beq, [OP_BNE] = exec_bne, [OP_BLT] = exec_blt,
+  [OP_BGE] = exec_bge, [OP_BLTU] = exec_bltu, [OP_BGEU] = exec_bgeu,
+  [OP_ECALL] = exec_ecall,
+};
+
+/* Resolve handler and immediate of an instruction word, done once per PC */
+void core_predecode(uint32_t inst_raw, DECODED *dec) {
+  static const uint8_t load[8] = {OP_LB, OP_LH, OP_LW, OP_NOP, OP_LBU, OP_LHU, OP_LW, OP_NOP};
+  static const uint8_t store[8] = {OP_SB, OP_SH, OP_SW, OP_NOP, OP_NOP, OP_NOP, OP_NOP, OP_NOP};
+  static const uint8_t op_imm[8] = {OP_ADDI, OP_NOP, OP_NOP, OP_NOP, OP_XORI, OP_NOP, OP_ORI, OP_ANDI};
+  static const uint8_t branch[8] = {OP_BEQ, OP_BNE, OP_NOP, OP_NOP, OP_BLT, OP_BGE, OP_BLTU, OP_BGEU};
+  INST d;
+  core_decode(inst_raw, &d);
+  dec->raw = inst_raw;
+  dec->rd = d.rd;
+  dec->rs1 = d.rs1;
+  dec->rs2 = d.rs2;
+  dec->wd = d.rd ? d.rd : 32;
+  dec->imm = 0;
+  dec->op = OP_NOP;
+
+  switch (d.opcode) {
+  case 0x3:
+    dec->imm = i_imm(inst_raw);
+    dec->op = load[d.funct3];
+    break;
+  case 0x23:
+    dec->imm = s_imm(inst_raw);
+    dec->op = store[d.funct3];
+    break;
+  case 0x13:
+    dec->imm = i_imm(inst_raw);
+    dec->op = op_imm[d.funct3];
+    break;
+  case 0x33:
+    if (d.funct3 == 0x0 && d.funct7 == 0x0) dec->op = OP_ADD;
+    else if (d.funct3 == 0x0 && d.funct7 == 0x1) dec->op = OP_MUL;
+    else if (d.funct3 == 0x0 && d.funct7 == 0x20) dec->op = OP_SUB;
+    else if (d.funct3 == 0x4 && d.funct7 == 0x0) dec->op = OP_XOR;
+    else if (d.funct3 == 0x6 && d.funct7 == 0x0) dec->op = OP_OR;
+    else if (d.funct3 == 0x7 && d.funct7 == 0x0) dec->op = OP_AND;
+    break;
+  case 0x37:
+    dec->imm = u_imm(inst_raw);
+    dec->op = OP_LUI;
+    break;
+  case 0x17:
+    dec->imm = u_imm(inst_raw);
+    dec->op = OP_AUIPC;
+    break;
+  case 0x6F:
+    dec->imm = j_imm(inst_raw);
+    dec->op = OP_JAL;
+    break;
+  case 0x67:
+    dec->imm = i_imm(inst_raw);
+    dec->op = OP_JALR;
+    break;
+  case 0x63:
+    dec->imm = b_imm(inst_raw);
+    dec->op = branch[d.funct3];
+    break;
+  case 0x73:
+    if (inst_raw == 0x73) dec->op = OP_ECALL;
+    break;
+  default: ;
+  }
+  dec->exec = exec_table[dec->op];
+}
+
+/* Same effect on CORE and log as core_execute(), without decoding */
+void core_execute_decoded(CORE *core, const DECODED *dec, RLOG *log) {
+  core->regs[0] = 0;
+  log->h_rs1 = core->regs[dec->rs1];
+  log->h_rs2 = core->regs[dec->rs2];
+
+  dec->exec(core, dec);
+
+  core->regs[0] = 0;
+  log->h_rd = core->regs[dec->rd];
+}
@@ -0,0 +1,116 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "common.h"
+#include <pthread.h>
+#include "sim.h"
+
+#define BATCH_MAX_THREADS   256
+
+/*
+ * Batch mode: many guest binaries simulated at once, one SIM per job.
+ * Every thread has a queue of jobs dealt in turn. A thread takes its jobs
+ * from the front of its queue, and once it is empty it steals from the back
+ * of the others, so the batch ends about when its longest job does.
+ * Binaries are mapped copy-on-write: jobs of the same file share its pages
+ * until they write them. Each job writes its log and the guest output next
+ * to its binary: name.log.txt (or name.log.bin) and name.out, name being the
+ * binary path without ".bin", followed by ".N" for the Nth repeat of a binary.
+ */
+
+/* One binary of the batch and the result of its run */
+typedef struct {
+  char *path;
+  char *log_path;
+  char *out_path;
+  int error;            // sim_create() or sim_load_file() error, 0 when it ran
+  SIM_STATUS status;
+  int exit_code;
+  uint32_t fault_addr;  // guest address and PC of an access fault
+  uint32_t fault_pc;
+  uint64_t insts;
+  uint64_t wall_ns;     // from creating the simulator to disposing it
+  int thread;           // thread that ran the job
+} BATCH_JOB;
+
+/* Jobs left to a thread, [head, tail) of jobs */
+typedef struct {
+  pthread_mutex_t lock;
+  uint32_t *jobs;
+  uint32_t head;        // next job of the owner
+  uint32_t tail;        // thieves take tail - 1
+} BATCH_QUEUE;
+
+typedef struct BATCH BATCH;
+
+/* Work of one thread of the pool */
+typedef struct {
+  BATCH *batch;
+  pthread_t thread;
+  uint32_t index;
+  BATCH_QUEUE queue;
+  uint64_t steals;      // jobs taken from other queues
+} BATCH_WORKER;
+
+struct BATCH {
+  SIM_CONFIG config;    // of every job, with the log and output paths of the job
+  uint64_t max_insts;   // budget of each job
+  BATCH_JOB *jobs;
+  uint32_t num_jobs;
+  uint32_t max_jobs;    // entries allocated in jobs
+  int num_threads;      // workers, the calling thread is worker 0
+  int num_active;       // workers the jobs were dealt to, no more than the jobs
+  BATCH_WORKER *workers;
+  uint64_t wall_ns;     // of the whole batch
+};
+
+/**
+ * Create an empty batch.
+ * param: batch         [out] pointer to the batch
+ * param: config        [in]  configuration of the simulators, copied
+ * param: max_insts     [in]  most instructions of each job, UINT64_MAX for no limit
+ * param: threads       [in]  number of threads, 0 for one per online CPU
+ * return: error code
+ */
+int batch_create(BATCH *batch, const SIM_CONFIG *config, uint64_t max_insts, int threads);
+
+/**
+ * Add a binary to the batch.
+ * param: batch         [in] the batch pointer
+ * param: path          [in] binary file, copied
+ * return: error code
+ */
+int batch_add(BATCH *batch, const char *path);
+
+/**
+ * Add the binaries listed in a manifest: one path per line, blank lines and
+ * lines starting with '#' are skipped, relative paths are taken from the
+ * directory of the manifest.
+ * param: batch         [in] the batch pointer
+ * param: path          [in] manifest file
+ * return: error code, -1 when it can not be read
+ */
+int batch_add_manifest(BATCH *batch, const char *path);
+
+/**
+ * Run every job of the batch and wait for them.
+ * param: batch         [in] the batch pointer
+ * return: error code, -2 when the threads can not be started
+ */
+int batch_run(BATCH *batch);
+
+/**
+ * Print a line per job, with its wall time and MIPS, and the totals of the batch.
+ * param: batch         [in] the batch pointer
+ * param: out           [in] output stream
+ * return:              jobs that failed: not loaded, faulted or exited with a code other than 0
+ */
+uint32_t batch_report(BATCH *batch, FILE *out);
+
+/**
+ * Dispose the batch.
+ * param: batch         [out] pointer to the batch
+ */
+void batch_dispose(BATCH *batch);
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include "common.h"
+#include "core.h"
+
+#define BLOCK_MAX_INSTS   64      // longest block translated
+#define BLOCK_HASH_BITS   12      // buckets of the block cache
+
+/* Native code of a block: runs the whole block on the guest registers and */
+/* returns the next PC, regs has 33 entries, regs[32] is the sink for writes to x0 */
+typedef uint32_t (*JIT_FN)(uint32_t *regs, uint8_t *ram, CORE *core);
+
+typedef struct BLOCK BLOCK;
+
+/* Chain from a block to a successor, also in the list of the chains to the */
+/* successor, so the chains to a dropped block are found without a search */
+typedef struct BLOCK_LINK BLOCK_LINK;
+struct BLOCK_LINK {
+  BLOCK *to;            // successor, NULL when not chained
+  BLOCK_LINK *in_next;  // next chain to the same successor
+  BLOCK_LINK **in_prev; // pointer to this chain in that list
+};
+
+/* Translated basic block: straight-line instructions ending at a branch, */
+/* JAL or JALR, at the end of the code page or after BLOCK_MAX_INSTS */
+struct BLOCK {
+  uint32_t pc;          // guest address of the first instruction
+  uint32_t len;         // number of instructions
+  uint64_t execs;       // times the block was entered
+  BLOCK_LINK next[2];   // chained successors: [0] jump target, [1] fall through
+  BLOCK_LINK *in;       // chains of other blocks to this one
+  BLOCK *hash_next;     // next block of the same hash bucket
+  BLOCK *page_next;     // next block of the same code page
+  JIT_FN native;        // compiled block, NULL while interpreted
+  DECODED uops[];       // len micro-ops followed by an OP_LOOKUP entry
+};
+
+/* Block cache indexed by guest PC */
+struct BLOCK_CACHE {
+  BLOCK *hash[1 << BLOCK_HASH_BITS];
+  BLOCK **pages;        // blocks of each code page, to invalidate them on stores
+  BLOCK *running;       // block the engine runs, NULL outside a run
+  BLOCK *dead;          // the running block once invalidated, freed when the engine leaves it
+  int left;             // the running block was invalidated, the engine must leave it
+  uint32_t num_pages;
+  PREDECODE *pd;        // source of the decoded instructions
+  JIT *jit;             // compiler of hot blocks, NULL if not used
+  /* counters */
+  uint64_t entered;     // blocks entered
+  uint64_t chained;     // entered through a chained successor
+  uint64_t hashed;      // entered after a hash table hit
+  uint64_t translated;  // blocks translated (misses)
+  uint64_t translated_insts;
+  uint64_t invalidated;
+};
+
+/**
+ * Create the block cache over the code covered by a predecode cache.
+ * param: bc            [out] pointer to the block cache
+ * param: pd            [in]  predecode cache the blocks are translated from
+ * return: error code
+ */
+int block_create(BLOCK_CACHE *bc, PREDECODE *pd);
+
+/**
+ * Find the block starting at pc, translating it on a miss.
+ * param: bc            [in] the block cache pointer
+ * param: pc            [in] guest address of the block
+ * return:              the block, NULL if pc is past the end of the code
+ */
+BLOCK *block_lookup(BLOCK_CACHE *bc, uint32_t pc);
+
+/**
+ * Chain a block to its successor, or unchain it.
+ * param: link          [in] chain of the block, next[0] or next[1]
+ * param: to            [in] the successor, NULL to unchain
+ */
+static inline void block_chain(BLOCK_LINK *link, BLOCK *to) {
+  if (link->to) {
+    *link->in_prev = link->in_next;
+    if (link->in_next) link->in_next->in_prev = link->in_prev;
+  }
+  link->to = to;
+  if (to) {
+    link->in_next = to->in;
+    if (to->in) to->in->in_prev = &link->in_next;
+    link->in_prev = &to->in;
+    to->in = link;
+  }
+}
+
+/**
+ * Drop the blocks overwritten by a guest store and the chains to them. They
+ * are freed at once, but the running block, which sets bc->left and is freed
+ * by block_free_dead() once the engine left it.
+ * param: bc            [in] the block cache pointer
+ * param: addr          [in] store address
+ * param: size          [in] store width in bits
+ */
+void block_invalidate(BLOCK_CACHE *bc, uint32_t addr, uint8_t size);
+
+/**
+ * Free the running block invalidated, once the engine left it.
+ * param: bc            [in] the block cache pointer
+ */
+void block_free_dead(BLOCK_CACHE *bc);
+
+/**
+ * Drop the native code of every block, when the JIT code buffer is reset, and
+ * count their executions again from 0.
+ * param: bc            [in] the block cache pointer
+ */
+void block_drop_native(BLOCK_CACHE *bc);
+
+/**
+ * Print the block cache counters.
+ * param: bc            [in] the block cache pointer
+ * param: insts         [in] instructions executed
+ * param: out           [in] output stream
+ */
+void block_stats(BLOCK_CACHE *bc, uint64_t insts, FILE *out);
+
+/**
+ * Dispose the block cache.
+ * param: bc            [out] pointer to the block cache
+ */
+void block_dispose(BLOCK_CACHE *bc);
+
+#endif
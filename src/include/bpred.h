@@ -0,0 +1,131 @@
+#ifndef BPRED_H
+#define BPRED_H
+
+#include "common.h"
+#include "core.h"
+
+#define BPRED_MAX           4           // direction predictors run side by side
+#define BPRED_BITS          12          // log2 of the counters of a predictor by default
+#define BPRED_BTB_ENTRIES   512         // branch target buffer entries by default
+#define BPRED_RAS_DEPTH     16          // return address stack entries by default
+#define BPRED_TOP_PCS       10          // branches with the most mispredictions in the statistics
+
+/*
+ * Branch prediction: the retired control transfers go to one or more direction
+ * predictors, compared on the same branches, and to a branch target buffer and
+ * a return address stack shared by them. The RAS follows the RISC-V hints: a
+ * JAL or JALR writing x1 or x5 pushes, a JALR reading x1 or x5 pops.
+ * Mispredictions are also counted per branch address.
+ * A direction predictor is a struct starting with PREDICTOR, its functions cast it back.
+ */
+
+/* Direction predictors selectable with --bpred */
+typedef enum {
+  BPRED_BIMODAL,        // 2-bit counters indexed by the PC
+  BPRED_GSHARE,         // 2-bit counters indexed by the PC xor the global history
+  BPRED_TAGE            // bimodal base and 4 tagged tables of geometric history lengths
+} BPRED_KIND;
+
+typedef struct {
+  uint32_t num;         // predictors, 0 for no branch prediction
+  BPRED_KIND kind[BPRED_MAX];
+  uint32_t bits[BPRED_MAX]; // log2 of the entries of each table
+  uint32_t btb;         // BTB entries, direct-mapped, a power of two
+  uint32_t ras;         // RAS entries, the oldest ones are overwritten
+} BPRED_CONFIG;
+
+typedef struct PREDICTOR PREDICTOR;
+
+struct PREDICTOR {
+  const char *name;
+  int (*predict)(PREDICTOR *pred, uint32_t pc);             // 1 for taken
+  void (*update)(PREDICTOR *pred, uint32_t pc, int taken);  // outcome of the branch just predicted
+  void (*dispose)(PREDICTOR *pred);                         // frees the predictor
+};
+
+/* Counts of one branch address */
+typedef struct {
+  uint32_t pc;
+  uint32_t used;        // entry holds a pc
+  uint64_t execs;
+  uint64_t taken;
+  uint64_t targets;     // targets not predicted by the BTB or the RAS
+  uint64_t misses[BPRED_MAX];  // wrong directions of each predictor
+} BPRED_PC;
+
+typedef struct {
+  BPRED_CONFIG config;
+  PREDICTOR *preds[BPRED_MAX];
+  char names[BPRED_MAX][16];    // kind and size of each predictor
+  uint32_t *btb_pc;     // branch of each BTB entry, odd when empty
+  uint32_t *btb_target;
+  uint32_t *ras;        // circular, the oldest entries are overwritten
+  uint32_t ras_top;     // entry of the next push, the top is the one before
+  uint32_t ras_count;   // valid entries, up to the depth
+  BPRED_PC *pcs;        // open addressing table of the branches
+  uint32_t num_pcs;
+  uint32_t max_pcs;     // entries allocated, a power of two
+  /* counters */
+  uint64_t insts;       // instructions retired
+  uint64_t branches;    // conditional branches, taken ones and wrong directions of each predictor
+  uint64_t taken;
+  uint64_t misses[BPRED_MAX];
+  uint64_t jumps;       // JAL and JALR other than returns, and taken branches, looked up in the BTB
+  uint64_t btb_misses;  // of them, target not in the BTB
+  uint64_t returns;     // JALR popping the RAS, and wrong addresses popped
+  uint64_t ras_misses;
+} BPRED;
+
+/**
+ * Parse "KIND[:BITS],..." of up to BPRED_MAX predictors, KIND bimodal, gshare or tage.
+ * param: config        [out] the predictors of the configuration, its BTB and RAS are not changed
+ * param: text          [in]  the description
+ * return: error code, -1 when it is not valid
+ */
+int bpred_parse(BPRED_CONFIG *config, const char *text);
+
+/**
+ * Create the predictors, the BTB and the RAS, empty.
+ * param: bpred         [out] pointer to the branch prediction
+ * param: config        [in]  configuration, copied
+ * return: error code, -1 for a bad configuration, -2 when it can not be allocated;
+ *         bpred_dispose() frees what was created in any case
+ */
+int bpred_create(BPRED *bpred, const BPRED_CONFIG *config);
+
+/**
+ * Predict a control transfer and learn its outcome.
+ * param: bpred         [in] the branch prediction pointer
+ * param: dec           [in] the instruction, OP_JAL to OP_BGEU
+ * param: pc            [in] its address
+ * param: next_pc       [in] address of the next instruction executed
+ */
+void bpred_branch(BPRED *bpred, const DECODED *dec, uint32_t pc, uint32_t next_pc);
+
+/**
+ * Give a retired instruction to the branch prediction.
+ * param: bpred         [in] the branch prediction pointer
+ * param: dec           [in] the instruction
+ * param: pc            [in] its address
+ * param: next_pc       [in] address of the next instruction executed
+ */
+static inline void bpred_retire(BPRED *bpred, const DECODED *dec, uint32_t pc, uint32_t next_pc) {
+  bpred->insts++;
+  if (dec->op >= OP_JAL && dec->op <= OP_BGEU) bpred_branch(bpred, dec, pc, next_pc);
+}
+
+/**
+ * Print the mispredictions of each predictor, of the BTB and of the RAS, and the
+ * branches with the most mispredictions.
+ * param: bpred         [in] the branch prediction pointer
+ * param: out           [in] output stream
+ */
+void bpred_stats(BPRED *bpred, FILE *out);
+
+/**
+ * Dispose the branch prediction.
+ * param: bpred         [out] pointer to the branch prediction
+ */
+void bpred_dispose(BPRED *bpred);
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef BUS_H
+#define BUS_H
+
+#include "common.h"
+#include "core.h"
+#include "logfmt.h"
+
+/*
+ * Memory-mapped devices, above the RAM fast path
+ *
+ * BUS_UART   +0 write: byte sent to the console output (stdout or the output file
+ *                      of the simulator), buffered and written in large blocks
+ *            +4 read:  status, bit 0 set when a byte can be sent (always)
+ * BUS_TIMER  +0 read:  nanoseconds since the start of the run, low word,
+ *                      latches the high word
+ *            +4 read:  high word latched by the last read of the low word
+ * BUS_HALT   +0 write: end the run, the value is the exit code of the simulator
+ *
+ * Registers are 32 bits wide, narrower accesses read or write their low bits.
+ * Other addresses of the device regions read as 0 and ignore writes.
+ */
+
+#define BUS_BASE            0xF0000000u     // lowest device address, RAM above it takes the slow path
+#define BUS_UART            0xF0000000u
+#define BUS_TIMER           0xF0001000u
+#define BUS_HALT            0xF0002000u
+#define BUS_REGION_SIZE     0x1000u
+#define BUS_MAX_REGIONS     8
+#define BUS_UART_BUF        (64 << 10)      // bytes gathered before each write to stdout
+
+typedef uint32_t (*BUS_LOAD_FN)(void *dev, uint32_t offset, uint8_t size);
+typedef void (*BUS_STORE_FN)(void *dev, uint32_t offset, uint32_t value, uint8_t size);
+
+/* Device registers mapped at [base, base + size) */
+typedef struct {
+  uint32_t base;
+  uint32_t size;
+  BUS_LOAD_FN load;
+  BUS_STORE_FN store;
+  void *dev;
+} BUS_REGION;
+
+struct BUS {
+  BUS_REGION regions[BUS_MAX_REGIONS];
+  uint32_t num_regions;
+  /* devices */
+  LOGFMT_OUT uart;      // console output of the UART, write() to stdout goes there too
+  uint64_t start_ns;    // timer zero
+  uint32_t timer_hi;    // high word latched by the timer
+  int halted;           // the guest wrote the halt register
+  uint32_t exit_code;
+  /* counters */
+  uint64_t loads;
+  uint64_t stores;
+};
+
+/**
+ * Create the bus with the UART, timer and halt devices.
+ * param: bus           [out] pointer to the bus
+ * param: out           [in]  file descriptor of the console output, STDOUT_FILENO
+ *                            or a file of its own
+ * return: error code
+ */
+int bus_create(BUS *bus, int out);
+
+/**
+ * Map a device.
+ * param: bus           [in] the bus pointer
+ * param: base          [in] guest address of the first register
+ * param: size          [in] bytes of the region
+ * param: load          [in] read of a register, offset from base
+ * param: store         [in] write of a register, offset from base
+ * param: dev           [in] device state given to load and store
+ * return: error code, -2 when the table is full
+ */
+int bus_map(BUS *bus, uint32_t base, uint32_t size, BUS_LOAD_FN load, BUS_STORE_FN store, void *dev);
+
+/**
+ * Find the device region holding an address.
+ * param: bus           [in] the bus pointer
+ * param: addr          [in] guest address
+ * return:              the region, NULL if no device is mapped there
+ */
+static inline BUS_REGION *bus_find(BUS *bus, uint32_t addr) {
+  for (uint32_t i = 0; i < bus->num_regions; i++) {
+    if (addr - bus->regions[i].base < bus->regions[i].size) return &bus->regions[i];
+  }
+  return NULL;
+}
+
+/**
+ * Write the bytes buffered by the UART.
+ * param: bus           [in] the bus pointer
+ */
+void bus_flush(BUS *bus);
+
+/**
+ * Print the device access counters.
+ * param: bus           [in] the bus pointer
+ * param: out           [in] output stream
+ */
+void bus_stats(BUS *bus, FILE *out);
+
+/**
+ * Flush the UART and dispose the bus.
+ * param: bus           [out] pointer to the bus
+ */
+void bus_dispose(BUS *bus);
+
+#endif
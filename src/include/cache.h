@@ -0,0 +1,106 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "common.h"
+
+#define CACHE_MAX_WAYS      64          // ways of a set, PLRU keeps its tree in 64 bits
+#define CACHE_TOP_PCS       10          // instructions with the most misses in the statistics
+
+/*
+ * Set-associative cache model, hit/miss statistics only: no data is kept.
+ * Tags are stored as a structure of arrays: the line numbers of the ways of a
+ * set are contiguous, padded to a multiple of 4 ways, and compared 4 at a time
+ * with SSE2 when available. An empty way holds CACHE_EMPTY, never a line number.
+ * Misses are also counted per instruction address.
+ */
+
+#define CACHE_EMPTY         0xFFFFFFFFu
+
+/* Line replaced on a miss in a full set */
+typedef enum {
+  CACHE_LRU,            // least recently used
+  CACHE_PLRU,           // tree pseudo-LRU, power of two ways
+  CACHE_RANDOM
+} CACHE_POLICY;
+
+typedef struct {
+  uint32_t size;        // bytes, 0 for no cache
+  uint32_t ways;
+  uint32_t line;        // bytes of a line, power of two
+  CACHE_POLICY policy;
+  int write_through;    // stores go to memory and do not allocate, else write-back and write-allocate
+} CACHE_CONFIG;
+
+/* Misses of one instruction address */
+typedef struct {
+  uint32_t pc;
+  uint32_t used;        // entry holds a pc
+  uint64_t misses;
+} CACHE_PC;
+
+typedef struct {
+  const char *name;
+  CACHE_CONFIG config;
+  uint32_t sets;
+  uint32_t stride;      // ways stored per set, a multiple of 4
+  uint32_t line_bits;
+  uint32_t *tags;       // sets * stride line numbers
+  uint64_t *used;       // sets * stride last access, LRU
+  uint64_t *plru;       // tree bits of each set, PLRU
+  uint8_t *dirty;       // sets * stride, write-back
+  uint64_t clock;       // accesses so far, the LRU time
+  uint32_t seed;        // xorshift state, random replacement
+  CACHE_PC *pcs;        // open addressing table of the misses per pc
+  uint32_t num_pcs;
+  uint32_t max_pcs;     // entries allocated, a power of two
+  /* counters */
+  uint64_t reads;
+  uint64_t writes;
+  uint64_t read_misses;
+  uint64_t write_misses;
+  uint64_t writebacks;  // dirty lines evicted
+  uint64_t mem_writes;  // stores written through
+} CACHE;
+
+/**
+ * Parse "SIZE:WAYS:LINE[:lru|plru|random][:wb|wt]", SIZE with an optional K or M.
+ * param: config        [out] the configuration, LRU and write-back when not given
+ * param: text          [in]  the description
+ * return: error code, -1 when it is not valid or not a geometry cache_create() accepts
+ */
+int cache_parse(CACHE_CONFIG *config, const char *text);
+
+/**
+ * Create an empty cache.
+ * param: cache         [out] pointer to the cache
+ * param: name          [in]  name in the statistics
+ * param: config        [in]  configuration, copied
+ * return: error code, -1 for a bad geometry, -2 when it can not be allocated;
+ *         cache_dispose() frees what was created in any case
+ */
+int cache_create(CACHE *cache, const char *name, const CACHE_CONFIG *config);
+
+/**
+ * Access the line of an address.
+ * param: cache         [in] the cache pointer
+ * param: addr          [in] guest address
+ * param: write         [in] 1 for a store
+ * param: pc            [in] address of the instruction, for the misses per pc
+ * return:              1 on a hit, 0 on a miss
+ */
+int cache_access(CACHE *cache, uint32_t addr, int write, uint32_t pc);
+
+/**
+ * Print the hits, misses, write-backs and the instructions with most misses.
+ * param: cache         [in] the cache pointer
+ * param: out           [in] output stream
+ */
+void cache_stats(CACHE *cache, FILE *out);
+
+/**
+ * Dispose the cache.
+ * param: cache         [out] pointer to the cache
+ */
+void cache_dispose(CACHE *cache);
+
+#endif
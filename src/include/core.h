@@ -5,11 +5,23 @@
 #include "mem.h"
 #include "ringbuffer.h"
 
+typedef struct PREDECODE PREDECODE;
+typedef struct BLOCK_CACHE BLOCK_CACHE;
+typedef struct JIT JIT;
+typedef struct BUS BUS;
+typedef struct SYS SYS;
+
 /* ref: https://en.wikichip.org/wiki/risc-v/registers*/
 typedef struct {
   uint32_t regs[32];
   size_t pc;
   uint8_t *ram;
+  PREDECODE *pd;        // predecoded instruction cache, NULL if not used
+  uint32_t code_limit;  // stores below it may overwrite cached code, 0 without caches
+  uint32_t ram_limit;   // loads below it and stores in [code_limit, ram_limit) go straight to RAM
+  BUS *bus;             // devices above the RAM, NULL if none
+  SYS *sys;             // system calls of ECALL, NULL if none
+  BLOCK_CACHE *bc;      // translated basic blocks, NULL if not used
 } CORE;
 
 /* Instruction Format */
@@ -24,21 +36,93 @@ typedef struct {
 } INST;
 
 /* Log Struct */
+/* Register numbers and mnemonic are not stored, log.txt rebuilds them from h_inst */
 typedef struct {
   uint32_t h_pc;		// Ex: PC=00000100
   uint32_t h_inst;  	// [012345678]
-  uint32_t h_rd;   		// indicado pelos bits 7-11, registrador de destino (rd) , eg r15  x15=000AAA00, aps instruo
-  uint32_t rd;
-  uint32_t h_rs1;		// registrador de origem 1 (rs1), eg r3  x03=99988877, registrador indicado pelos bits 15-19, antes da instruo
-  uint32_t rs1;
-  uint32_t h_rs2;   	//  registrador de origem 2 (rs2), idem utilizando os bits 20-24, antes da instruo
-  uint32_t rs2;
-  char mne[64]; 		//  mnemnico
+  uint32_t h_rd;   		// indicado pelos bits 7-11, registrador de destino (rd) , eg r15  x15=000AAA00, após instrução
+  uint32_t h_rs1;		// registrador de origem 1 (rs1), eg r3  x03=99988877, registrador indicado pelos bits 15-19, antes da instrução
+  uint32_t h_rs2;   	//  registrador de origem 2 (rs2), idem utilizando os bits 20-24, antes da instrução
 } RLOG;
 
+/* h_pc of a record that marks a point of the log instead of an instruction, */
+/* never the one of an instruction as the PC is even: h_inst is the mark number, */
+/* h_rd and h_rs1 the low and high words of the instruction count, h_rs2 the next PC */
+#define RLOG_MARK   0xFFFFFFFFu
+
+/* Fully resolved instructions, FILL and LOOKUP are cache control entries */
+#define CORE_OPS(X) \
+  X(FILL) X(LOOKUP) X(NOP) \
+  X(LB) X(LH) X(LW) X(LBU) X(LHU) X(SB) X(SH) X(SW) \
+  X(ADDI) X(XORI) X(ORI) X(ANDI) \
+  X(ADD) X(MUL) X(SUB) X(XOR) X(OR) X(AND) \
+  X(LUI) X(AUIPC) X(JAL) X(JALR) \
+  X(BEQ) X(BNE) X(BLT) X(BGE) X(BLTU) X(BGEU) \
+  X(ECALL)
+
+#define CORE_OP_ENUM(name) OP_##name,
+enum { CORE_OPS(CORE_OP_ENUM) OP_COUNT };
+
+/* Predecoded instruction, filled once per PC by core_predecode() */
+typedef struct DECODED DECODED;
+typedef void (*EXEC_FN)(CORE *, const DECODED *);
+
+struct DECODED {
+  EXEC_FN exec;         // handler of the fully resolved instruction, NULL if not decoded yet
+  const void *label;    // handler address for the threaded engine
+  uint32_t raw;         // instruction word
+  int32_t imm;          // sign-extended immediate of the instruction format
+  uint8_t op;           // OP_* of the instruction, OP_FILL (0) if not decoded yet
+  uint8_t rd;
+  uint8_t rs1;
+  uint8_t rs2;
+  uint8_t wd;           // register written, writes to x0 go to the sink register 32
+};
+
 uint32_t core_load(CORE *core, uint32_t addr, uint8_t size);
-void core_store(CORE *cup, uint32_t addr, uint32_t value, uint8_t size);
+int core_store(CORE *cup, uint32_t addr, uint32_t value, uint8_t size);
+
+/* Accesses off the fast path: devices, code in the caches, or a guest fault */
+#define CORE_STORE_HALT   1     // the guest halted the run
+#define CORE_STORE_LEAVE  2     // the store overwrote the running block, run from the next PC
+uint32_t core_load_slow(CORE *core, uint32_t addr, uint8_t size);
+int core_store_slow(CORE *core, uint32_t addr, uint32_t value, uint8_t size);
+
+/* Drop the predecoded instructions and blocks of [addr, addr + len) written from outside a store */
+void core_code_written(CORE *core, uint32_t addr, uint32_t len);
+
+/* Loads and stores of one width, picked when the instruction is decoded */
+/* RAM accesses pay one compare, stores return CORE_STORE_HALT or CORE_STORE_LEAVE */
+#define CORE_LOAD_FAST(core, addr)  ((addr) < (core)->ram_limit)
+#define CORE_STORE_FAST(core, addr) ((addr) - (core)->code_limit < (core)->ram_limit - (core)->code_limit)
+static inline uint32_t core_load8(CORE *core, uint32_t addr) {
+  return CORE_LOAD_FAST(core, addr) ? ram_load8(core->ram, addr) : core_load_slow(core, addr, 8);
+}
+static inline uint32_t core_load16(CORE *core, uint32_t addr) {
+  return CORE_LOAD_FAST(core, addr) ? ram_load16(core->ram, addr) : core_load_slow(core, addr, 16);
+}
+static inline uint32_t core_load32(CORE *core, uint32_t addr) {
+  return CORE_LOAD_FAST(core, addr) ? ram_load32(core->ram, addr) : core_load_slow(core, addr, 32);
+}
+static inline int core_store8(CORE *core, uint32_t addr, uint32_t value) {
+  if (!CORE_STORE_FAST(core, addr)) return core_store_slow(core, addr, value, 8);
+  ram_store8(core->ram, addr, value);
+  return 0;
+}
+static inline int core_store16(CORE *core, uint32_t addr, uint32_t value) {
+  if (!CORE_STORE_FAST(core, addr)) return core_store_slow(core, addr, value, 16);
+  ram_store16(core->ram, addr, value);
+  return 0;
+}
+static inline int core_store32(CORE *core, uint32_t addr, uint32_t value) {
+  if (!CORE_STORE_FAST(core, addr)) return core_store_slow(core, addr, value, 32);
+  ram_store32(core->ram, addr, value);
+  return 0;
+}
 void core_decode(uint32_t raw_inst, INST *inst);
+void core_disasm(uint32_t raw_inst, char *mne, size_t size);
 void core_execute(CORE *, uint32_t inst, RLOG *);
+void core_predecode(uint32_t raw_inst, DECODED *dec);
+void core_execute_decoded(CORE *, const DECODED *, RLOG *);
 
 #endif
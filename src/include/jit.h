@@ -0,0 +1,95 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "common.h"
+#include "core.h"
+#include "block.h"
+
+#define JIT_CODE_SIZE      (16 << 20)   // native code buffer by default, flushed when full
+#define JIT_MIN_CODE_SIZE  (16 << 10)   // smallest buffer, room for the largest block
+#define JIT_THRESHOLD      50           // block executions before compiling it
+
+/* Store done by a native block in check mode, undone before the interpreter runs */
+typedef struct {
+  uint32_t addr;
+  uint32_t old;         // memory before the store
+  uint32_t val;         // memory after the whole block
+  uint8_t size;
+} JIT_STORE;
+
+/* x86-64 compiler of hot blocks */
+struct JIT {
+  uint8_t *code;        // executable buffer
+  size_t size;          // bytes of the buffer
+  size_t used;          // bytes of code emitted
+  uint64_t threshold;   // compile a block on this execution
+  int check;            // run each native block against the interpreter
+  uint32_t code_limit;  // stores below this address may overwrite code, they go through core_store
+  uint32_t ram_limit;   // accesses from this address up may hit devices, they go through the core
+  JIT_STORE stores[BLOCK_MAX_INSTS];
+  uint32_t num_stores;
+  /* counters */
+  uint64_t compiled;
+  uint64_t rejected;    // blocks with instructions the JIT does not support
+  uint64_t flushes;
+  uint64_t native_insts;
+  uint64_t checked;
+  uint64_t mismatches;
+};
+
+/**
+ * Create the JIT, fails when the host is not x86-64 or has no executable memory.
+ * param: jit           [out] pointer to the JIT
+ * param: code_limit    [in]  size of the guest code region
+ * param: ram_limit     [in]  guest addresses below it are RAM accessed inline
+ * param: threshold     [in]  executions of a block before compiling it
+ * param: size          [in]  bytes of the native code buffer, at least JIT_MIN_CODE_SIZE
+ * param: check         [in]  cross-check native blocks against the interpreter
+ * return: error code, -1 for a buffer too small
+ */
+int jit_create(JIT *jit, uint32_t code_limit, uint32_t ram_limit, uint64_t threshold, size_t size, int check);
+
+/**
+ * Compile a block, on success b->native is set.
+ * param: jit           [in] the JIT pointer
+ * param: bc            [in] block cache of the block, flushed when the code buffer is full
+ * param: b             [in] the block
+ * return:              0 on success, -1 if the block can not be compiled
+ */
+int jit_compile(JIT *jit, BLOCK_CACHE *bc, BLOCK *b);
+
+/**
+ * Check mode: undo the stores of the native block just run, keeping their results.
+ * param: jit           [in] the JIT pointer
+ * param: ram           [in] guest memory
+ */
+void jit_check_undo(JIT *jit, uint8_t *ram);
+
+/**
+ * Check mode: compare the native run of a block with the interpreter run.
+ * param: jit           [in] the JIT pointer
+ * param: b             [in] the block
+ * param: regs          [in] registers after the interpreter
+ * param: pc            [in] next PC after the interpreter
+ * param: jit_regs      [in] registers after the native code
+ * param: jit_pc        [in] next PC returned by the native code
+ * param: ram           [in] guest memory after the interpreter
+ * return:              0 when both agree
+ */
+int jit_check_compare(JIT *jit, BLOCK *b, const uint32_t *regs, uint32_t pc,
+                      const uint32_t *jit_regs, uint32_t jit_pc, uint8_t *ram);
+
+/**
+ * Print the JIT counters.
+ * param: jit           [in] the JIT pointer
+ * param: out           [in] output stream
+ */
+void jit_stats(JIT *jit, FILE *out);
+
+/**
+ * Dispose the JIT.
+ * param: jit           [out] pointer to the JIT
+ */
+void jit_dispose(JIT *jit);
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef LOGFMT_H
+#define LOGFMT_H
+
+#include "common.h"
+#include "core.h"
+
+#define LOGFMT_FIXED        (12 + 11 + 3 * 13)          // PC, [inst] and three registers lines
+#define LOGFMT_MAX_RECORD   (LOGFMT_FIXED + 64)         // and the mnemonic line
+#define LOGFMT_MARK         (9 + 8 + 16 + 16 + 4 + 8 + 1)   // "# sample N at instruction N PC=X" line of a mark
+#define LOGFMT_MNE_BITS     10                          // entries of the mnemonic cache
+#define LOGFMT_OUT_SIZE     (1 << 20)                   // bytes gathered before each write
+
+/* Text formatter of the log.txt records */
+/* The mnemonic only depends on the instruction word, the last ones */
+/* formatted are kept in a direct-mapped cache indexed by the word */
+typedef struct {
+  uint32_t inst[1 << LOGFMT_MNE_BITS];
+  uint8_t len[1 << LOGFMT_MNE_BITS];      // mnemonic length + 1, 0 if the entry is empty
+  char mne[1 << LOGFMT_MNE_BITS][64];
+} LOGFMT;
+
+/* Buffered output of formatted records to a file descriptor */
+typedef struct {
+  int fd;
+  char *buf;
+  size_t len;           // bytes in buf
+  size_t size;          // bytes allocated
+  int error;            // a write failed
+} LOGFMT_OUT;
+
+/**
+ * Write the 8 lowercase hex digits of a value, without terminator.
+ * SSE2 converts the 8 nibbles at once when available.
+ * param: out           [out] 8 characters
+ * param: v             [in]  value
+ */
+void logfmt_hex8(char *out, uint32_t v);
+
+/**
+ * Initialize the formatter.
+ * param: fmt           [out] pointer to the formatter
+ */
+void logfmt_init(LOGFMT *fmt);
+
+/**
+ * Format one record in the log.txt layout, without terminator. A mark record
+ * (h_pc RLOG_MARK) is one line: "# sample N at instruction N PC=X", in hex.
+ * param: fmt           [in]  the formatter pointer
+ * param: out           [out] at least LOGFMT_MAX_RECORD characters
+ * param: rec           [in]  the record
+ * return:              characters written
+ */
+size_t logfmt_record(LOGFMT *fmt, char *out, const RLOG *rec);
+
+/**
+ * Size of the text of a record, it only depends on its instruction word, or on it being a mark.
+ * param: fmt           [in] the formatter pointer
+ * param: rec           [in] the record
+ * return:              characters logfmt_record() writes for it
+ */
+size_t logfmt_record_size(LOGFMT *fmt, const RLOG *rec);
+
+/**
+ * Create the output buffer.
+ * param: out           [out] pointer to the output
+ * param: fd            [in]  file descriptor written to
+ * param: size          [in]  bytes gathered before each write
+ * return: error code
+ */
+int logfmt_out_create(LOGFMT_OUT *out, int fd, size_t size);
+
+/**
+ * Write the buffered bytes to the file descriptor.
+ * param: out           [in] the output pointer
+ */
+void logfmt_out_flush(LOGFMT_OUT *out);
+
+/**
+ * Format one record into the output buffer, writing it out when full.
+ * param: out           [in] the output pointer
+ * param: fmt           [in] the formatter pointer
+ * param: rec           [in] the record
+ */
+static inline void logfmt_out_put(LOGFMT_OUT *out, LOGFMT *fmt, const RLOG *rec) {
+  if (out->size - out->len < LOGFMT_MAX_RECORD) logfmt_out_flush(out);
+  out->len += logfmt_record(fmt, out->buf + out->len, rec);
+}
+
+/**
+ * Flush and free the output buffer, the file descriptor is left open.
+ * param: out           [in] the output pointer
+ */
+void logfmt_out_dispose(LOGFMT_OUT *out);
+
+#endif
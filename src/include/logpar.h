@@ -0,0 +1,78 @@
+#ifndef LOGPAR_H
+#define LOGPAR_H
+
+#include "common.h"
+#include <pthread.h>
+#include "core.h"
+#include "logfmt.h"
+
+#define LOGPAR_CHUNK        8192    // records formatted by a thread at a time
+#define LOGPAR_MAX_THREADS  256
+
+/*
+ * Parallel log.txt formatting of stored records.
+ * The records are split in chunks. The threads first add up the text size
+ * of each chunk, a prefix sum of those sizes gives the file offset of
+ * every chunk, then each thread formats its chunks and writes them with
+ * pwrite() at their offsets. The output has the same bytes as formatting
+ * the records one after the other.
+ */
+typedef struct LOGPAR LOGPAR;
+
+/* Work of one thread of the pool */
+typedef struct {
+  LOGPAR *pool;
+  pthread_t thread;
+  LOGFMT fmt;           // mnemonic cache of the thread
+  char *buf;            // text of the chunk being written
+} LOGPAR_WORKER;
+
+struct LOGPAR {
+  int num_threads;      // workers, the calling thread is worker 0
+  LOGPAR_WORKER *workers;
+  pthread_barrier_t start;      // a job is ready, or the pool is closing
+  pthread_barrier_t sized;      // every chunk size is known
+  pthread_barrier_t offsets;    // the prefix sum is done
+  pthread_barrier_t done;       // every chunk is written
+  int quit;
+  pthread_mutex_t lock;         // guards started
+  pthread_cond_t launched;      // started is no longer 0
+  int started;          // 1 once every thread started, -1 when one could not be
+  /* current job */
+  const RLOG *recs;
+  size_t num_recs;
+  size_t num_chunks;
+  uint64_t *offset;     // size of each chunk, then its file offset, num_chunks + 1 entries
+  size_t max_chunks;    // entries allocated in offset - 1
+  int fd;
+  _Atomic size_t next;  // next chunk to take
+  _Atomic int error;    // a pwrite failed
+};
+
+/**
+ * Create the formatting pool.
+ * param: pool          [out] pointer to the pool
+ * param: threads       [in]  number of threads, 0 for one per online CPU
+ * return: error code, -2 when it can not be allocated, -4 when a thread can not
+ *         be started; the threads started are joined and the pool is not used
+ */
+int logpar_create(LOGPAR *pool, int threads);
+
+/**
+ * Format records to a file at an offset, in parallel.
+ * param: pool          [in] the pool pointer
+ * param: fd            [in] file descriptor written with pwrite()
+ * param: offset        [in] file offset of the first record
+ * param: recs          [in] the records
+ * param: n             [in] number of records
+ * return:              bytes written, negative if a write failed
+ */
+int64_t logpar_write(LOGPAR *pool, int fd, uint64_t offset, const RLOG *recs, size_t n);
+
+/**
+ * Stop the threads and dispose the pool.
+ * param: pool          [out] pointer to the pool
+ */
+void logpar_dispose(LOGPAR *pool);
+
+#endif
@@ -2,9 +2,133 @@
 #define MEM_H
 
 #include "common.h"
+#include <setjmp.h>
+#include <signal.h>
 
+#define MEM_RAM_SIZE        8192000         // default guest RAM, the initial stack pointer
+#define MEM_RAM_MAX         (1ull << 32)    // the whole rv32 address space
+#define MEM_HUGE_PAGE       (2u << 20)      // transparent huge page size
+#define MEM_GUARD           (64u << 10)     // inaccessible bytes past the 4 GB, a word access at its end faults there
+
+/* Guest RAM, an anonymous mapping committed page by page as the guest */
+/* touches it, with the program image mapped copy-on-write at address 0 */
+/* The whole 4 GB guest address space is reserved, the addresses above the */
+/* RAM are PROT_NONE: any 32-bit address from base is a host access that */
+/* either hits the RAM or faults, so loads and stores need no bounds check */
+typedef struct {
+  uint8_t *base;        // guest address 0
+  size_t size;          // bytes of guest RAM
+  size_t map_size;      // bytes accessible from base, the whole RAM
+  size_t image;         // bytes of the program image at address 0
+  void *map;            // the reservation, before aligning base for huge pages
+  size_t map_len;
+  uint32_t fault_addr;  // guest address of the last access fault
+} RAM;
+
+/* Guest memory is little-endian. On a little-endian host an access is one */
+/* native load or store, memcpy() keeps it legal at unaligned addresses */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define MEM_HOST_LE
+#endif
+
+static inline uint32_t ram_load8(const uint8_t *mem, uint32_t addr) {
+  return mem[addr];
+}
+
+static inline uint32_t ram_load16(const uint8_t *mem, uint32_t addr) {
+#ifdef MEM_HOST_LE
+  uint16_t v;
+  memcpy(&v, mem + addr, sizeof(v));
+  return v;
+#else
+  return (uint32_t)mem[addr] | ((uint32_t)mem[addr + 1] << 8);
+#endif
+}
+
+static inline uint32_t ram_load32(const uint8_t *mem, uint32_t addr) {
+#ifdef MEM_HOST_LE
+  uint32_t v;
+  memcpy(&v, mem + addr, sizeof(v));
+  return v;
+#else
+  return (uint32_t)mem[addr] | ((uint32_t)mem[addr + 1] << 8) |
+         ((uint32_t)mem[addr + 2] << 16) | ((uint32_t)mem[addr + 3] << 24);
+#endif
+}
+
+static inline void ram_store8(uint8_t *mem, uint32_t addr, uint32_t value) {
+  mem[addr] = (uint8_t)value;
+}
+
+static inline void ram_store16(uint8_t *mem, uint32_t addr, uint32_t value) {
+#ifdef MEM_HOST_LE
+  uint16_t v = (uint16_t)value;
+  memcpy(mem + addr, &v, sizeof(v));
+#else
+  mem[addr] = (uint8_t)value;
+  mem[addr + 1] = (uint8_t)(value >> 8);
+#endif
+}
+
+static inline void ram_store32(uint8_t *mem, uint32_t addr, uint32_t value) {
+#ifdef MEM_HOST_LE
+  memcpy(mem + addr, &value, sizeof(value));
+#else
+  mem[addr] = (uint8_t)value;
+  mem[addr + 1] = (uint8_t)(value >> 8);
+  mem[addr + 2] = (uint8_t)(value >> 16);
+  mem[addr + 3] = (uint8_t)(value >> 24);
+#endif
+}
+
+/* Access of a width known only at run time, 8, 16 or 32 bits */
 uint32_t ram_load(uint8_t *mem, uint32_t addr, uint8_t size);
 
 void ram_store(uint8_t *mem, uint32_t addr, uint32_t value, uint8_t size);
 
+/**
+ * Create the guest RAM, no page is committed until it is touched.
+ * param: ram           [out] pointer to the RAM
+ * param: size          [in]  bytes of guest RAM, a multiple of the page size up to MEM_RAM_MAX
+ * param: huge          [in]  ask for transparent huge pages
+ * return: error code, -1 for a bad size
+ */
+int ram_create(RAM *ram, size_t size, int huge);
+
+/**
+ * Map a program image at guest address 0. The file pages are private,
+ * guest stores to them are copied and never reach the file.
+ * param: ram           [in] the RAM pointer
+ * param: path          [in] binary file
+ * return: error code, -3 if the image is larger than the RAM
+ */
+int ram_map_image(RAM *ram, const char *path);
+
+/**
+ * Copy a program image to guest address 0.
+ * param: ram           [in] the RAM pointer
+ * param: buf           [in] the image
+ * param: len           [in] bytes of the image
+ * return: error code, -3 if the image is larger than the RAM
+ */
+int ram_copy_image(RAM *ram, const void *buf, size_t len);
+
+/**
+ * Turn host faults inside the guest address space into guest access faults,
+ * for the calling thread. The SIGSEGV handler, installed on the first call,
+ * saves the guest address in fault_addr and returns to resume with
+ * siglongjmp(), other faults still end the process. The signal mask is left
+ * as it is, so resume can be set with sigsetjmp(resume, 0).
+ * param: ram           [in] the RAM pointer, NULL to stop guarding
+ * param: resume        [in] set by the caller with sigsetjmp()
+ * return: error code
+ */
+int ram_guard(RAM *ram, sigjmp_buf *resume);
+
+/**
+ * Unmap the guest RAM and dispose it.
+ * param: ram           [out] pointer to the RAM
+ */
+void ram_dispose(RAM *ram);
+
 #endif
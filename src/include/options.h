@@ -0,0 +1,49 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "common.h"
+#include "sample.h"
+#include "sim.h"
+
+typedef struct {
+  const char *filename; // rv32im binary to run, the first one of files
+  const char **files;   // binaries given, more than one in batch mode
+  int num_files;
+  int batch;            // run the binaries and the manifest at once on a thread pool
+  const char *manifest; // file listing binaries for the batch mode
+  int jobs;             // threads of the batch mode, 0 for one per online CPU
+  int stats;            // print engine counters to stderr at the end
+  uint64_t max_insts;   // instructions run before stopping, UINT64_MAX for no limit
+  int snapshot_at;      // save a snapshot during the run
+  int snapshot_at_pc;   // at the first time the PC is snapshot_pc, else after snapshot_insts
+  uint32_t snapshot_pc;
+  uint64_t snapshot_insts;  // instructions from the start of the program
+  const char *snapshot_file;    // snapshot written, snapshot.snap by default
+  const char *restore;  // snapshot to start from instead of a binary
+  int sampling;         // log only the samples, fast-forward between them
+  SAMPLE_CONFIG sample;
+  SIM_CONFIG sim;       // engine, log, JIT and memory of the simulator
+} OPTIONS;
+
+/**
+ * Parse the command line.
+ * param: opt           [out] parsed options, defaults for the ones not given
+ * param: argc          [in]  argument count from main()
+ * param: argv          [in]  arguments from main()
+ * return:              0 on success, -1 on a bad or missing argument
+ */
+int options_parse(OPTIONS *opt, int argc, char *argv[]);
+
+/**
+ * Free what options_parse() allocated.
+ * param: opt           [in] parsed options
+ */
+void options_dispose(OPTIONS *opt);
+
+/**
+ * Print the command line help.
+ * param: prog          [in] program name
+ */
+void options_usage(const char *prog);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "common.h"
+#include "timing.h"
+
+#define PIPELINE_MUL_LATENCY        3   // cycles of MUL in EX by default
+#define PIPELINE_BRANCH_PENALTY     2   // fetches lost by a taken branch or a JALR, resolved in EX
+#define PIPELINE_JUMP_PENALTY       1   // fetches lost by a JAL, resolved in ID
+
+/*
+ * Classic in-order IF/ID/EX/MEM/WB pipeline, one instruction per cycle.
+ * Each instruction is timed by the cycle it is in ID:
+ * - a source register is read in ID once its producer can give it: with forwarding
+ *   the next cycle after an ALU result, two cycles after a load (load-use stall),
+ *   without forwarding once the producer is in WB (written before read in a cycle)
+ * - MUL holds EX for its latency, the instructions behind it wait
+ * - branches are predicted not taken: a taken branch or a JALR loses the fetches
+ *   until EX, a JAL the fetch until ID
+ */
+
+typedef struct {
+  int forwarding;       // results bypassed from EX/MEM and MEM/WB to EX
+  uint32_t mul_latency; // cycles of MUL in EX, 1 or more
+  uint32_t branch_penalty;  // cycles lost by a taken branch or a JALR
+  uint32_t jump_penalty;    // cycles lost by a JAL
+} PIPELINE_CONFIG;
+
+typedef struct {
+  TIMING timing;        // first, the model is used through it
+  PIPELINE_CONFIG config;
+  uint64_t next;        // earliest cycle in ID of the next instruction
+  uint64_t ready[32];   // earliest cycle in ID of an instruction reading each register
+  /* counters */
+  uint64_t load_use;    // cycles stalled on a load result
+  uint64_t data;        // cycles stalled on other results, without forwarding
+  uint64_t mul;         // cycles the multiplier held EX
+  uint64_t branches;    // conditional branches, taken ones, jumps and cycles lost
+  uint64_t taken;
+  uint64_t jumps;
+  uint64_t flushed;
+} PIPELINE;
+
+/**
+ * Fill a configuration with the defaults: forwarding, PIPELINE_MUL_LATENCY,
+ * PIPELINE_BRANCH_PENALTY and PIPELINE_JUMP_PENALTY.
+ * param: config        [out] the configuration
+ */
+void pipeline_config_default(PIPELINE_CONFIG *config);
+
+/**
+ * Create the pipeline model, empty.
+ * param: pipe          [out] pointer to the model, disposed through pipe->timing
+ * param: config        [in]  configuration, copied
+ * return: error code
+ */
+int pipeline_create(PIPELINE *pipe, const PIPELINE_CONFIG *config);
+
+/**
+ * Dispose the pipeline model, its timing.dispose function.
+ * param: timing        [out] the timing header of the model
+ */
+void pipeline_dispose(TIMING *timing);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef PREDECODE_H
+#define PREDECODE_H
+
+#include "common.h"
+#include "core.h"
+
+#define PREDECODE_PAGE_BITS   12                                  // 4 KiB code pages
+#define PREDECODE_PAGE_INSTS  (1 << (PREDECODE_PAGE_BITS - 2))    // instructions per page
+
+/* Predecoded instruction cache keyed by PC */
+/* Each page table ends with an OP_LOOKUP entry, so code running */
+/* through a table can always step to the next entry */
+struct PREDECODE {
+  DECODED **pages;      // entries of each code page plus its LOOKUP, allocated when the page first executes
+  uint32_t num_pages;
+  uint32_t limit;       // bytes of guest memory covered by the cache
+  uint8_t *ram;         // guest memory the instructions are read from
+  const void *const *labels;  // threaded engine handlers by OP_*, NULL if not in use
+  DECODED scratch[2];   // entry used for PCs out of the cache (not word aligned) and its LOOKUP
+};
+
+/**
+ * Create the predecode cache.
+ * param: pd            [out] pointer to the cache
+ * param: ram           [in]  guest memory holding the code
+ * param: limit         [in]  size in bytes of the code region to cache
+ * return: error code
+ */
+int predecode_create(PREDECODE *pd, uint8_t *ram, uint32_t limit);
+
+/**
+ * Decode the instruction at pc into its cache entry.
+ * param: pd            [in] the cache pointer
+ * param: pc            [in] guest address of the instruction
+ * return:              the filled entry
+ */
+DECODED *predecode_fill(PREDECODE *pd, uint32_t pc);
+
+/**
+ * Get the predecoded instruction at pc, decoding it on first use.
+ * param: pd            [in] the cache pointer
+ * param: pc            [in] guest address of the instruction
+ * return:              the entry, valid until the next store in its page
+ */
+static inline DECODED *predecode_fetch(PREDECODE *pd, uint32_t pc) {
+  if (pc < pd->limit && (pc & 3) == 0) {
+    DECODED *page = pd->pages[pc >> PREDECODE_PAGE_BITS];
+    if (page) {
+      DECODED *dec = &page[(pc >> 2) & (PREDECODE_PAGE_INSTS - 1)];
+      if (dec->exec) return dec;
+    }
+  }
+  return predecode_fill(pd, pc);
+}
+
+/**
+ * Install the threaded engine handler addresses on every entry.
+ * param: pd            [in] the cache pointer
+ * param: labels        [in] handler address of each OP_*
+ */
+void predecode_set_labels(PREDECODE *pd, const void *const *labels);
+
+/**
+ * Drop the entries overwritten by a guest store.
+ * param: pd            [in] the cache pointer
+ * param: addr          [in] store address
+ * param: size          [in] store width in bits
+ */
+void predecode_invalidate(PREDECODE *pd, uint32_t addr, uint8_t size);
+
+/**
+ * Dispose the cache.
+ * param: pd            [out] pointer to the cache
+ */
+void predecode_dispose(PREDECODE *pd);
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef RETIRE_H
+#define RETIRE_H
+
+#include "common.h"
+#include <pthread.h>
+#include "core.h"
+#include "ringbuffer.h"
+
+#define RETIRE_THREADS      8           // model threads at most
+#define RETIRE_BLOCK_RECS   256         // records published at once
+#define RETIRE_BLOCKS       256         // blocks queued to each thread
+#define RETIRE_DECODED      1024        // instructions decoded again by each thread, by PC
+#define RETIRE_SLEEP        50          // microseconds a thread sleeps on an empty queue
+
+/*
+ * Retired instruction stream: the simulation loop publishes a compact record of
+ * each retired instruction and model threads consume it, so the timing, cache
+ * and branch models run beside the simulation instead of inside it. Records are
+ * gathered in blocks, each thread has its own ring of blocks (one writer, one
+ * reader, no lock) and decodes the instruction words again. The models are split
+ * between the threads: each model is only used by its thread, in program order.
+ */
+
+/* One retired instruction */
+typedef struct {
+  uint32_t pc;
+  uint32_t raw;         // instruction word
+  uint32_t addr;        // guest address of a load or a store
+  uint32_t next_pc;     // not pc + 4 after a taken branch or a jump
+} RETIRE_REC;
+
+typedef struct {
+  uint32_t count;       // records used
+  RETIRE_REC recs[RETIRE_BLOCK_RECS];
+} RETIRE_BLOCK;
+
+/* gives a record to the models of the bits of models */
+typedef void (*RETIRE_FN)(void *ctx, uint32_t models, const DECODED *dec, const RETIRE_REC *rec);
+
+/* Decoded instruction of a thread */
+typedef struct {
+  uint32_t pc;          // odd when empty
+  DECODED dec;
+} RETIRE_DECODED_ENTRY;
+
+typedef struct RETIRE RETIRE;
+
+typedef struct {
+  RETIRE *retire;
+  RINGBUFFER_REC *ring; // blocks not consumed yet
+  pthread_t thread;
+  uint32_t models;      // bits given to the function
+  RETIRE_DECODED_ENTRY *decoded;
+  _Atomic uint64_t records;  // records consumed
+  _Atomic uint64_t idle;     // times the ring was found empty
+} RETIRE_WORKER;
+
+struct RETIRE {
+  RETIRE_FN fn;
+  void *ctx;
+  int num_threads;      // threads started
+  RETIRE_BLOCK block;   // records not published yet
+  _Atomic int done;     // no more blocks will be published
+  RETIRE_WORKER workers[RETIRE_THREADS];
+  /* counters */
+  uint64_t blocks;      // blocks published
+  uint64_t stalls;      // times a ring was full
+  uint64_t syncs;       // waits for the threads to catch up
+};
+
+/**
+ * Start the model threads.
+ * param: retire        [out] pointer to the stream
+ * param: threads       [in]  model threads, 1 to RETIRE_THREADS
+ * param: models        [in]  bits of each thread, given to fn with its records
+ * param: fn            [in]  function feeding the models
+ * param: ctx           [in]  first argument of fn
+ * return: error code, -1 for a bad number of threads, -2 when it can not be
+ *         allocated, -4 when a thread can not be started; retire_dispose() frees
+ *         what was created in any case
+ */
+int retire_create(RETIRE *retire, int threads, const uint32_t *models, RETIRE_FN fn, void *ctx);
+
+/**
+ * Publish the records gathered to all the threads, waiting for room in their rings.
+ * param: retire        [in] the stream pointer
+ */
+void retire_flush(RETIRE *retire);
+
+/**
+ * Add a retired instruction, published with a full block.
+ * param: retire        [in] the stream pointer
+ * param: pc            [in] its address
+ * param: raw           [in] instruction word
+ * param: addr          [in] guest address of a load or a store
+ * param: next_pc       [in] address of the next instruction
+ */
+static inline void retire_put(RETIRE *retire, uint32_t pc, uint32_t raw, uint32_t addr, uint32_t next_pc) {
+  RETIRE_REC *rec = &retire->block.recs[retire->block.count++];
+  rec->pc = pc;
+  rec->raw = raw;
+  rec->addr = addr;
+  rec->next_pc = next_pc;
+  if (retire->block.count == RETIRE_BLOCK_RECS) retire_flush(retire);
+}
+
+/**
+ * Publish the records gathered and wait until the threads consumed all of them,
+ * the models are then up to date.
+ * param: retire        [in] the stream pointer
+ */
+void retire_sync(RETIRE *retire);
+
+/**
+ * Print the records of each thread and the waits of the simulation.
+ * param: retire        [in] the stream pointer
+ * param: out           [in] output stream
+ */
+void retire_stats(RETIRE *retire, FILE *out);
+
+/**
+ * Give the last records to the models, stop the threads and dispose the stream.
+ * param: retire        [out] pointer to the stream
+ */
+void retire_dispose(RETIRE *retire);
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef REUSE_H
+#define REUSE_H
+
+#include "common.h"
+
+#define REUSE_MAX_WAYS      64          // deepest set stack, associativities 1 to 64
+#define REUSE_SET_BITS      14          // set-associative curves up to 2^14 sets
+#define REUSE_EMPTY         0xFFFFFFFFu
+
+/*
+ * LRU stack distance analysis: one pass over the accessed lines gives the miss
+ * ratio of every LRU cache of that line size, instead of one run per cache.
+ * The stack distance of an access is the number of other lines accessed since
+ * the last access to its line, it hits in every fully associative cache holding
+ * more lines than that. It is counted with a Fenwick tree over the access times,
+ * where each line holds a 1 at the time of its last access: O(log n) per access.
+ * For the set-associative caches, the lines of each set of each power of two
+ * number of sets are kept in LRU stacks REUSE_MAX_WAYS deep: a line found at
+ * depth p hits in every cache with more than p ways and that many sets.
+ */
+
+/* Last access of a line */
+typedef struct {
+  uint32_t line;        // REUSE_EMPTY for a free entry
+  uint32_t time;
+} REUSE_LINE;
+
+typedef struct {
+  const char *name;
+  uint32_t line;        // bytes of a line, power of two
+  uint32_t line_bits;
+  REUSE_LINE *lines;    // open addressing table of the lines seen
+  uint32_t num_lines;
+  uint32_t max_lines;   // entries allocated, a power of two
+  uint32_t *tree;       // Fenwick tree over the times 1 to max_time
+  uint32_t *owner;      // entry of lines[] that accessed at each time
+  uint32_t max_time;
+  uint32_t now;         // time of the next access, times are renumbered when it passes max_time
+  uint32_t last;        // line of the last access, REUSE_EMPTY before the first
+  uint32_t *stacks[REUSE_SET_BITS + 1];  // of 2^bits sets, REUSE_MAX_WAYS lines per set, most recent first
+  uint8_t *depth[REUSE_SET_BITS + 1];    // lines in the stack of each set
+  /* counters */
+  uint64_t accesses;
+  uint64_t repeats;     // accesses to the line of the last access, at distance 0 in every stack
+  uint64_t full[33];    // fully associative hits by bit length of the distance
+  uint64_t sets[REUSE_SET_BITS + 1][REUSE_MAX_WAYS];  // hits at each depth of the set stacks
+} REUSE;
+
+/**
+ * Create an empty analysis.
+ * param: reuse         [out] pointer to the analysis
+ * param: name          [in]  name in the statistics
+ * param: line          [in]  bytes of a cache line, a power of two from 4 to 4096
+ * return: error code, -1 for a bad line size, -2 when it can not be allocated;
+ *         reuse_dispose() frees what was created in any case
+ */
+int reuse_create(REUSE *reuse, const char *name, uint32_t line);
+
+/**
+ * Access the line of an address.
+ * param: reuse         [in] the analysis pointer
+ * param: addr          [in] guest address
+ */
+void reuse_access(REUSE *reuse, uint32_t addr);
+
+/**
+ * Print the miss ratio of the LRU caches of each size from one line to one holding
+ * all the lines seen, fully associative and from 1 to REUSE_MAX_WAYS ways.
+ * param: reuse         [in] the analysis pointer
+ * param: out           [in] output stream
+ */
+void reuse_stats(REUSE *reuse, FILE *out);
+
+/**
+ * Dispose the analysis.
+ * param: reuse         [out] pointer to the analysis
+ */
+void reuse_dispose(REUSE *reuse);
+
+#endif
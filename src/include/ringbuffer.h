@@ -2,12 +2,14 @@
 #define RINGBUFFER_H
 		
 #include "common.h"
+#include <stdatomic.h>
 		
 #define ERROR_RING_ALLOC     -1
 #define ERROR_BUF_ALLOC      -2
 #define ERROR_BUF_NO_SPACE   -3
 #define ERROR_BUF_EMPTY   	 -4
 #define ERROR_NOT_ENOUGHT 	 -5
+#define ERROR_BAD_COUNT   	 -6
 	
 typedef struct {
     unsigned char *memory;     // memory used for the buffer itself
@@ -24,6 +26,22 @@ typedef struct {
 	unsigned int free;         // number of bytes free in the buffer
 } RINGBUFFER_VAR;
 
+//fixed size records written and read in place, see ringbuffer_rec_create()
+//one writer thread and one reader thread may use it at the same time without locks
+typedef struct {
+    unsigned char *memory;     // record slots, a power of two of them
+    uint32_t rec_size;         // bytes per record
+    uint32_t mask;             // number of slots - 1
+    uint32_t limit;            // records the buffer holds at most
+    char pad_w[64];            // writer and reader fields in different cache lines
+    _Atomic uint32_t head;     // records committed since creation (wraps), set by the writer
+    uint32_t tail_cache;       // last tail seen by the writer
+    char pad_r[64];
+    _Atomic uint32_t tail;     // records consumed since creation (wraps), set by the reader
+    uint32_t head_cache;       // last head seen by the reader
+    char pad_end[64];
+} RINGBUFFER_REC;
+
 
 /**
  * Create ringbuffer.
@@ -82,5 +100,106 @@ int ringbuffer_get(RINGBUFFER_TYPE *p_ringbuffer, void *p_dst, unsigned int offs
  */
 void ringbuffer_dispose(RINGBUFFER_TYPE *p_ringbuffer);
 
+/**
+ * Create a ringbuffer of fixed size records.
+ * Slots are rounded up to a power of two so positions are found with a mask.
+ * param: buffer        [out] pointer to the ringbuffer
+ * param: rec_size      [in]  size in bytes of one record
+ * param: count         [in]  number of records the ringbuffer holds, 1 to 2^31
+ * return: error code, ERROR_BAD_COUNT for no records, too many or empty ones
+ */
+int ringbuffer_rec_create(RINGBUFFER_REC *p_ringbuffer, uint32_t rec_size, uint32_t count);
+
+/**
+ * Get the slot of the next record to write, filled in place by the caller.
+ * Writer side, the tail is read again only when the buffer looks full.
+ * param: buffer        [in] the ringbuffer pointer
+ * return:              pointer to the slot, NULL if the ringbuffer is full
+ */
+static inline void *ringbuffer_rec_reserve(RINGBUFFER_REC *p_ringbuffer) {
+	uint32_t head = atomic_load_explicit(&p_ringbuffer->head, memory_order_relaxed);
+	if (head - p_ringbuffer->tail_cache >= p_ringbuffer->limit) {
+		p_ringbuffer->tail_cache = atomic_load_explicit(&p_ringbuffer->tail, memory_order_acquire);
+		if (head - p_ringbuffer->tail_cache >= p_ringbuffer->limit) return NULL;
+	}
+	return p_ringbuffer->memory + (size_t) (head & p_ringbuffer->mask) * p_ringbuffer->rec_size;
+}
+
+/**
+ * Publish the record written in the slot given by ringbuffer_rec_reserve().
+ * param: buffer        [in] the ringbuffer pointer
+ */
+static inline void ringbuffer_rec_commit(RINGBUFFER_REC *p_ringbuffer) {
+	uint32_t head = atomic_load_explicit(&p_ringbuffer->head, memory_order_relaxed);
+	atomic_store_explicit(&p_ringbuffer->head, head + 1, memory_order_release);
+}
+
+/**
+ * Get the oldest record, read in place by the caller.
+ * Reader side, the head is read again only when the buffer looks empty.
+ * param: buffer        [in] the ringbuffer pointer
+ * return:              pointer to the record, NULL if the ringbuffer is empty
+ */
+static inline const void *ringbuffer_rec_peek(RINGBUFFER_REC *p_ringbuffer) {
+	uint32_t tail = atomic_load_explicit(&p_ringbuffer->tail, memory_order_relaxed);
+	if ((int32_t) (p_ringbuffer->head_cache - tail) <= 0) {
+		p_ringbuffer->head_cache = atomic_load_explicit(&p_ringbuffer->head, memory_order_acquire);
+		if (p_ringbuffer->head_cache == tail) return NULL;
+	}
+	return p_ringbuffer->memory + (size_t) (tail & p_ringbuffer->mask) * p_ringbuffer->rec_size;
+}
+
+/**
+ * Release the record given by ringbuffer_rec_peek(), its slot can be reused.
+ * param: buffer        [in] the ringbuffer pointer
+ */
+static inline void ringbuffer_rec_consume(RINGBUFFER_REC *p_ringbuffer) {
+	uint32_t tail = atomic_load_explicit(&p_ringbuffer->tail, memory_order_relaxed);
+	atomic_store_explicit(&p_ringbuffer->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * Get the oldest records that lie one after the other in memory.
+ * Reader side, release them with ringbuffer_rec_consume_n().
+ * param: buffer        [in]  the ringbuffer pointer
+ * param: rec           [out] pointer to the first record
+ * return:              number of records from rec up to the end of the slots
+ */
+static inline uint32_t ringbuffer_rec_span(RINGBUFFER_REC *p_ringbuffer, const void **rec) {
+	uint32_t tail = atomic_load_explicit(&p_ringbuffer->tail, memory_order_relaxed);
+	uint32_t to_end = p_ringbuffer->mask + 1 - (tail & p_ringbuffer->mask);
+	uint32_t n;
+	p_ringbuffer->head_cache = atomic_load_explicit(&p_ringbuffer->head, memory_order_acquire);
+	n = p_ringbuffer->head_cache - tail;
+	*rec = p_ringbuffer->memory + (size_t) (tail & p_ringbuffer->mask) * p_ringbuffer->rec_size;
+	return n < to_end ? n : to_end;
+}
+
+/**
+ * Release n records, their slots can be reused.
+ * param: buffer        [in] the ringbuffer pointer
+ * param: n             [in] number of records
+ */
+static inline void ringbuffer_rec_consume_n(RINGBUFFER_REC *p_ringbuffer, uint32_t n) {
+	uint32_t tail = atomic_load_explicit(&p_ringbuffer->tail, memory_order_relaxed);
+	atomic_store_explicit(&p_ringbuffer->tail, tail + n, memory_order_release);
+}
+
+/**
+ * Number of records waiting to be consumed.
+ * param: buffer        [in] the ringbuffer pointer
+ */
+static inline uint32_t ringbuffer_rec_fill(RINGBUFFER_REC *p_ringbuffer) {
+	return atomic_load_explicit(&p_ringbuffer->head, memory_order_acquire) -
+	       atomic_load_explicit(&p_ringbuffer->tail, memory_order_acquire);
+}
+
+/**
+ * Dispose a ringbuffer of fixed size records.
+ * 
+ * param: buffer        [out] pointer to the ringbuffer
+ */
+void ringbuffer_rec_dispose(RINGBUFFER_REC *p_ringbuffer);
+
 
 #endif
@@ -0,0 +1,59 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include "common.h"
+#include "sim.h"
+
+#define SAMPLE_SIZE     10000   // instructions logged by each sample by default
+
+/*
+ * Sampling: the guest runs without log (fast-forward, at the speed of --log=off,
+ * the JIT included) and the log is turned on for a window of size instructions:
+ * at an instruction count or the first time the PC reaches an address, then again
+ * every period instructions. Each sample starts with a mark record in the log,
+ * "# sample N at instruction N PC=X" in log.txt.
+ */
+
+typedef struct {
+  uint64_t size;        // instructions logged by each sample
+  uint64_t period;      // from the start of a sample to the next one, 0 for one sample
+  int at_pc;            // the first sample starts the first time the PC is pc, else at instruction at
+  uint32_t pc;
+  uint64_t at;          // instructions from the start of the program
+} SAMPLE_CONFIG;
+
+typedef struct {
+  SAMPLE_CONFIG config;
+  /* counters */
+  uint32_t samples;
+  uint64_t ff_insts;    // instructions run without log
+  uint64_t ff_ns;
+  uint64_t log_insts;   // instructions of the samples
+  uint64_t log_ns;
+} SAMPLER;
+
+/**
+ * Create a sampler.
+ * param: sampler       [out] pointer to the sampler
+ * param: config        [in]  windows to log, copied
+ * return: error code, -1 when size is 0 or larger than period
+ */
+int sample_create(SAMPLER *sampler, const SAMPLE_CONFIG *config);
+
+/**
+ * Run the guest fast-forwarding between the samples, until it ends or the budget runs out.
+ * param: sampler       [in] the sampler pointer
+ * param: sim           [in] the simulator, with a log
+ * param: max_insts     [in] most instructions to execute, UINT64_MAX for no limit
+ * return:              state of the simulation
+ */
+SIM_STATUS sample_run(SAMPLER *sampler, SIM *sim, uint64_t max_insts);
+
+/**
+ * Print the samples taken, and the time and MIPS with and without log.
+ * param: sampler       [in] the sampler pointer
+ * param: out           [in] output stream
+ */
+void sample_stats(SAMPLER *sampler, FILE *out);
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include "common.h"
+#include "bpred.h"
+#include "cache.h"
+#include "core.h"
+#include "mem.h"
+#include "pipeline.h"
+#include "retire.h"
+#include "reuse.h"
+#include "timing.h"
+#include "trace.h"
+
+/*
+ * libriscv_sim: the simulator as a library, riscv_sim is a command line on top of it.
+ *
+ *   SIM_CONFIG config;
+ *   sim_config_default(&config);
+ *   SIM *sim = (SIM *)malloc(sizeof(SIM));
+ *   sim_create(sim, &config);
+ *   sim_load_image(sim, buf, len);
+ *   while (sim_run(sim, 1000000) == SIM_RUNNING) ... inspect or change the guest ...
+ *   sim_destroy(sim);
+ *
+ * Each SIM is independent, different threads may run different simulators.
+ */
+
+/* Execution engines selectable with --engine */
+typedef enum {
+  ENGINE_SWITCH,        // core_execute() on each fetched instruction word
+  ENGINE_PREDECODE,     // handlers from the predecode cache (default)
+  ENGINE_THREADED,      // direct-threaded dispatch over the predecode cache
+  ENGINE_BLOCK          // threaded dispatch over chained translated blocks
+} ENGINE;
+
+/* Timing models selectable with --timing */
+typedef enum {
+  TIMING_OFF,           // instructions only, no cycles
+  TIMING_PIPELINE       // in-order 5-stage pipeline, see pipeline.h
+} TIMING_MODEL;
+
+typedef struct {
+  ENGINE engine;
+  TRACE_MODE log;       // instructions written to the log
+  uint32_t log_last;    // instructions kept in TRACE_LAST mode
+  TRACE_FORMAT log_format;  // log.txt or binary trace log.bin
+  int log_threads;      // threads formatting log.txt, 0 for one per online CPU
+  const char *log_path; // log file, NULL for log.txt or log.bin by format
+  const char *out_path; // file receiving the guest stdout, NULL for the stdout of the simulator
+  int jit;              // compile hot blocks to native code (block engine)
+  uint64_t jit_threshold;   // block executions before compiling it
+  uint64_t jit_code_size;   // bytes of native code before the buffer is flushed
+  int jit_check;        // cross-check native blocks against the interpreter
+  uint64_t ram_size;    // bytes of guest RAM
+  int hugepages;        // back the guest RAM with transparent huge pages
+  uint32_t brk;         // initial program break, 0 for the end of the image
+  TIMING_MODEL timing;  // cycles counted by a timing model, in the predecode loop
+  PIPELINE_CONFIG pipeline; // of TIMING_PIPELINE
+  CACHE_CONFIG l1i;     // instruction cache fed by the fetches, size 0 for none
+  CACHE_CONFIG l1d;     // data cache fed by the loads and stores to the RAM, size 0 for none
+  BPRED_CONFIG bpred;   // branch predictors fed by the control transfers, num 0 for none
+  uint32_t reuse_line;  // line bytes of the stack distance analysis of the fetches and of the RAM accesses, 0 for none
+  int model_threads;    // threads running the models beside the simulation loop, 0 to run them in it
+} SIM_CONFIG;
+
+/* State of a simulation after sim_run() */
+typedef enum {
+  SIM_RUNNING,          // the budget ran out, the guest can go on
+  SIM_EXITED,           // returned to 0, ran past the code, halted or called exit
+  SIM_FAULT             // guest access outside the RAM and the devices
+} SIM_STATUS;
+
+typedef struct {
+  SIM_CONFIG config;
+  RAM *ram;
+  CORE *core;           // its caches are created when the image is loaded
+  TRACE *trace;         // NULL without log
+  TIMING *timing;       // NULL without timing model
+  CACHE *l1i;           // NULL without instruction cache model
+  CACHE *l1d;           // NULL without data cache model
+  BPRED *bpred;         // NULL without branch prediction
+  REUSE *reuse_i;       // stack distances of the fetches, NULL without analysis
+  REUSE *reuse_d;       // stack distances of the loads and stores to the RAM
+  RETIRE *retire;       // stream to the model threads, NULL when the models run in the loop
+  int out_fd;           // file of out_path, -1 for stdout
+  SIM_STATUS status;
+  int logging;          // runs write to the trace, see sim_set_log()
+  uint64_t insts;       // instructions executed by all the runs
+  sigjmp_buf resume;    // guest access faults of sim_run() come back here
+} SIM;
+
+/**
+ * Fill a configuration with the defaults: predecode engine, no log, no JIT,
+ * MEM_RAM_SIZE bytes of RAM.
+ * param: config        [out] the configuration
+ */
+void sim_config_default(SIM_CONFIG *config);
+
+/**
+ * Create a simulator with no program: the guest RAM, the core with the stack
+ * pointer at the top of the RAM, the devices, the log and the output files.
+ * param: sim           [out] pointer to the simulator
+ * param: config        [in]  configuration, copied
+ * return: error code, -2 when the RAM or the devices can not be allocated,
+ *         -3 when the log or the output file can not be opened; sim_destroy() frees what
+ *         was created in any case
+ */
+int sim_create(SIM *sim, const SIM_CONFIG *config);
+
+/**
+ * Load the program image at guest address 0, execution starts there.
+ * param: sim           [in] the simulator pointer
+ * param: buf           [in] the image, copied to the guest RAM
+ * param: len           [in] bytes of the image
+ * return: error code, -1 when an image is already loaded, -3 if it is larger than the RAM
+ */
+int sim_load_image(SIM *sim, const void *buf, size_t len);
+
+/**
+ * Load a binary file at guest address 0, mapped copy-on-write instead of read.
+ * param: sim           [in] the simulator pointer
+ * param: path          [in] binary file
+ * return: error code, -1 when it can not be opened or an image is already loaded,
+ *         -3 if it is larger than the RAM
+ */
+int sim_load_file(SIM *sim, const char *path);
+
+/**
+ * Start from a snapshot instead of loading a program: the RAM, the registers,
+ * the PC, the program break and the instructions executed. The saved pages are
+ * mapped copy-on-write, the guest RAM takes the size of the snapshot.
+ * param: sim           [in] the simulator pointer
+ * param: path          [in] snapshot file written by sim_save_snapshot()
+ * return: error code, -1 when it can not be read or an image is already loaded,
+ *         -3 when it is not a snapshot
+ */
+int sim_restore_snapshot(SIM *sim, const char *path);
+
+/**
+ * Write the state of the guest to a snapshot file, to start other runs from it.
+ * The devices are not saved: the console output and the timer start over.
+ * param: sim           [in] the simulator pointer
+ * param: path          [in] snapshot file
+ * return: error code, -1 when it can not be written or no image is loaded
+ */
+int sim_save_snapshot(SIM *sim, const char *path);
+
+/**
+ * Run the guest. The budget is counted down by the engines, a bounded run costs
+ * no more per instruction than an unbounded one. Once the guest exited or faulted
+ * the log is complete and further runs return at once; a run before an image
+ * is loaded returns SIM_EXITED.
+ * After a fault, the PC is the instruction that faulted, the registers are the
+ * ones of its start with the threaded and block engines, and the instructions of
+ * that run are not counted.
+ * param: sim           [in] the simulator pointer
+ * param: max_insts     [in] most instructions to execute, UINT64_MAX for no limit
+ * return:              state of the simulation
+ */
+SIM_STATUS sim_run(SIM *sim, uint64_t max_insts);
+
+/**
+ * Run the guest until the next instruction is at pc, checked before each one,
+ * the first one included. It runs in the predecode loop whatever the engine.
+ * param: sim           [in] the simulator pointer
+ * param: pc            [in] guest address to stop at
+ * param: max_insts     [in] most instructions to execute, UINT64_MAX for no limit
+ * return:              state of the simulation, SIM_RUNNING when it stopped at pc or ran out of budget
+ */
+SIM_STATUS sim_run_until(SIM *sim, uint32_t pc, uint64_t max_insts);
+
+/**
+ * Replace the timing model, the simulator disposes it. The runs with a model, with
+ * cache models, branch predictors or the stack distance analysis, give them every retired
+ * instruction, they run in the predecode loop whatever the engine; without models
+ * they cost nothing more. With model_threads, the loop only publishes the retired
+ * instructions and the models run on their threads, caught up when a run returns.
+ * param: sim           [in] the simulator pointer
+ * param: timing        [in] the model, NULL for none
+ */
+void sim_set_timing(SIM *sim, TIMING *timing);
+
+/**
+ * Turn the log of the next runs off or back on, the default. Runs without log
+ * go at the speed of a simulator created with TRACE_OFF, the JIT included.
+ * param: sim           [in] the simulator pointer
+ * param: on            [in] 1 to log the instructions, 0 not to
+ */
+void sim_set_log(SIM *sim, int on);
+
+/**
+ * Write a mark in the log at the current point: the mark number, the
+ * instructions executed and the PC of the next one. Nothing without log.
+ * param: sim           [in] the simulator pointer
+ * param: mark          [in] number of the mark
+ */
+void sim_mark_log(SIM *sim, uint32_t mark);
+
+/**
+ * Execute one instruction.
+ * param: sim           [in] the simulator pointer
+ * return:              state of the simulation
+ */
+SIM_STATUS sim_step(SIM *sim);
+
+/**
+ * End the simulation before the guest does: write the rest of the log, later
+ * runs return at once. sim_run() does it when the guest exits or faults.
+ * param: sim           [in] the simulator pointer
+ */
+void sim_finish(SIM *sim);
+
+/* Guest registers, x0 reads as zero and ignores writes */
+uint32_t sim_get_reg(SIM *sim, uint32_t n);
+void sim_set_reg(SIM *sim, uint32_t n, uint32_t value);
+uint32_t sim_get_pc(SIM *sim);
+void sim_set_pc(SIM *sim, uint32_t pc);
+
+/**
+ * Copy guest RAM to the host.
+ * param: sim           [in]  the simulator pointer
+ * param: addr          [in]  guest address
+ * param: buf           [out] len bytes
+ * param: len           [in]  bytes to copy
+ * return: error code, -1 when [addr, addr + len) is not in the RAM
+ */
+int sim_read_mem(SIM *sim, uint32_t addr, void *buf, size_t len);
+
+/**
+ * Copy host memory to the guest RAM, overwritten code is decoded again.
+ * param: sim           [in] the simulator pointer
+ * param: addr          [in] guest address
+ * param: buf           [in] len bytes
+ * param: len           [in] bytes to copy
+ * return: error code, -1 when [addr, addr + len) is not in the RAM
+ */
+int sim_write_mem(SIM *sim, uint32_t addr, const void *buf, size_t len);
+
+/**
+ * Exit code of the guest: the value given to exit or to the halt device, 0 otherwise.
+ * param: sim           [in] the simulator pointer
+ * return:              the exit code
+ */
+int sim_exit_code(SIM *sim);
+
+/**
+ * Print the cycles of the timing model, the statistics of the cache models and of
+ * the branch predictors, and the miss ratio curves of the stack distance analysis.
+ * param: sim           [in] the simulator pointer
+ * param: out           [in] output stream
+ */
+void sim_model_stats(SIM *sim, FILE *out);
+
+/**
+ * Print the counters of the engine, the log, the models and the devices.
+ * param: sim           [in] the simulator pointer
+ * param: out           [in] output stream
+ */
+void sim_stats(SIM *sim, FILE *out);
+
+/**
+ * Write the rest of the log, flush the guest output and dispose the simulator.
+ * param: sim           [out] pointer to the simulator
+ */
+void sim_destroy(SIM *sim);
+
+#endif
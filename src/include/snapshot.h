@@ -0,0 +1,69 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "common.h"
+#include "mem.h"
+
+/*
+ * Snapshot file of a simulation, to start runs from it instead of from pc 0
+ *
+ * offset 0                 SNAPSHOT_HEADER, padded to SNAPSHOT_PAGE
+ * index_offset             uint32_t guest page number of each saved page, ascending
+ * data_offset              the saved pages, SNAPSHOT_PAGE bytes each in index order
+ *
+ * Only the pages holding something other than zeros are saved: the image,
+ * and the pages the guest touched. The data is page aligned, so on restore
+ * each run of consecutive pages is mapped copy-on-write with one mmap()
+ * instead of being read. Fields are in little-endian host order.
+ */
+
+#define SNAPSHOT_MAGIC      "RVSNAP1"
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_PAGE       4096u
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t page_size;   // SNAPSHOT_PAGE
+  uint64_t ram_size;    // bytes of guest RAM
+  uint64_t image;       // bytes of the program image, the end of the code
+  uint64_t insts;       // instructions executed before the snapshot
+  uint32_t regs[32];
+  uint32_t pc;
+  uint32_t num_pages;   // pages saved
+  uint32_t brk_start;   // program break of the system calls
+  uint32_t brk;
+  uint32_t brk_max;
+  uint32_t reserved;
+  uint64_t index_offset;
+  uint64_t data_offset;
+} SNAPSHOT_HEADER;
+
+/**
+ * Write the guest RAM and the state in a header to a snapshot file.
+ * param: path          [in] snapshot file
+ * param: header        [in] state of the core and the system calls, the layout fields are filled here
+ * param: ram           [in] the RAM
+ * return: error code, -1 when the file can not be written
+ */
+int snapshot_save(const char *path, const SNAPSHOT_HEADER *header, const RAM *ram);
+
+/**
+ * Read the header of a snapshot file.
+ * param: path          [in]  snapshot file
+ * param: header        [out] the header
+ * return: error code, -1 when the file can not be read, -3 when it is not a snapshot
+ */
+int snapshot_read_header(const char *path, SNAPSHOT_HEADER *header);
+
+/**
+ * Map the saved pages of a snapshot over the guest RAM.
+ * param: path          [in] snapshot file
+ * param: header        [in] its header
+ * param: ram           [in] RAM of header->ram_size bytes, still all zeros
+ * return: error code, -1 when the file can not be read, -3 when it does not fit the RAM,
+ *         is shorter than its pages or its index is not ascending
+ */
+int snapshot_load(const char *path, const SNAPSHOT_HEADER *header, RAM *ram);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef SYS_H
+#define SYS_H
+
+#include "common.h"
+#include "core.h"
+#include "logfmt.h"
+
+/*
+ * System calls of ECALL, Linux RISC-V numbers as used by newlib and the
+ * proxy kernel: a7 holds the number, a0-a5 the arguments, the result or a
+ * negative errno goes back in a0.
+ *
+ * exit, exit_group     end the run, a0 is the exit code of the simulator
+ * write                fd 1 is gathered with the UART output and written in
+ *                      large blocks, fd 2 is written at once
+ * read                 fd 0 only, code read over is decoded again
+ * brk                  heap from the end of the program image up to the
+ *                      devices or the end of the RAM
+ * clock_gettime        host clock, 32-bit (113) or 64-bit (403) seconds
+ * Other numbers return -ENOSYS.
+ */
+
+#define SYS_READ                63
+#define SYS_WRITE               64
+#define SYS_EXIT                93
+#define SYS_EXIT_GROUP          94
+#define SYS_CLOCK_GETTIME       113
+#define SYS_BRK                 214
+#define SYS_CLOCK_GETTIME64     403
+
+/* errno values of the guest ABI */
+#define SYS_EBADF               9
+#define SYS_EFAULT              14
+#define SYS_EINVAL              22
+#define SYS_ENOSYS              38
+
+struct SYS {
+  uint8_t *ram;
+  uint32_t ram_limit;   // guest buffers must end below it
+  LOGFMT_OUT *out;      // buffered stdout, shared with the UART
+  uint32_t brk_start;   // first heap address, the end of the image
+  uint32_t brk;         // current end of the heap
+  uint32_t brk_max;     // highest end of the heap so far, memory above it is still zero
+  int exited;           // the guest called exit
+  uint32_t exit_code;
+  /* counters */
+  uint64_t calls;
+  uint64_t unknown;     // calls answered with -ENOSYS
+};
+
+/**
+ * Create the system call layer.
+ * param: sys           [out] pointer to the layer
+ * param: ram           [in]  guest memory
+ * param: ram_limit     [in]  end of the RAM below the devices
+ * param: image         [in]  bytes of the program image, the heap starts after it
+ * param: out           [in]  buffered stdout
+ * return: error code
+ */
+int sys_create(SYS *sys, uint8_t *ram, uint32_t ram_limit, uint32_t image, LOGFMT_OUT *out);
+
+/**
+ * Run the system call of an ECALL.
+ * param: sys           [in] the layer pointer
+ * param: core          [in] the core, its pc is set to 0 on exit like a halt
+ * param: regs          [in] register file of the engine running, a0 gets the result
+ * return:              1 when the guest exited and the run must end, 0 otherwise
+ */
+int sys_ecall(SYS *sys, CORE *core, uint32_t *regs);
+
+/**
+ * Print the system call counters.
+ * param: sys           [in] the layer pointer
+ * param: out           [in] output stream
+ */
+void sys_stats(SYS *sys, FILE *out);
+
+/**
+ * Dispose the system call layer.
+ * param: sys           [out] pointer to the layer
+ */
+void sys_dispose(SYS *sys);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef THREADED_H
+#define THREADED_H
+
+#include "common.h"
+#include "core.h"
+#include "trace.h"
+
+/**
+ * Run the guest with the direct-threaded engine until it ends or the
+ * budget of instructions is spent, counted down with the guest registers.
+ * Guest registers are kept in a local register file while running,
+ * writes to x0 go to a sink register chosen at decode time.
+ * With a block cache in core->bc, code runs as chained translated blocks,
+ * the end of code and return to 0 checks are done once per block, and
+ * with a JIT in core->bc->jit hot blocks run as native code when not logging.
+ * param: core          [in/out] core with a predecode cache over the code
+ * param: trace         [in] trace receiving one RLOG per instruction, NULL for none
+ * param: budget        [in] most instructions to execute, core->pc is the next one when it runs out
+ * return:              number of instructions executed
+ */
+uint64_t threaded_run(CORE *core, TRACE *trace, uint64_t budget);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "common.h"
+#include "core.h"
+
+/*
+ * Timing models: the simulation is functional, a timing model turns the
+ * instructions it retires into cycles. The model gets one event per retired
+ * instruction, in order, and keeps the cycle count in its TIMING header.
+ * A model is a struct starting with TIMING, its functions cast it back.
+ */
+
+/* One retired instruction */
+typedef struct {
+  const DECODED *dec;   // op, registers and immediate of the instruction
+  uint32_t pc;          // its address
+  uint32_t next_pc;     // address of the next instruction, not pc + 4 after a taken branch or a jump
+  uint32_t addr;        // guest address of a load or a store
+} TIMING_EVENT;
+
+typedef struct TIMING TIMING;
+
+struct TIMING {
+  const char *name;
+  void (*retire)(TIMING *timing, const TIMING_EVENT *ev);
+  void (*stats)(TIMING *timing, FILE *out);     // counters of the model, after the cycles
+  void (*dispose)(TIMING *timing);              // frees the model, NULL when it is not allocated
+  uint64_t insts;       // instructions retired
+  uint64_t cycles;      // cycles from the first fetch to the last write-back
+};
+
+/**
+ * Give a retired instruction to the model.
+ * param: timing        [in] the model
+ * param: ev            [in] the instruction
+ */
+static inline void timing_retire(TIMING *timing, const TIMING_EVENT *ev) {
+  timing->insts++;
+  timing->retire(timing, ev);
+}
+
+/**
+ * Print the cycles, the CPI and the counters of the model.
+ * param: timing        [in] the model
+ * param: out           [in] output stream
+ */
+void timing_stats(TIMING *timing, FILE *out);
+
+#endif
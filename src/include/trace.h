@@ -0,0 +1,116 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "common.h"
+#include <pthread.h>
+#include "core.h"
+#include "logfmt.h"
+#include "logpar.h"
+#include "ringbuffer.h"
+#include "tracebin.h"
+
+#define TRACE_FULL_RECORDS  (1 << 18)   // records queued to the writer thread in full mode
+#define TRACE_WRITER_SLEEP  100         // microseconds the writer thread sleeps on an empty queue
+
+/* How much of the execution goes to log.txt, selected with --log */
+typedef enum {
+  TRACE_OFF,            // no record at all
+  TRACE_LAST,           // flight recorder: only the last N instructions
+  TRACE_FULL            // every instruction, written by a thread while the simulation runs
+} TRACE_MODE;
+
+/* Layout of the log file, selected with --log-format */
+typedef enum {
+  TRACE_TEXT,           // log.txt, six lines per instruction
+  TRACE_BIN             // binary trace, see tracebin.h
+} TRACE_FORMAT;
+
+/* Instruction trace: one RLOG per executed instruction, */
+/* formatted to the log file when leaving the ring. */
+/* In full mode the simulation produces the records and a writer thread */
+/* consumes them, the simulation only waits when the ring is full */
+typedef struct {
+  TRACE_MODE mode;
+  TRACE_FORMAT format;
+  RINGBUFFER_REC *ring; // records not written yet
+  FILE *file;           // log file
+  LOGFMT *fmt;          // formatter of the text format
+  LOGFMT_OUT out;       // buffered writes of the text format
+  LOGPAR *pool;         // threads formatting long runs of text records, NULL for one thread
+  TRACEBIN bin;         // encoder of the binary format
+  pthread_t writer;     // thread writing the file in full mode
+  int running;          // writer thread started and not joined yet
+  _Atomic int done;     // no more records will be produced
+  /* counters */
+  uint64_t written;     // records written to the file
+  uint64_t dropped;     // records overwritten by newer ones (last mode)
+  uint32_t high_water;  // most records seen waiting in the ring by the writer
+  uint64_t stalls;      // times the simulation found the ring full
+  uint64_t stall_ns;    // time the simulation waited for room in the ring
+} TRACE;
+
+/**
+ * Create the trace and its log file.
+ * param: trace         [out] pointer to the trace
+ * param: mode          [in]  TRACE_LAST or TRACE_FULL
+ * param: last          [in]  records kept in TRACE_LAST mode, 1 to 2^31
+ * param: format        [in]  layout of the log file
+ * param: threads       [in]  threads formatting the text, 0 for one per online CPU
+ * param: path          [in]  log file name
+ * return: error code, -1 for a bad number of records
+ */
+int trace_create(TRACE *trace, TRACE_MODE mode, uint32_t last, TRACE_FORMAT format, int threads, const char *path);
+
+/**
+ * Make room for a record when the ring is full: wait for the writer thread
+ * in full mode, drop the oldest one in last mode.
+ * param: trace         [in] the trace pointer
+ * return:              slot of the next record
+ */
+RLOG *trace_make_room(TRACE *trace);
+
+/**
+ * Get the slot of the next instruction record, filled in place by the engine.
+ * param: trace         [in] the trace pointer
+ * return:              slot of the record, publish it with trace_commit()
+ */
+static inline RLOG *trace_reserve(TRACE *trace) {
+  RLOG *log = (RLOG *)ringbuffer_rec_reserve(trace->ring);
+  return log ? log : trace_make_room(trace);
+}
+
+/**
+ * Publish the record given by trace_reserve().
+ * param: trace         [in] the trace pointer
+ */
+static inline void trace_commit(TRACE *trace) {
+  ringbuffer_rec_commit(trace->ring);
+}
+
+/**
+ * Format the pending records to the log file.
+ * param: trace         [in] the trace pointer
+ * return:              number of records written
+ */
+uint32_t trace_write(TRACE *trace);
+
+/**
+ * End the trace: write the pending records and stop the writer thread.
+ * param: trace         [in] the trace pointer
+ */
+void trace_finish(TRACE *trace);
+
+/**
+ * Print the trace counters.
+ * param: trace         [in] the trace pointer
+ * param: out           [in] stream to print to
+ */
+void trace_stats(TRACE *trace, FILE *out);
+
+/**
+ * Finish the trace if needed, close the log file and dispose the trace.
+ * param: trace         [out] pointer to the trace
+ */
+void trace_dispose(TRACE *trace);
+
+#endif
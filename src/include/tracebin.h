@@ -0,0 +1,126 @@
+#ifndef TRACEBIN_H
+#define TRACEBIN_H
+
+#include "common.h"
+#include "core.h"
+
+/*
+ * Binary instruction trace (--log-format=bin)
+ *
+ * header   "RVTRACE" 0, u32 version, u32 records per block
+ * blocks   u32 payload bytes, u32 records, then the records
+ * index    u64 file offset and u64 first record of each block
+ * trailer  u64 index offset, u64 records, u32 blocks, "RVTX"
+ *
+ * Record: flags byte, instruction word (u32), then varints in this order:
+ *   TRACEBIN_PC   zigzag(h_pc - previous h_pc - 4)
+ *   TRACEBIN_RS1  zigzag(h_rs1 - last value of rs1)
+ *   TRACEBIN_RS2  zigzag(h_rs2 - last value of rs2)
+ *   TRACEBIN_RD   zigzag(h_rd - last value of rd)
+ * A field is present only when its flag is set, values not present are the
+ * last ones seen of that register. Register numbers come from the instruction
+ * word. All integers are little-endian, and every block starts from PC 0 and
+ * all registers 0, so blocks can be decoded on their own through the index.
+ */
+
+#define TRACEBIN_VERSION        1
+#define TRACEBIN_BLOCK_RECORDS  4096
+#define TRACEBIN_MAX_RECORD     (1 + 4 + 4 * 5)     // flags, word and four 32-bit varints
+
+/* record flags */
+#define TRACEBIN_PC   0x01      // not the next sequential PC
+#define TRACEBIN_RS1  0x02
+#define TRACEBIN_RS2  0x04
+#define TRACEBIN_RD   0x08
+
+typedef struct {
+  uint64_t offset;      // file offset of the block
+  uint64_t first;       // number of its first record
+} TRACEBIN_INDEX;
+
+/* Delta state shared by the encoder and the decoder */
+typedef struct {
+  uint32_t pc;          // h_pc of the previous record
+  uint32_t regs[32];    // last value seen of each register
+} TRACEBIN_STATE;
+
+/* Binary trace writer */
+typedef struct {
+  FILE *file;
+  uint8_t *buf;         // records of the block being built
+  uint32_t len;         // bytes used in buf
+  uint32_t count;       // records in buf
+  uint64_t offset;      // file offset of the next block
+  uint64_t records;     // records written in previous blocks
+  TRACEBIN_STATE state;
+  TRACEBIN_INDEX *index;
+  uint32_t num_blocks;
+  uint32_t max_blocks;  // entries allocated in index
+} TRACEBIN;
+
+/* Binary trace reader */
+typedef struct {
+  FILE *file;
+  uint8_t *buf;         // payload of the current block
+  uint32_t len;         // bytes of the current block
+  uint32_t pos;         // read position in buf
+  uint32_t left;        // records left in the current block
+  uint32_t block;       // next block to load
+  uint64_t records;     // records in the trace
+  TRACEBIN_STATE state;
+  TRACEBIN_INDEX *index;
+  uint32_t num_blocks;
+} TRACEBIN_READER;
+
+/**
+ * Start a binary trace, writing its header.
+ * param: tb            [out] pointer to the writer
+ * param: file          [in]  file opened for binary writing
+ * return: error code
+ */
+int tracebin_create(TRACEBIN *tb, FILE *file);
+
+/**
+ * Append one instruction record.
+ * param: tb            [in] the writer pointer
+ * param: rec           [in] the record
+ */
+void tracebin_put(TRACEBIN *tb, const RLOG *rec);
+
+/**
+ * Write the last block, the index and the trailer. The file is left open.
+ * param: tb            [in] the writer pointer
+ */
+void tracebin_close(TRACEBIN *tb);
+
+/**
+ * Open a binary trace, reading its header and index.
+ * param: rd            [out] pointer to the reader
+ * param: file          [in]  file opened for binary reading
+ * return: error code
+ */
+int tracebin_open(TRACEBIN_READER *rd, FILE *file);
+
+/**
+ * Position the reader on a record, through the index.
+ * param: rd            [in] the reader pointer
+ * param: record        [in] number of the record, 0 is the first one
+ * return: error code
+ */
+int tracebin_seek(TRACEBIN_READER *rd, uint64_t record);
+
+/**
+ * Read the next record.
+ * param: rd            [in]  the reader pointer
+ * param: rec           [out] the record
+ * return:              1 if read, 0 at the end of the trace, negative on a bad file
+ */
+int tracebin_next(TRACEBIN_READER *rd, RLOG *rec);
+
+/**
+ * Free the reader buffers. The file is left open.
+ * param: rd            [in] the reader pointer
+ */
+void tracebin_dispose(TRACEBIN_READER *rd);
+
+#endif
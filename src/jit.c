@@ -0,0 +1,373 @@
+#include "include/jit.h"
+#include "include/bus.h"
+#include "include/sys.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#include <sys/mman.h>
+#define JIT_X86_64
+#endif
+
+#define JIT_MAX_BLOCK_CODE  (BLOCK_MAX_INSTS * 128 + 64) // bound of the code of one block
+#define JIT_MAX_REPORTS     10                          // mismatches printed in check mode
+
+#ifdef JIT_X86_64
+
+/* Host registers: guest registers at [rbx], guest memory at [r12], CORE in r13, */
+/* eax/ecx/edx are scratch. Guest registers stay in memory so helpers can be called */
+/* between instructions without saving anything */
+enum { EAX = 0, ECX = 1, EDX = 2 };
+
+typedef struct {
+  uint8_t *p;
+} EMIT;
+
+static void e8(EMIT *e, uint8_t v) { *e->p++ = v; }
+static void e32(EMIT *e, uint32_t v) { memcpy(e->p, &v, 4); e->p += 4; }
+static void e64(EMIT *e, uint64_t v) { memcpy(e->p, &v, 8); e->p += 8; }
+
+/* ModRM (and displacement) of [rbx + 4 * guest register] */
+static void mrm_reg(EMIT *e, int hreg, int greg) {
+  uint32_t disp = 4 * greg;
+  if (disp < 128) {
+    e8(e, 0x40 | (hreg << 3) | 3);
+    e8(e, disp);
+  } else {
+    e8(e, 0x80 | (hreg << 3) | 3);
+    e32(e, disp);
+  }
+}
+
+/* mov hreg, x[greg] */
+static void load_greg(EMIT *e, int hreg, int greg) { e8(e, 0x8B); mrm_reg(e, hreg, greg); }
+/* mov x[greg], hreg */
+static void store_greg(EMIT *e, int hreg, int greg) { e8(e, 0x89); mrm_reg(e, hreg, greg); }
+/* mov x[greg], imm32 */
+static void store_greg_imm(EMIT *e, int greg, uint32_t imm) { e8(e, 0xC7); mrm_reg(e, 0, greg); e32(e, imm); }
+/* <op> hreg, x[greg] with op one of add/sub/xor/or/and/cmp */
+static void alu_greg(EMIT *e, uint8_t op, int hreg, int greg) { e8(e, op); mrm_reg(e, hreg, greg); }
+/* <op> eax, imm32 with op one of the eax short forms */
+static void alu_eax_imm(EMIT *e, uint8_t op, uint32_t imm) { e8(e, op); e32(e, imm); }
+/* mov hreg, imm32 */
+static void mov_imm(EMIT *e, int hreg, uint32_t imm) { e8(e, 0xB8 + hreg); e32(e, imm); }
+
+static void emit_prologue(EMIT *e) {
+  e8(e, 0x53);                                  // push rbx
+  e8(e, 0x41); e8(e, 0x54);                     // push r12
+  e8(e, 0x41); e8(e, 0x55);                     // push r13
+  e8(e, 0x48); e8(e, 0x89); e8(e, 0xFB);        // mov rbx, rdi
+  e8(e, 0x49); e8(e, 0x89); e8(e, 0xF4);        // mov r12, rsi
+  e8(e, 0x49); e8(e, 0x89); e8(e, 0xD5);        // mov r13, rdx
+}
+
+/* return eax as the next PC */
+static void emit_epilogue(EMIT *e) {
+  e8(e, 0x41); e8(e, 0x5D);                     // pop r13
+  e8(e, 0x41); e8(e, 0x5C);                     // pop r12
+  e8(e, 0x5B);                                  // pop rbx
+  e8(e, 0xC3);                                  // ret
+}
+
+/* eax = x[rs1] + imm, the guest address of a load or store */
+static void emit_addr(EMIT *e, const DECODED *d) {
+  load_greg(e, EAX, d->rs1);
+  if (d->imm) alu_eax_imm(e, 0x05, d->imm);
+}
+
+/* call fn(core, eax, ecx, size) */
+static void emit_store_call(EMIT *e, void *fn, uint8_t size) {
+  e8(e, 0x4C); e8(e, 0x89); e8(e, 0xEF);        // mov rdi, r13
+  e8(e, 0x89); e8(e, 0xC6);                     // mov esi, eax
+  e8(e, 0x89); e8(e, 0xCA);                     // mov edx, ecx
+  mov_imm(e, ECX, size);
+  e8(e, 0x48); e8(e, 0xB8); e64(e, (uint64_t)(uintptr_t)fn);  // mov rax, fn
+  e8(e, 0xFF); e8(e, 0xD0);                     // call rax
+}
+
+/* jump to be patched by emit_patch to the current position */
+static uint8_t *emit_jump(EMIT *e, uint8_t op0, uint8_t op1) {
+  e8(e, op0);
+  if (op1) e8(e, op1);
+  uint8_t *rel = e->p;
+  e32(e, 0);
+  return rel;
+}
+
+static void emit_patch(EMIT *e, uint8_t *rel) {
+  uint32_t v = (uint32_t)(e->p - (rel + 4));
+  memcpy(rel, &v, 4);
+}
+
+/* Check mode store: remember the old memory so the store can be undone */
+static int jit_store_checked(CORE *core, uint32_t addr, uint32_t value, uint32_t size) {
+  JIT *jit = core->bc->jit;
+  // devices see the store once, when the interpreter runs the block
+  if (addr >= core->ram_limit && core->bus && bus_find(core->bus, addr)) return 0;
+  JIT_STORE *s = &jit->stores[jit->num_stores++];
+  s->addr = addr;
+  s->size = size;
+  s->old = ram_load(core->ram, addr, size);
+  return core_store(core, addr, value, size);
+}
+
+static void emit_store(JIT *jit, EMIT *e, const DECODED *d, uint32_t pc, uint8_t size) {
+  emit_addr(e, d);
+  load_greg(e, ECX, d->rs2);
+  if (jit->check) {
+    emit_store_call(e, (void *)jit_store_checked, size);
+    return;
+  }
+  // stores that may hit code or devices go through core_store, one compare keeps RAM inline
+  e8(e, 0x8D); e8(e, 0x90); e32(e, -jit->code_limit);         // lea edx, [rax - code_limit]
+  e8(e, 0x81); e8(e, 0xFA); e32(e, jit->ram_limit - jit->code_limit);   // cmp edx, ram_limit - code_limit
+  uint8_t *slow = emit_jump(e, 0x0F, 0x83);     // jae slow
+  switch (size) {                               // mov [r12 + rax], cl/cx/ecx
+  case 8:  e8(e, 0x41); e8(e, 0x88); break;
+  case 16: e8(e, 0x66); e8(e, 0x41); e8(e, 0x89); break;
+  default: e8(e, 0x41); e8(e, 0x89); break;
+  }
+  e8(e, 0x0C); e8(e, 0x04);
+  uint8_t *done = emit_jump(e, 0xE9, 0);        // jmp done
+  emit_patch(e, slow);
+  emit_store_call(e, (void *)core_store, size);
+  // the guest halted: leave the block returning to 0, which ends the run,
+  // or the store overwrote this block: leave it returning the next PC
+  e8(e, 0x85); e8(e, 0xC0);                     // test eax, eax
+  uint8_t *stored = emit_jump(e, 0x0F, 0x84);   // jz stored
+  e8(e, 0x83); e8(e, 0xF8); e8(e, CORE_STORE_HALT);   // cmp eax, CORE_STORE_HALT
+  mov_imm(e, EAX, 0);
+  mov_imm(e, ECX, pc + 4);
+  e8(e, 0x0F); e8(e, 0x45); e8(e, 0xC1);        // cmovne eax, ecx
+  emit_epilogue(e);
+  emit_patch(e, stored);
+  emit_patch(e, done);
+}
+
+/* ecx = [r12 + rax] with the extension of the load, then x[wd] = ecx */
+/* addresses from ram_limit up are read by core_load_slow, for the devices */
+static void emit_load(JIT *jit, EMIT *e, const DECODED *d, uint8_t b0, uint8_t b1, uint8_t size) {
+  emit_addr(e, d);
+  alu_eax_imm(e, 0x3D, jit->ram_limit);        // cmp eax, ram_limit
+  uint8_t *slow = emit_jump(e, 0x0F, 0x83);     // jae slow
+  e8(e, 0x41);
+  e8(e, b0);
+  if (b1) e8(e, b1);
+  e8(e, 0x0C); e8(e, 0x04);
+  uint8_t *done = emit_jump(e, 0xE9, 0);        // jmp done
+  emit_patch(e, slow);
+  e8(e, 0x4C); e8(e, 0x89); e8(e, 0xEF);        // mov rdi, r13
+  e8(e, 0x89); e8(e, 0xC6);                     // mov esi, eax
+  mov_imm(e, EDX, size);
+  e8(e, 0x48); e8(e, 0xB8); e64(e, (uint64_t)(uintptr_t)core_load_slow);  // mov rax, core_load_slow
+  e8(e, 0xFF); e8(e, 0xD0);                     // call rax
+  if (b1) {
+    e8(e, b0); e8(e, b1); e8(e, 0xC8);          // movsx/movzx ecx, al/ax
+  } else {
+    e8(e, 0x89); e8(e, 0xC1);                   // mov ecx, eax
+  }
+  emit_patch(e, done);
+  store_greg(e, ECX, d->wd);
+}
+
+/* System call with the native register file, exit leaves the block returning to 0 */
+static int jit_ecall(CORE *core, uint32_t *regs) {
+  return core->sys ? sys_ecall(core->sys, core, regs) : 0;
+}
+
+static void emit_ecall(EMIT *e) {
+  e8(e, 0x4C); e8(e, 0x89); e8(e, 0xEF);        // mov rdi, r13
+  e8(e, 0x48); e8(e, 0x89); e8(e, 0xDE);        // mov rsi, rbx
+  e8(e, 0x48); e8(e, 0xB8); e64(e, (uint64_t)(uintptr_t)jit_ecall);   // mov rax, jit_ecall
+  e8(e, 0xFF); e8(e, 0xD0);                     // call rax
+  e8(e, 0x85); e8(e, 0xC0);                     // test eax, eax
+  e8(e, 0x74); e8(e, 8);                        // jz over the exit
+  e8(e, 0x31); e8(e, 0xC0);                     // xor eax, eax
+  emit_epilogue(e);
+}
+
+/* eax = taken ? target : pc + 4, with cmov condition cc */
+static void emit_branch(EMIT *e, const DECODED *d, uint32_t pc, uint8_t cc) {
+  load_greg(e, EAX, d->rs1);
+  alu_greg(e, 0x3B, EAX, d->rs2);               // cmp eax, x[rs2]
+  mov_imm(e, EAX, pc + 4);
+  mov_imm(e, ECX, pc + d->imm);
+  e8(e, 0x0F); e8(e, 0x40 | cc); e8(e, 0xC1);   // cmovcc eax, ecx
+  emit_epilogue(e);
+}
+
+static int jit_emit_block(JIT *jit, EMIT *e, BLOCK *b) {
+  emit_prologue(e);
+  for (uint32_t i = 0; i <= b->len; i++) {
+    const DECODED *d = &b->uops[i];
+    uint32_t pc = b->pc + 4 * i;
+    switch (d->op) {
+    case OP_NOP: break;
+    case OP_LB:  emit_load(jit, e, d, 0x0F, 0xBE, 8); break;    // movsx ecx, byte
+    case OP_LH:  emit_load(jit, e, d, 0x0F, 0xBF, 16); break;   // movsx ecx, word
+    case OP_LW:  emit_load(jit, e, d, 0x8B, 0, 32); break;      // mov ecx, dword
+    case OP_LBU: emit_load(jit, e, d, 0x0F, 0xB6, 8); break;    // movzx ecx, byte
+    case OP_LHU: emit_load(jit, e, d, 0x0F, 0xB7, 16); break;   // movzx ecx, word
+    case OP_SB:  emit_store(jit, e, d, pc, 8); break;
+    case OP_SH:  emit_store(jit, e, d, pc, 16); break;
+    case OP_SW:  emit_store(jit, e, d, pc, 32); break;
+    case OP_ADDI: load_greg(e, EAX, d->rs1); alu_eax_imm(e, 0x05, d->imm); store_greg(e, EAX, d->wd); break;
+    case OP_XORI: load_greg(e, EAX, d->rs1); alu_eax_imm(e, 0x35, d->imm); store_greg(e, EAX, d->wd); break;
+    case OP_ORI:  load_greg(e, EAX, d->rs1); alu_eax_imm(e, 0x0D, d->imm); store_greg(e, EAX, d->wd); break;
+    case OP_ANDI: load_greg(e, EAX, d->rs1); alu_eax_imm(e, 0x25, d->imm); store_greg(e, EAX, d->wd); break;
+    case OP_ADD: load_greg(e, EAX, d->rs1); alu_greg(e, 0x03, EAX, d->rs2); store_greg(e, EAX, d->wd); break;
+    case OP_SUB: load_greg(e, EAX, d->rs1); alu_greg(e, 0x2B, EAX, d->rs2); store_greg(e, EAX, d->wd); break;
+    case OP_XOR: load_greg(e, EAX, d->rs1); alu_greg(e, 0x33, EAX, d->rs2); store_greg(e, EAX, d->wd); break;
+    case OP_OR:  load_greg(e, EAX, d->rs1); alu_greg(e, 0x0B, EAX, d->rs2); store_greg(e, EAX, d->wd); break;
+    case OP_AND: load_greg(e, EAX, d->rs1); alu_greg(e, 0x23, EAX, d->rs2); store_greg(e, EAX, d->wd); break;
+    case OP_MUL:
+      load_greg(e, EAX, d->rs1);
+      e8(e, 0x0F); e8(e, 0xAF); mrm_reg(e, EAX, d->rs2);   // imul eax, x[rs2]
+      store_greg(e, EAX, d->wd);
+      break;
+    case OP_LUI:   store_greg_imm(e, d->wd, d->imm); break;
+    case OP_AUIPC: store_greg_imm(e, d->wd, pc + d->imm); break;
+    case OP_JAL:
+      store_greg_imm(e, d->wd, pc + 4);
+      mov_imm(e, EAX, pc + d->imm);
+      emit_epilogue(e);
+      break;
+    case OP_JALR:
+      emit_addr(e, d);                          // target read before rd is written
+      store_greg_imm(e, d->wd, pc + 4);
+      emit_epilogue(e);
+      break;
+    case OP_BEQ:  emit_branch(e, d, pc, 0x4); break;
+    case OP_BNE:  emit_branch(e, d, pc, 0x5); break;
+    case OP_BLT:  emit_branch(e, d, pc, 0xC); break;
+    case OP_BGE:  emit_branch(e, d, pc, 0xD); break;
+    case OP_BLTU: emit_branch(e, d, pc, 0x2); break;
+    case OP_BGEU: emit_branch(e, d, pc, 0x3); break;
+    case OP_ECALL:
+      // check mode would run the system call twice, the interpreter runs these blocks
+      if (jit->check) return -1;
+      emit_ecall(e);
+      break;
+    case OP_LOOKUP:
+      // end of a block without control transfer, continue after it
+      mov_imm(e, EAX, pc);
+      emit_epilogue(e);
+      break;
+    default:
+      return -1;
+    }
+  }
+  return 0;
+}
+
+#endif
+
+
+int jit_create(JIT *jit, uint32_t code_limit, uint32_t ram_limit, uint64_t threshold, size_t size, int check) {
+
+  if (jit == NULL) return -1;
+
+  memset(jit, 0, sizeof(JIT));
+  if (size < JIT_MIN_CODE_SIZE) return -1;
+  jit->threshold = threshold;
+  jit->size = size;
+  jit->check = check;
+  jit->code_limit = code_limit;
+  jit->ram_limit = ram_limit;
+#ifdef JIT_X86_64
+  void *code = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED) return -2;
+  jit->code = (uint8_t *)code;
+  return 0;
+#else
+  return -2;
+#endif
+}
+
+
+int jit_compile(JIT *jit, BLOCK_CACHE *bc, BLOCK *b) {
+#ifdef JIT_X86_64
+  EMIT e;
+
+  if (jit->used + JIT_MAX_BLOCK_CODE > jit->size) {
+    // buffer full: drop every native block and start over
+    block_drop_native(bc);
+    jit->used = 0;
+    jit->flushes++;
+  }
+  e.p = jit->code + jit->used;
+  if (jit_emit_block(jit, &e, b) != 0) {
+    jit->rejected++;
+    return -1;
+  }
+  b->native = (JIT_FN)(void *)(jit->code + jit->used);
+  jit->used = (size_t)(e.p - jit->code);
+  jit->compiled++;
+  return 0;
+#else
+  (void)jit; (void)bc; (void)b;
+  return -1;
+#endif
+}
+
+
+void jit_check_undo(JIT *jit, uint8_t *ram) {
+
+  for (uint32_t i = 0; i < jit->num_stores; i++) {
+    JIT_STORE *s = &jit->stores[i];
+    s->val = ram_load(ram, s->addr, s->size);
+  }
+  for (uint32_t i = jit->num_stores; i > 0; i--) {
+    JIT_STORE *s = &jit->stores[i - 1];
+    ram_store(ram, s->addr, s->old, s->size);
+  }
+}
+
+
+int jit_check_compare(JIT *jit, BLOCK *b, const uint32_t *regs, uint32_t pc,
+                      const uint32_t *jit_regs, uint32_t jit_pc, uint8_t *ram) {
+  int bad = 0;
+  int report = jit->mismatches < JIT_MAX_REPORTS;
+
+  jit->checked++;
+  if (pc != jit_pc) {
+    if (report) fprintf(stderr, "jit check: block %08x next pc %08x, interpreter %08x\n", b->pc, jit_pc, pc);
+    bad = 1;
+  }
+  for (int r = 1; r < 32; r++) {
+    if (regs[r] != jit_regs[r]) {
+      if (report) fprintf(stderr, "jit check: block %08x x%02d=%08x, interpreter %08x\n", b->pc, r, jit_regs[r], regs[r]);
+      bad = 1;
+    }
+  }
+  for (uint32_t i = 0; i < jit->num_stores; i++) {
+    JIT_STORE *s = &jit->stores[i];
+    uint32_t val = ram_load(ram, s->addr, s->size);
+    if (val != s->val) {
+      if (report) fprintf(stderr, "jit check: block %08x mem[%08x]=%08x, interpreter %08x\n", b->pc, s->addr, s->val, val);
+      bad = 1;
+    }
+  }
+  jit->num_stores = 0;
+  if (bad) jit->mismatches++;
+  return bad ? -1 : 0;
+}
+
+
+void jit_stats(JIT *jit, FILE *out) {
+
+  fprintf(out, "jit blocks compiled: %llu (%llu rejected, %llu flushes, %zu code bytes)\n",
+          (unsigned long long)jit->compiled, (unsigned long long)jit->rejected,
+          (unsigned long long)jit->flushes, jit->used);
+  fprintf(out, "jit native insts:    %llu\n", (unsigned long long)jit->native_insts);
+  if (jit->check)
+    fprintf(out, "jit checked blocks:  %llu (%llu mismatches)\n",
+            (unsigned long long)jit->checked, (unsigned long long)jit->mismatches);
+}
+
+
+void jit_dispose(JIT *jit) {
+
+#ifdef JIT_X86_64
+  if (jit->code) munmap(jit->code, jit->size);
+#endif
+  free(jit);
+}
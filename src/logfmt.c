@@ -0,0 +1,148 @@
+#include "include/logfmt.h"
+#include <errno.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+void logfmt_hex8(char *out, uint32_t v) {
+#if defined(__SSE2__)
+  // most significant byte first, then each byte split in its two nibbles
+  uint32_t be = (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+  __m128i x = _mm_cvtsi32_si128((int)be);
+  __m128i mask = _mm_set1_epi8(0x0F);
+  __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+  __m128i lo = _mm_and_si128(x, mask);
+  __m128i n = _mm_unpacklo_epi8(hi, lo);
+  // '0' + n, plus the distance to 'a' for the nibbles above 9
+  __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+  __m128i ascii = _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), letter);
+  _mm_storel_epi64((__m128i *)out, ascii);
+#else
+  static const char digits[16] = "0123456789abcdef";
+  for (int i = 7; i >= 0; i--, v >>= 4) out[i] = digits[v & 0xF];
+#endif
+}
+
+
+void logfmt_init(LOGFMT *fmt) {
+
+  memset(fmt->len, 0, sizeof(fmt->len));
+}
+
+
+/* entry of the mnemonic cache for an instruction word */
+static inline uint32_t logfmt_slot(uint32_t inst) {
+  return (inst ^ (inst >> LOGFMT_MNE_BITS) ^ (inst >> 20)) & ((1 << LOGFMT_MNE_BITS) - 1);
+}
+
+/* make sure the cache entry holds the mnemonic of inst */
+static inline void logfmt_mne(LOGFMT *fmt, uint32_t inst, uint32_t slot) {
+  if (fmt->len[slot] == 0 || fmt->inst[slot] != inst) {
+    core_disasm(inst, fmt->mne[slot], sizeof(fmt->mne[slot]));
+    fmt->inst[slot] = inst;
+    fmt->len[slot] = strlen(fmt->mne[slot]) + 1;
+  }
+}
+
+
+size_t logfmt_record_size(LOGFMT *fmt, const RLOG *rec) {
+  uint32_t inst = rec->h_inst;
+  uint32_t slot = logfmt_slot(inst);
+
+  if (rec->h_pc == RLOG_MARK) return LOGFMT_MARK;
+  logfmt_mne(fmt, inst, slot);
+  return LOGFMT_FIXED + fmt->len[slot];
+}
+
+
+/* "xNN=" followed by the value and a newline */
+static inline char *logfmt_reg(char *p, uint32_t reg, uint32_t value) {
+  p[0] = 'x';
+  p[1] = '0' + reg / 10;
+  p[2] = '0' + reg % 10;
+  p[3] = '=';
+  logfmt_hex8(p + 4, value);
+  p[12] = '\n';
+  return p + 13;
+}
+
+
+/* "# sample N at instruction N PC=X" line of a mark record */
+static size_t logfmt_mark(char *out, const RLOG *rec) {
+  char *p = out;
+
+  memcpy(p, "# sample ", 9);
+  logfmt_hex8(p + 9, rec->h_inst);
+  memcpy(p + 17, " at instruction ", 16);
+  logfmt_hex8(p + 33, rec->h_rs1);
+  logfmt_hex8(p + 41, rec->h_rd);
+  memcpy(p + 49, " PC=", 4);
+  logfmt_hex8(p + 53, rec->h_rs2);
+  p[61] = '\n';
+  return LOGFMT_MARK;
+}
+
+
+size_t logfmt_record(LOGFMT *fmt, char *out, const RLOG *rec) {
+  uint32_t inst = rec->h_inst;
+  uint32_t slot = logfmt_slot(inst);
+  char *p = out;
+
+  if (rec->h_pc == RLOG_MARK) return logfmt_mark(out, rec);
+
+  memcpy(p, "PC=", 3);
+  logfmt_hex8(p + 3, rec->h_pc);
+  p[11] = '\n';
+  p[12] = '[';
+  logfmt_hex8(p + 13, inst);
+  p[21] = ']';
+  p[22] = '\n';
+  p += 23;
+  // register numbers come from the instruction word
+  p = logfmt_reg(p, (inst >> 7) & 0x1F, rec->h_rd);
+  p = logfmt_reg(p, (inst >> 15) & 0x1F, rec->h_rs1);
+  p = logfmt_reg(p, (inst >> 20) & 0x1F, rec->h_rs2);
+
+  logfmt_mne(fmt, inst, slot);
+  memcpy(p, fmt->mne[slot], fmt->len[slot] - 1);
+  p += fmt->len[slot] - 1;
+  *p++ = '\n';
+  return p - out;
+}
+
+
+int logfmt_out_create(LOGFMT_OUT *out, int fd, size_t size) {
+
+  if (out == NULL) return -1;
+  if (size < LOGFMT_MAX_RECORD) size = LOGFMT_MAX_RECORD;
+  out->buf = (char *)malloc(size);
+  if (out->buf == NULL) return -2;
+  out->fd = fd;
+  out->len = 0;
+  out->size = size;
+  out->error = 0;
+  return 0;
+}
+
+
+void logfmt_out_flush(LOGFMT_OUT *out) {
+  size_t done = 0;
+
+  while (done < out->len && !out->error) {
+    ssize_t n = write(out->fd, out->buf + done, out->len - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) out->error = 1;
+    else done += n;
+  }
+  out->len = 0;
+}
+
+
+void logfmt_out_dispose(LOGFMT_OUT *out) {
+
+  logfmt_out_flush(out);
+  free(out->buf);
+  out->buf = NULL;
+}
@@ -0,0 +1,168 @@
+#include "include/logpar.h"
+#include <errno.h>
+#include <unistd.h>
+
+static void *logpar_thread(void *arg);
+static int logpar_work(LOGPAR_WORKER *w);
+static void logpar_free(LOGPAR *pool);
+
+
+int logpar_create(LOGPAR *pool, int threads) {
+
+  if (pool == NULL) return -1;
+
+  if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads <= 0) threads = 1;
+  if (threads > LOGPAR_MAX_THREADS) threads = LOGPAR_MAX_THREADS;
+  pool->num_threads = threads;
+  pool->quit = 0;
+  pool->max_chunks = 0;
+  pool->offset = NULL;
+  pool->workers = (LOGPAR_WORKER *)calloc(threads, sizeof(LOGPAR_WORKER));
+  if (pool->workers == NULL) return -2;
+  for (int i = 0; i < threads; i++) {
+    pool->workers[i].pool = pool;
+    logfmt_init(&pool->workers[i].fmt);
+    pool->workers[i].buf = (char *)malloc(LOGPAR_CHUNK * LOGFMT_MAX_RECORD);
+    if (pool->workers[i].buf == NULL) {
+      while (i >= 0) free(pool->workers[i--].buf);
+      free(pool->workers);
+      return -2;
+    }
+  }
+  pthread_barrier_init(&pool->start, NULL, threads);
+  pthread_barrier_init(&pool->sized, NULL, threads);
+  pthread_barrier_init(&pool->offsets, NULL, threads);
+  pthread_barrier_init(&pool->done, NULL, threads);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->launched, NULL);
+  pool->started = 0;
+  // worker 0 is the thread calling logpar_write()
+  int started = 1;
+  while (started < threads &&
+         pthread_create(&pool->workers[started].thread, NULL, logpar_thread, &pool->workers[started]) == 0)
+    started++;
+
+  /* the barriers are sized for all the threads: they wait until all of them are started */
+  pthread_mutex_lock(&pool->lock);
+  pool->started = started == threads ? 1 : -1;
+  pthread_cond_broadcast(&pool->launched);
+  pthread_mutex_unlock(&pool->lock);
+  if (started == threads) return 0;
+
+  // the threads started leave without a job
+  for (int i = 1; i < started; i++) pthread_join(pool->workers[i].thread, NULL);
+  logpar_free(pool);
+  return -4;
+}
+
+
+int64_t logpar_write(LOGPAR *pool, int fd, uint64_t offset, const RLOG *recs, size_t n) {
+  size_t chunks = (n + LOGPAR_CHUNK - 1) / LOGPAR_CHUNK;
+
+  if (n == 0) return 0;
+  if (chunks > pool->max_chunks) {
+    uint64_t *grown = (uint64_t *)realloc(pool->offset, (chunks + 1) * sizeof(uint64_t));
+    if (grown == NULL) return -2;
+    pool->offset = grown;
+    pool->max_chunks = chunks;
+  }
+  pool->recs = recs;
+  pool->num_recs = n;
+  pool->num_chunks = chunks;
+  pool->fd = fd;
+  pool->offset[0] = offset;
+  atomic_store(&pool->next, 0);
+  atomic_store(&pool->error, 0);
+
+  logpar_work(&pool->workers[0]);
+  if (atomic_load(&pool->error)) return -1;
+  return (int64_t)(pool->offset[chunks] - offset);
+}
+
+
+void logpar_dispose(LOGPAR *pool) {
+
+  pool->quit = 1;
+  pthread_barrier_wait(&pool->start);
+  for (int i = 1; i < pool->num_threads; i++) pthread_join(pool->workers[i].thread, NULL);
+  logpar_free(pool);
+  free(pool);
+}
+
+
+/* what the pool holds, its threads joined */
+static void logpar_free(LOGPAR *pool) {
+
+  pthread_barrier_destroy(&pool->start);
+  pthread_barrier_destroy(&pool->sized);
+  pthread_barrier_destroy(&pool->offsets);
+  pthread_barrier_destroy(&pool->done);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->launched);
+  for (int i = 0; i < pool->num_threads; i++) free(pool->workers[i].buf);
+  free(pool->workers);
+  free(pool->offset);
+}
+
+
+/* pool threads, one job per pass through the start barrier */
+static void *logpar_thread(void *arg) {
+  LOGPAR_WORKER *w = (LOGPAR_WORKER *)arg;
+  LOGPAR *pool = w->pool;
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->started == 0) pthread_cond_wait(&pool->launched, &pool->lock);
+  int run = pool->started > 0;
+  pthread_mutex_unlock(&pool->lock);
+  if (!run) return NULL;
+  // quit is only read past the start barrier, where dispose sets it before waiting
+  while (logpar_work(w)) ;
+  return NULL;
+}
+
+
+/* one job: size the chunks, prefix sum by worker 0, format and write them */
+/* returns 0 when the pool is closing instead */
+static int logpar_work(LOGPAR_WORKER *w) {
+  LOGPAR *pool = w->pool;
+  size_t c;
+
+  pthread_barrier_wait(&pool->start);
+  if (pool->quit) return 0;
+
+  // chunk c size is kept in offset[c + 1] until the prefix sum
+  while ((c = atomic_fetch_add(&pool->next, 1)) < pool->num_chunks) {
+    size_t first = c * LOGPAR_CHUNK;
+    size_t last = first + LOGPAR_CHUNK < pool->num_recs ? first + LOGPAR_CHUNK : pool->num_recs;
+    uint64_t size = 0;
+    for (size_t i = first; i < last; i++) size += logfmt_record_size(&w->fmt, &pool->recs[i]);
+    pool->offset[c + 1] = size;
+  }
+  pthread_barrier_wait(&pool->sized);
+
+  if (w == &pool->workers[0]) {
+    for (c = 0; c < pool->num_chunks; c++) pool->offset[c + 1] += pool->offset[c];
+    atomic_store(&pool->next, 0);
+  }
+  pthread_barrier_wait(&pool->offsets);
+
+  while ((c = atomic_fetch_add(&pool->next, 1)) < pool->num_chunks) {
+    size_t first = c * LOGPAR_CHUNK;
+    size_t last = first + LOGPAR_CHUNK < pool->num_recs ? first + LOGPAR_CHUNK : pool->num_recs;
+    size_t len = 0, done = 0;
+    for (size_t i = first; i < last; i++) len += logfmt_record(&w->fmt, w->buf + len, &pool->recs[i]);
+    assert(len == pool->offset[c + 1] - pool->offset[c]);
+    while (done < len) {
+      ssize_t n = pwrite(pool->fd, w->buf + done, len - done, (off_t)(pool->offset[c] + done));
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) {
+        atomic_store(&pool->error, 1);
+        break;
+      }
+      done += n;
+    }
+  }
+  pthread_barrier_wait(&pool->done);
+  return 1;
+}
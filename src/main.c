@@ -1,83 +1,131 @@
 //#include <ansi_c.h>
 #include "include/common.h"
-#include "include/core.h"
-#include "include/mem.h"
-#include "include/ringbuffer.h"
+#include "include/batch.h"
+#include "include/options.h"
+#include "include/sample.h"
+#include "include/sim.h"
+
+/* every binary at once, a report line per binary, fails if one of them did */
+static int main_batch(OPTIONS *opt) {
+  BATCH *batch = (BATCH *)malloc(sizeof(BATCH));
+  if (batch_create(batch, &opt->sim, opt->max_insts, opt->jobs) != 0) {
+    printf("FAIL to create the batch.\n");
+    exit(-1);
+  }
+  for (int i = 0; i < opt->num_files; i++) {
+    if (batch_add(batch, opt->files[i]) != 0) {
+      printf("FAIL to add %s to the batch.\n", opt->files[i]);
+      exit(-1);
+    }
+  }
+  if (opt->manifest && batch_add_manifest(batch, opt->manifest) != 0) {
+    printf("FAIL to read the manifest %s.\n", opt->manifest);
+    exit(-1);
+  }
+  if (batch_run(batch) != 0) {
+    printf("FAIL to run the batch.\n");
+    exit(-1);
+  }
+  uint32_t failed = batch_report(batch, stdout);
+  batch_dispose(batch);
+  return failed ? 1 : 0;
+}
 
 int main(int argc, char *argv[]) {
 
   /* Check if there is code path arg */
-  if (argc < 2) {
-    printf("Requires rv32im binary [filename]\n");
+  OPTIONS opt;
+  if (options_parse(&opt, argc, argv) != 0) {
+    options_usage(argv[0]);
     exit(-1);
   }
+  if (opt.batch) {
+    int failed = main_batch(&opt);
+    options_dispose(&opt);
+    return failed;
+  }
 
-  /* Upload instruction list from binary file to the code instruction_vector array*/
-  const char *filename = argv[1];
-  FILE *binfile = fopen(filename, "rb"); // read binary mode
-  if (!binfile) {
-    printf("FAIL to open the file.\n");
+  /* Guest RAM, core, devices and log file */
+  SIM *sim = (SIM *)malloc(sizeof(SIM));
+  int err = sim_create(sim, &opt.sim);
+  if (err == -3) {
+    printf("FAIL to open the log file.\n");
     exit(-1);
+  } else if (err != 0) {
+    printf("FAIL to allocate the guest RAM.\n");
+    exit(-1);
+  }
+
+  if (opt.restore) {
+    /* RAM, registers and PC of a snapshot, the run goes on from there */
+    err = sim_restore_snapshot(sim, opt.restore);
+    if (err == -3) {
+      printf("%s is not a snapshot.\n", opt.restore);
+      exit(-1);
+    } else if (err != 0) {
+      printf("FAIL to restore the snapshot.\n");
+      exit(-1);
+    }
+  } else {
+    /* Binary file mapped at address 0 */
+    err = sim_load_file(sim, opt.filename);
+    if (err == -3) {
+      printf("The file does not fit in the guest RAM.\n");
+      exit(-1);
+    } else if (err != 0) {
+      printf("FAIL to open the file.\n");
+      exit(-1);
+    }
   }
-  fseek(binfile, 0L, SEEK_END); // move pointer to the end
-  size_t inst_vector_length = ftell(binfile); // get pointer position
-  rewind(binfile); // return pointer to the begining
-  uint8_t *inst_vector = (uint8_t *)malloc(inst_vector_length); // allocate instructions vector in the binary file lenght in bytes
-  fread(inst_vector, sizeof(uint8_t), inst_vector_length, binfile); //copy binary file to instructions vector
-  fclose(binfile);
 
-  /* Allocate CORE struct and its resources*/
-  /* reference: https://en.wikichip.org/wiki/risc-v/registers*/
-  CORE *core = (CORE *)malloc(sizeof(CORE));
-  memset(core->regs, 0, sizeof(core->regs));
-  core->regs[0] = 0;
-  core->regs[2] = 8192000; // 8MB, number candidate for #define
-  core->pc = 0x0;
-  core->ram = (uint8_t *)malloc(8192000);
-  memcpy(core->ram, inst_vector, inst_vector_length);
+  /* Run up to the snapshot point, save it and go on */
+  SIM_STATUS status = SIM_RUNNING;
+  uint64_t start = sim->insts;
+  if (opt.snapshot_at) {
+    if (opt.snapshot_at_pc)
+      status = sim_run_until(sim, opt.snapshot_pc, opt.max_insts);
+    else if (sim->insts < opt.snapshot_insts)
+      status = sim_run(sim, opt.snapshot_insts - sim->insts < opt.max_insts ? opt.snapshot_insts - sim->insts : opt.max_insts);
+    int reached = opt.snapshot_at_pc ? sim_get_pc(sim) == opt.snapshot_pc : sim->insts == opt.snapshot_insts;
+    if (status != SIM_RUNNING || !reached) {
+      fprintf(stderr, "The snapshot point was not reached, no snapshot saved.\n");
+    } else if (sim_save_snapshot(sim, opt.snapshot_file) != 0) {
+      printf("FAIL to write the snapshot %s.\n", opt.snapshot_file);
+      exit(-1);
+    } else {
+      fprintf(stderr, "Snapshot %s saved at instruction %llu, PC=%08x\n", opt.snapshot_file,
+              (unsigned long long)sim->insts, sim_get_pc(sim));
+    }
+  }
 
-  /* Allocate LOG struct and N log ringbuffer*/
-  RLOG rlog;
-  RINGBUFFER_TYPE *rb_log = (RINGBUFFER_TYPE *)malloc(sizeof(RINGBUFFER_TYPE));
-  RINGBUFFER_VAR *rb_var = (RINGBUFFER_VAR *)malloc(sizeof(RINGBUFFER_VAR));
-  ringbuffer_create(rb_log, (100 * sizeof(RLOG))); //100 log struct buffer
-  ringbuffer_status(rb_log, rb_var);
-  //check rb allocation
-  //printf("rb_var.fill=%d\n", rb_var->fill);
-  //printf("rb_var.free=%d\n", rb_var->free);
-  //printf("rb_var.size=%d\n", rb_var->size);
-    uint32_t num_inst = 0;
-  
-  /* Run the code until its end*/
-  while (1) {
-	uint32_t inst_raw = core_load(core, core->pc, 32);
-    core->pc += 4;
-	rlog.h_pc = core->pc;
-	rlog.h_inst = inst_raw;
-	rlog.mne[0] = 0;
-    if (core->pc > inst_vector_length) break;
-	core_execute(core, inst_raw, &rlog);
-	num_inst++;
-	ringbuffer_put(rb_log, &rlog, 0, sizeof(RLOG)); //put log struct in the ringbuffer
-    if (core->pc == 0) break;
-	//printf("num_inst=%d\n", num_inst);
+  /* Run the code until its end, only logging the samples when sampling */
+  SAMPLER sampler;
+  uint64_t done = sim->insts - start;
+  uint64_t left = opt.max_insts == UINT64_MAX ? UINT64_MAX : opt.max_insts - done;
+  if (opt.sampling) {
+    if (sample_create(&sampler, &opt.sample) != 0) {
+      printf("FAIL to create the sampler.\n");
+      exit(-1);
+    }
+    status = sample_run(&sampler, sim, left);
+  } else if (status == SIM_RUNNING && done < opt.max_insts) {
+    status = sim_run(sim, left);
   }
-  
-  /* Parse and stream ringbuffer log to disk*/
-  FILE *flog = fopen("log.txt", "w"); 
-  for (int i = 0; i < num_inst; i++) {
-	ringbuffer_get(rb_log, &rlog, 0, sizeof(RLOG));
-	fprintf(flog,"PC=%08x\n", rlog.h_pc);
-	fprintf(flog,"[%08x]\n", rlog.h_inst);
-	fprintf(flog,"x%02d=%08x\n", rlog.rd, rlog.h_rd);
-	fprintf(flog,"x%02d=%08x\n", rlog.rs1, rlog.h_rs1);
-	fprintf(flog,"x%02d=%08x\n", rlog.rs2, rlog.h_rs2);
-	fprintf(flog,"%s\n", rlog.mne);
+  if (status == SIM_FAULT) {
+    printf("Guest access fault at address %08x, PC=%08x\n", sim->ram->fault_addr, sim_get_pc(sim));
+    sim_destroy(sim);
+    exit(-1);
   }
-  fclose(flog); 
 
-  /* Deallocate CORE struct and its resources*/
-  free(core->ram);
-  free(core);
-  ringbuffer_dispose(rb_log);
+  /* Stream the records left in the ringbuffer to disk*/
+  sim_finish(sim);
+  if (opt.stats) sim_stats(sim, stderr);
+  else sim_model_stats(sim, stderr);
+  if (opt.stats && opt.sampling) sample_stats(&sampler, stderr);
+
+  /* the guest output goes out before the simulator ends, with its exit code */
+  int exit_code = sim_exit_code(sim);
+  sim_destroy(sim);
+  options_dispose(&opt);
+  return exit_code;
 }
@@ -1,12 +1,10 @@
 #include "include/mem.h"
 #include "include/common.h"
-
-static uint32_t ram_load8(uint8_t *, uint32_t);
-static uint32_t ram_load16(uint8_t *, uint32_t);
-static uint32_t ram_load32(uint8_t *, uint32_t);
-static void ram_store8(uint8_t *, uint32_t, uint32_t);
-static void ram_store16(uint8_t *, uint32_t, uint32_t);
-static void ram_store32(uint8_t *, uint32_t, uint32_t);
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 uint32_t ram_load(uint8_t *mem, uint32_t addr, uint8_t size) {
   switch (size) {
@@ -18,43 +16,118 @@ uint32_t ram_load(uint8_t *mem, uint32_t addr, uint8_t size) {
   return 0;
 }
 
-void ram_store(uint8_t *mem, uint32_t addr, uint32_t value, uint8_t size) {
-  switch (size) {
-  case 8:  ram_store8(mem, addr, value);  break;
-  case 16: ram_store16(mem, addr, value); break;
-  case 32: ram_store32(mem, addr, value); break;
-  default: ;
+int ram_create(RAM *ram, size_t size, int huge) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t align = huge ? MEM_HUGE_PAGE : page;
+
+  if (ram == NULL) return -1;
+  // whole pages, the first byte past the RAM faults
+  if (size == 0 || size > MEM_RAM_MAX || (size & (page - 1))) return -1;
+  ram->size = size;
+  ram->image = 0;
+  ram->map_size = size;
+  // the whole guest address space and the guard pages, huge pages need a 2 MB aligned base
+  ram->map_len = MEM_RAM_MAX + MEM_GUARD + (huge ? align : 0);
+  ram->map = mmap(NULL, ram->map_len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (ram->map == MAP_FAILED) return -2;
+  ram->base = (uint8_t *)(((uintptr_t)ram->map + align - 1) & ~(uintptr_t)(align - 1));
+  // only the RAM is accessible, the rest of the reservation faults
+  if (mprotect(ram->base, ram->map_size, PROT_READ | PROT_WRITE) != 0) {
+    munmap(ram->map, ram->map_len);
+    return -2;
   }
+#ifdef MADV_HUGEPAGE
+  if (huge) madvise(ram->base, ram->map_size, MADV_HUGEPAGE);
+#endif
+  return 0;
 }
 
-static uint32_t ram_load8(uint8_t *mem, uint32_t addr) {
-  return (uint32_t)mem[addr];
+/* guest access faults resume at ram_resume, the RAM of the run is ram_guarded, */
+/* both per thread so each simulation thread catches the faults of its own RAM */
+static __thread RAM *ram_guarded;
+static __thread sigjmp_buf *ram_resume;
+static atomic_int ram_handler;    // the SIGSEGV handler is installed
+
+static void ram_fault(int sig, siginfo_t *info, void *ctx) {
+  uint8_t *addr = (uint8_t *)info->si_addr;
+  (void)ctx;
+
+  if (ram_guarded && addr >= ram_guarded->base && addr < ram_guarded->base + MEM_RAM_MAX + MEM_GUARD) {
+    ram_guarded->fault_addr = (uint32_t)(addr - ram_guarded->base);
+    siglongjmp(*ram_resume, 1);
+  }
+  // a host fault, let it kill the process as usual
+  signal(sig, SIG_DFL);
 }
 
-static uint32_t ram_load16(uint8_t *mem, uint32_t addr) {
-  return ((uint32_t)mem[addr] |
-		  ((uint32_t)mem[addr + 1] << 8));
+int ram_guard(RAM *ram, sigjmp_buf *resume) {
+  struct sigaction sa;
+
+  ram_guarded = ram;
+  ram_resume = resume;
+  if (ram == NULL || atomic_exchange(&ram_handler, 1)) return 0;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = ram_fault;
+  // SIGSEGV is not blocked in the handler, leaving it keeps the signal mask
+  // and resume needs no sigprocmask() call in sigsetjmp()
+  sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGSEGV, &sa, NULL) != 0) {
+    atomic_store(&ram_handler, 0);
+    return -1;
+  }
+  return 0;
 }
 
-static uint32_t ram_load32(uint8_t *mem, uint32_t addr) {
-  return ((uint32_t)mem[addr] |
-		  ((uint32_t)mem[addr + 1] << 8) |
-          ((uint32_t)mem[addr + 2] << 16) |
-          ((uint32_t)mem[addr + 3] << 24));
+int ram_copy_image(RAM *ram, const void *buf, size_t len) {
+
+  if (buf == NULL && len > 0) return -1;
+  if (len > ram->size) return -3;
+  memcpy(ram->base, buf, len);
+  ram->image = len;
+  return 0;
 }
 
-static void ram_store8(uint8_t *mem, uint32_t addr, uint32_t value) {
-  mem[addr] = (uint8_t)value;
+int ram_map_image(RAM *ram, const char *path) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  struct stat st;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return -1;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+  if ((uint64_t)st.st_size > ram->size) {
+    close(fd);
+    return -3;
+  }
+  ram->image = st.st_size;
+  // the file replaces the first anonymous pages, the tail of its last page reads as zeros
+  if (ram->image > 0) {
+    size_t len = (ram->image + page - 1) & ~(page - 1);
+    void *p = mmap(ram->base, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      return -2;
+    }
+  }
+  close(fd);
+  return 0;
 }
 
-static void ram_store16(uint8_t *mem, uint32_t addr, uint32_t value) {
-  mem[addr] = (uint8_t)value & 0xFF;
-  mem[addr + 1] = (uint8_t)(value >> 8) & 0xFF;
+void ram_dispose(RAM *ram) {
+
+  if (ram_guarded == ram) ram_guarded = NULL;
+  munmap(ram->map, ram->map_len);
+  free(ram);
 }
 
-static void ram_store32(uint8_t *mem, uint32_t addr, uint32_t value) {
-  mem[addr] = (uint8_t)value & 0xFF;
-  mem[addr + 1] = (uint8_t)(value >> 8) & 0xFF;
-  mem[addr + 2] = (uint8_t)(value >> 16) & 0xFF;
-  mem[addr + 3] = (uint8_t)(value >> 24) & 0xFF;
+void ram_store(uint8_t *mem, uint32_t addr, uint32_t value, uint8_t size) {
+  switch (size) {
+  case 8:  ram_store8(mem, addr, value);  break;
+  case 16: ram_store16(mem, addr, value); break;
+  case 32: ram_store32(mem, addr, value); break;
+  default: ;
+  }
 }
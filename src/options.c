@@ -0,0 +1,353 @@
+#include "include/options.h"
+#include "include/jit.h"
+#include "include/mem.h"
+#include <unistd.h>
+
+/* value of "--name=value" when arg is that option, NULL otherwise */
+static const char *option_value(const char *arg, const char *name) {
+  size_t len = strlen(name);
+  if (strncmp(arg, name, len) == 0 && arg[len] == '=') return arg + len + 1;
+  return NULL;
+}
+
+int options_parse(OPTIONS *opt, int argc, char *argv[]) {
+  const char *val;
+
+  opt->filename = NULL;
+  opt->files = (const char **)malloc(argc * sizeof(const char *));
+  opt->num_files = 0;
+  if (opt->files == NULL) return -1;
+  opt->batch = 0;
+  opt->manifest = NULL;
+  opt->jobs = 0;
+  opt->stats = 0;
+  opt->max_insts = UINT64_MAX;
+  opt->snapshot_at = 0;
+  opt->snapshot_at_pc = 0;
+  opt->snapshot_pc = 0;
+  opt->snapshot_insts = 0;
+  opt->snapshot_file = "snapshot.snap";
+  opt->restore = NULL;
+  opt->sampling = 0;
+  memset(&opt->sample, 0, sizeof(opt->sample));
+  opt->sample.size = SAMPLE_SIZE;
+  int sample_at = 0;
+  int log_set = 0;      // --log or --log-format given
+  sim_config_default(&opt->sim);
+  opt->sim.log = TRACE_FULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if ((val = option_value(arg, "--engine"))) {
+      if (strcmp(val, "switch") == 0) opt->sim.engine = ENGINE_SWITCH;
+      else if (strcmp(val, "predecode") == 0) opt->sim.engine = ENGINE_PREDECODE;
+      else if (strcmp(val, "threaded") == 0) opt->sim.engine = ENGINE_THREADED;
+      else if (strcmp(val, "block") == 0) opt->sim.engine = ENGINE_BLOCK;
+      else {
+        printf("Unknown engine: %s\n", val);
+        return -1;
+      }
+    } else if ((val = option_value(arg, "--timing"))) {
+      if (strcmp(val, "off") == 0) opt->sim.timing = TIMING_OFF;
+      else if (strcmp(val, "pipeline") == 0) opt->sim.timing = TIMING_PIPELINE;
+      else {
+        printf("Unknown timing model: %s\n", val);
+        return -1;
+      }
+    } else if ((val = option_value(arg, "--mul-latency")) || (val = option_value(arg, "--branch-penalty")) ||
+               (val = option_value(arg, "--jump-penalty"))) {
+      char *end;
+      unsigned long n = strtoul(val, &end, 0);
+      if (*val == 0 || *end != 0 || n > 1000 || (arg[2] == 'm' && n == 0)) {
+        printf("Bad cycle count: %s\n", val);
+        return -1;
+      }
+      if (arg[2] == 'm') opt->sim.pipeline.mul_latency = n;
+      else if (arg[2] == 'b') opt->sim.pipeline.branch_penalty = n;
+      else opt->sim.pipeline.jump_penalty = n;
+      opt->sim.timing = TIMING_PIPELINE;
+    } else if ((val = option_value(arg, "--l1i")) || (val = option_value(arg, "--l1d"))) {
+      CACHE_CONFIG *cache = arg[4] == 'i' ? &opt->sim.l1i : &opt->sim.l1d;
+      if (cache_parse(cache, val) != 0) {
+        printf("Bad cache: %s\n", val);
+        return -1;
+      }
+    } else if ((val = option_value(arg, "--bpred"))) {
+      if (bpred_parse(&opt->sim.bpred, val) != 0) {
+        printf("Bad branch predictors: %s\n", val);
+        return -1;
+      }
+    } else if ((val = option_value(arg, "--btb")) || (val = option_value(arg, "--ras"))) {
+      char *end;
+      unsigned long n = strtoul(val, &end, 0);
+      int btb = arg[2] == 'b';
+      if (*val == 0 || *end != 0 || n == 0 || n > (1u << 20) || (btb && (n & (n - 1)))) {
+        printf("Bad %s entries: %s\n", btb ? "BTB" : "RAS", val);
+        return -1;
+      }
+      if (btb) opt->sim.bpred.btb = (uint32_t)n;
+      else opt->sim.bpred.ras = (uint32_t)n;
+      // the BTB and the RAS go with the default predictor
+      if (opt->sim.bpred.num == 0) bpred_parse(&opt->sim.bpred, "gshare");
+    } else if ((val = option_value(arg, "--model-threads"))) {
+      char *end;
+      long n = strtol(val, &end, 0);
+      if (*val == 0 || *end != 0 || n < 0 || n > RETIRE_THREADS) {
+        printf("Bad model threads: %s\n", val);
+        return -1;
+      }
+      opt->sim.model_threads = (int)n;
+    } else if (strcmp(arg, "--stack-distance") == 0) {
+      opt->sim.reuse_line = 64;
+    } else if ((val = option_value(arg, "--stack-distance"))) {
+      char *end;
+      unsigned long line = strtoul(val, &end, 0);
+      if (*val == 0 || *end != 0 || line < 4 || line > 4096 || (line & (line - 1))) {
+        printf("Bad line size: %s\n", val);
+        return -1;
+      }
+      opt->sim.reuse_line = (uint32_t)line;
+    } else if (strcmp(arg, "--no-forwarding") == 0) {
+      opt->sim.pipeline.forwarding = 0;
+      opt->sim.timing = TIMING_PIPELINE;
+    } else if ((val = option_value(arg, "--jit-threshold"))) {
+      char *end;
+      opt->sim.jit_threshold = strtoull(val, &end, 0);
+      if (*val == 0 || *end != 0) {
+        printf("Bad JIT threshold: %s\n", val);
+        return -1;
+      }
+      if (opt->sim.jit_threshold == 0) opt->sim.jit_threshold = 1;
+      opt->sim.jit = 1;
+    } else if ((val = option_value(arg, "--jit-code"))) {
+      char *end;
+      opt->sim.jit_code_size = strtoull(val, &end, 0);
+      if (*end == 'K' || *end == 'k') opt->sim.jit_code_size <<= 10, end++;
+      else if (*end == 'M' || *end == 'm') opt->sim.jit_code_size <<= 20, end++;
+      if (*val == 0 || *end != 0 || opt->sim.jit_code_size < JIT_MIN_CODE_SIZE || opt->sim.jit_code_size > (1u << 30)) {
+        printf("Bad JIT code size: %s\n", val);
+        return -1;
+      }
+      opt->sim.jit = 1;
+    } else if (strcmp(arg, "--jit") == 0) {
+      opt->sim.jit = 1;
+    } else if (strcmp(arg, "--jit-check") == 0) {
+      opt->sim.jit = 1;
+      opt->sim.jit_check = 1;
+    } else if ((val = option_value(arg, "--log"))) {
+      log_set = 1;
+      if (strcmp(val, "off") == 0) opt->sim.log = TRACE_OFF;
+      else if (strcmp(val, "full") == 0) opt->sim.log = TRACE_FULL;
+      else if (strncmp(val, "last:", 5) == 0) {
+        char *end;
+        unsigned long n = strtoul(val + 5, &end, 0);
+        if (val[5] == 0 || *end != 0 || n == 0 || n > (1u << 30)) {
+          printf("Bad log size: %s\n", val + 5);
+          return -1;
+        }
+        opt->sim.log = TRACE_LAST;
+        opt->sim.log_last = n;
+      } else {
+        printf("Unknown log mode: %s\n", val);
+        return -1;
+      }
+    } else if ((val = option_value(arg, "--log-format"))) {
+      log_set = 1;
+      if (strcmp(val, "text") == 0) opt->sim.log_format = TRACE_TEXT;
+      else if (strcmp(val, "bin") == 0) opt->sim.log_format = TRACE_BIN;
+      else {
+        printf("Unknown log format: %s\n", val);
+        return -1;
+      }
+    } else if ((val = option_value(arg, "--log-threads"))) {
+      char *end;
+      opt->sim.log_threads = strtol(val, &end, 0);
+      if (*val == 0 || *end != 0 || opt->sim.log_threads < 0) {
+        printf("Bad log threads: %s\n", val);
+        return -1;
+      }
+    } else if ((val = option_value(arg, "--ram"))) {
+      char *end;
+      opt->sim.ram_size = strtoull(val, &end, 0);
+      if (*end == 'K' || *end == 'k') opt->sim.ram_size <<= 10, end++;
+      else if (*end == 'M' || *end == 'm') opt->sim.ram_size <<= 20, end++;
+      else if (*end == 'G' || *end == 'g') opt->sim.ram_size <<= 30, end++;
+      // the end of the RAM faults only on a page boundary
+      if (*val == 0 || *end != 0 || opt->sim.ram_size == 0 || opt->sim.ram_size > MEM_RAM_MAX ||
+          opt->sim.ram_size % (uint64_t)sysconf(_SC_PAGESIZE)) {
+        printf("Bad RAM size, not a multiple of %ld bytes: %s\n", sysconf(_SC_PAGESIZE), val);
+        return -1;
+      }
+    } else if ((val = option_value(arg, "--brk"))) {
+      char *end;
+      unsigned long long brk = strtoull(val, &end, 0);
+      if (*val == 0 || *end != 0 || brk == 0 || brk >= MEM_RAM_MAX) {
+        printf("Bad program break: %s\n", val);
+        return -1;
+      }
+      opt->sim.brk = (uint32_t)brk;
+    } else if ((val = option_value(arg, "--max-insts"))) {
+      char *end;
+      opt->max_insts = strtoull(val, &end, 0);
+      if (*val == 0 || *end != 0 || opt->max_insts == 0) {
+        printf("Bad instruction count: %s\n", val);
+        return -1;
+      }
+    } else if ((val = option_value(arg, "--save-snapshot-at"))) {
+      // instruction count, or pc:ADDR
+      char *end;
+      int at_pc = strncmp(val, "pc:", 3) == 0;
+      const char *num = at_pc ? val + 3 : val;
+      unsigned long long n = strtoull(num, &end, 0);
+      if (*num == 0 || *end != 0 || (at_pc && n >= MEM_RAM_MAX)) {
+        printf("Bad snapshot point: %s\n", val);
+        return -1;
+      }
+      opt->snapshot_at = 1;
+      opt->snapshot_at_pc = at_pc;
+      if (at_pc) opt->snapshot_pc = (uint32_t)n;
+      else opt->snapshot_insts = n;
+    } else if ((val = option_value(arg, "--snapshot-file"))) {
+      opt->snapshot_file = val;
+    } else if ((val = option_value(arg, "--restore-snapshot"))) {
+      opt->restore = val;
+    } else if ((val = option_value(arg, "--sample-size")) || (val = option_value(arg, "--sample-every"))) {
+      char *end;
+      uint64_t n = strtoull(val, &end, 0);
+      if (*val == 0 || *end != 0 || n == 0) {
+        printf("Bad sample instructions: %s\n", val);
+        return -1;
+      }
+      if (strncmp(arg, "--sample-size", 13) == 0) {
+        opt->sample.size = n;
+      } else {
+        opt->sample.period = n;
+        opt->sampling = 1;
+      }
+    } else if ((val = option_value(arg, "--sample-at"))) {
+      // instruction count, or pc:ADDR
+      char *end;
+      int at_pc = strncmp(val, "pc:", 3) == 0;
+      const char *num = at_pc ? val + 3 : val;
+      unsigned long long n = strtoull(num, &end, 0);
+      if (*num == 0 || *end != 0 || (at_pc && n >= MEM_RAM_MAX)) {
+        printf("Bad sample point: %s\n", val);
+        return -1;
+      }
+      opt->sample.at_pc = at_pc;
+      if (at_pc) opt->sample.pc = (uint32_t)n;
+      else opt->sample.at = n;
+      sample_at = 1;
+      opt->sampling = 1;
+    } else if ((val = option_value(arg, "--manifest"))) {
+      opt->manifest = val;
+      opt->batch = 1;
+    } else if ((val = option_value(arg, "--jobs"))) {
+      char *end;
+      opt->jobs = strtol(val, &end, 0);
+      if (*val == 0 || *end != 0 || opt->jobs < 0) {
+        printf("Bad job threads: %s\n", val);
+        return -1;
+      }
+    } else if (strcmp(arg, "--batch") == 0) {
+      opt->batch = 1;
+    } else if (strcmp(arg, "--hugepages") == 0) {
+      opt->sim.hugepages = 1;
+    } else if (strcmp(arg, "--no-log") == 0) {
+      opt->sim.log = TRACE_OFF;
+    } else if (strcmp(arg, "--stats") == 0) {
+      opt->stats = 1;
+    } else if (strncmp(arg, "--", 2) == 0) {
+      printf("Unknown option: %s\n", arg);
+      return -1;
+    } else {
+      opt->files[opt->num_files++] = arg;
+    }
+  }
+  if (opt->num_files > 1 && !opt->batch) {
+    printf("Only one binary can be given without --batch: %s\n", opt->files[1]);
+    return -1;
+  }
+  if (opt->restore && (opt->batch || opt->num_files)) {
+    printf("A snapshot to restore replaces the binary\n");
+    return -1;
+  }
+  if (opt->snapshot_at && opt->batch) {
+    printf("Snapshots are not saved in batch mode\n");
+    return -1;
+  }
+  // native code only runs without log: the JIT turns the default log off, and says when a log keeps it idle
+  if (opt->sim.jit && !opt->sampling) {
+    if (!log_set) opt->sim.log = TRACE_OFF;
+    else if (opt->sim.log != TRACE_OFF) fprintf(stderr, "The JIT does not run with a log, blocks are interpreted (use --log=off)\n");
+  }
+  if (opt->sampling) {
+    if (opt->batch || opt->snapshot_at || opt->sim.log == TRACE_OFF) {
+      printf("Sampling needs a log, and no batch or snapshot to save\n");
+      return -1;
+    }
+    if (opt->sample.period && opt->sample.size > opt->sample.period) {
+      printf("The samples are longer than their period\n");
+      return -1;
+    }
+    // without a start, the first sample comes after one period
+    if (!sample_at) opt->sample.at = opt->sample.period;
+  }
+  if (opt->num_files == 0 && opt->manifest == NULL && opt->restore == NULL) return -1;
+  opt->filename = opt->num_files ? opt->files[0] : NULL;
+  // native code runs on translated blocks
+  if (opt->sim.jit) opt->sim.engine = ENGINE_BLOCK;
+  return 0;
+}
+
+void options_dispose(OPTIONS *opt) {
+
+  free(opt->files);
+}
+
+void options_usage(const char *prog) {
+  printf("Requires rv32im binary [filename]\n");
+  printf("usage: %s [options] filename\n", prog);
+  printf("       %s [options] --restore-snapshot=FILE\n", prog);
+  printf("       %s --batch [options] filename... | --manifest=FILE\n", prog);
+  printf("  --engine=switch|predecode|threaded|block   execution engine (default predecode)\n");
+  printf("  --timing=off|pipeline                      count cycles with the 5-stage pipeline model (default off)\n");
+  printf("  --mul-latency=N                            cycles of MUL in EX (default %d)\n", PIPELINE_MUL_LATENCY);
+  printf("  --branch-penalty=N                         cycles lost by a taken branch or a JALR (default %d)\n", PIPELINE_BRANCH_PENALTY);
+  printf("  --jump-penalty=N                           cycles lost by a JAL (default %d)\n", PIPELINE_JUMP_PENALTY);
+  printf("  --no-forwarding                            operands read after the write-back of their producer\n");
+  printf("  --l1i=SIZE:WAYS:LINE[:lru|plru|random]     instruction cache model, SIZE in bytes with K or M\n");
+  printf("  --l1d=SIZE:WAYS:LINE[:lru|plru|random][:wb|wt]  data cache model, write-back or write-through (default lru:wb)\n");
+  printf("  --bpred=KIND[:BITS],...                    branch predictors side by side, bimodal, gshare or tage,\n");
+  printf("                                             2^BITS counters each (default 12), with a BTB and a RAS\n");
+  printf("  --btb=N                                    BTB entries, a power of two (default 512)\n");
+  printf("  --ras=N                                    return address stack entries (default 16)\n");
+  printf("  --stack-distance[=LINE]                    LRU miss ratio of every cache size and associativity in one run\n");
+  printf("                                             for the fetches and the RAM accesses (default 64-byte lines)\n");
+  printf("  --model-threads=N                          run the timing, cache and branch models on N threads\n");
+  printf("                                             beside the simulation (default 0, in the loop)\n");
+  printf("  --jit                                      compile hot blocks to x86-64 (implies block engine, and --log=off\n");
+  printf("                                             unless a log is asked for)\n");
+  printf("  --jit-threshold=N                          block executions before compiling it (default %d)\n", JIT_THRESHOLD);
+  printf("  --jit-code=SIZE[K|M]                       native code buffer, flushed when full (default 16M, at least 16K)\n");
+  printf("  --jit-check                                run native blocks against the interpreter and report differences\n");
+  printf("  --log=off|last:N|full                      log.txt with no instruction, the last N or all of them (default full)\n");
+  printf("  --log-format=text|bin                      log.txt or binary trace log.bin, see tools/trace2log (default text)\n");
+  printf("  --log-threads=N                            threads formatting log.txt (default one per CPU)\n");
+  printf("  --ram=SIZE[K|M|G]                          guest RAM in whole pages, also the initial stack pointer (default %d)\n", MEM_RAM_SIZE);
+  printf("  --brk=ADDR                                 start of the heap given by brk (default end of the binary)\n");
+  printf("  --hugepages                                back the guest RAM with transparent huge pages\n");
+  printf("  --max-insts=N                              stop after N instructions (default run to the end)\n");
+  printf("  --save-snapshot-at=N|pc:ADDR               save a snapshot after N instructions or when the PC first is ADDR\n");
+  printf("  --snapshot-file=FILE                       snapshot saved (default snapshot.snap)\n");
+  printf("  --restore-snapshot=FILE                    start from a snapshot instead of a binary\n");
+  printf("  --sample-every=P                           log a sample every P instructions, fast-forward without log between them\n");
+  printf("  --sample-at=N|pc:ADDR                      first sample after N instructions or when the PC first is ADDR\n");
+  printf("  --sample-size=W                            instructions logged by each sample (default %d)\n", SAMPLE_SIZE);
+  printf("  --batch                                    run all the binaries at once, each one logs to name.log.txt\n");
+  printf("                                             and writes its output to name.out\n");
+  printf("  --manifest=FILE                            batch of the binaries listed in FILE, one per line\n");
+  printf("  --jobs=N                                   threads of the batch (default one per CPU)\n");
+  printf("  --no-log                                   same as --log=off\n");
+  printf("  --stats                                    print engine counters to stderr\n");
+}
@@ -0,0 +1,127 @@
+#include "include/pipeline.h"
+
+/* what each OP_* does in the pipeline */
+#define PIPE_RS1      0x01      // reads rs1
+#define PIPE_RS2      0x02      // reads rs2
+#define PIPE_RD       0x04      // writes rd
+#define PIPE_LOAD     0x08      // result at the end of MEM
+#define PIPE_MUL      0x10      // holds EX for the multiply latency
+#define PIPE_BRANCH   0x20      // conditional, resolved in EX
+#define PIPE_JAL      0x40      // target known in ID
+#define PIPE_JALR     0x80      // target known in EX
+
+#define PIPE_I        (PIPE_RS1 | PIPE_RD)
+#define PIPE_R        (PIPE_RS1 | PIPE_RS2 | PIPE_RD)
+
+static const uint8_t pipeline_class[OP_COUNT] = {
+  [OP_LB] = PIPE_I | PIPE_LOAD, [OP_LH] = PIPE_I | PIPE_LOAD, [OP_LW] = PIPE_I | PIPE_LOAD,
+  [OP_LBU] = PIPE_I | PIPE_LOAD, [OP_LHU] = PIPE_I | PIPE_LOAD,
+  [OP_SB] = PIPE_RS1 | PIPE_RS2, [OP_SH] = PIPE_RS1 | PIPE_RS2, [OP_SW] = PIPE_RS1 | PIPE_RS2,
+  [OP_ADDI] = PIPE_I, [OP_XORI] = PIPE_I, [OP_ORI] = PIPE_I, [OP_ANDI] = PIPE_I,
+  [OP_ADD] = PIPE_R, [OP_MUL] = PIPE_R | PIPE_MUL, [OP_SUB] = PIPE_R,
+  [OP_XOR] = PIPE_R, [OP_OR] = PIPE_R, [OP_AND] = PIPE_R,
+  [OP_LUI] = PIPE_RD, [OP_AUIPC] = PIPE_RD,
+  [OP_JAL] = PIPE_RD | PIPE_JAL, [OP_JALR] = PIPE_I | PIPE_JALR,
+  [OP_BEQ] = PIPE_RS1 | PIPE_RS2 | PIPE_BRANCH, [OP_BNE] = PIPE_RS1 | PIPE_RS2 | PIPE_BRANCH,
+  [OP_BLT] = PIPE_RS1 | PIPE_RS2 | PIPE_BRANCH, [OP_BGE] = PIPE_RS1 | PIPE_RS2 | PIPE_BRANCH,
+  [OP_BLTU] = PIPE_RS1 | PIPE_RS2 | PIPE_BRANCH, [OP_BGEU] = PIPE_RS1 | PIPE_RS2 | PIPE_BRANCH,
+};
+
+
+void pipeline_config_default(PIPELINE_CONFIG *config) {
+
+  config->forwarding = 1;
+  config->mul_latency = PIPELINE_MUL_LATENCY;
+  config->branch_penalty = PIPELINE_BRANCH_PENALTY;
+  config->jump_penalty = PIPELINE_JUMP_PENALTY;
+}
+
+
+static void pipeline_retire(TIMING *timing, const TIMING_EVENT *ev) {
+  PIPELINE *pipe = (PIPELINE *)timing;
+  const PIPELINE_CONFIG *c = &pipe->config;
+  const DECODED *d = ev->dec;
+  uint8_t f = pipeline_class[d->op];
+  uint64_t id = pipe->next;
+
+  /* ID waits for the source registers, x0 is always ready */
+  uint64_t need = 0;
+  if ((f & PIPE_RS1) && pipe->ready[d->rs1] > need) need = pipe->ready[d->rs1];
+  if ((f & PIPE_RS2) && pipe->ready[d->rs2] > need) need = pipe->ready[d->rs2];
+  if (need > id) {
+    // with forwarding only a load result comes late
+    if (c->forwarding) pipe->load_use += need - id;
+    else pipe->data += need - id;
+    id = need;
+  }
+
+  /* when the result can be read */
+  if ((f & PIPE_RD) && d->rd) {
+    uint64_t ready;
+    if (!c->forwarding) ready = id + 3 + (f & PIPE_MUL ? c->mul_latency - 1 : 0);
+    else if (f & PIPE_LOAD) ready = id + 2;
+    else if (f & PIPE_MUL) ready = id + c->mul_latency;
+    else ready = id + 1;
+    pipe->ready[d->rd] = ready;
+  }
+
+  /* the next instruction, behind the multiplier or the fetches flushed */
+  uint64_t next = id + 1;
+  if (f & PIPE_MUL) {
+    next = id + c->mul_latency;
+    pipe->mul += c->mul_latency - 1;
+  }
+  if (f & PIPE_BRANCH) {
+    pipe->branches++;
+    if (ev->next_pc != ev->pc + 4) {
+      pipe->taken++;
+      pipe->flushed += c->branch_penalty;
+      next += c->branch_penalty;
+    }
+  } else if (f & (PIPE_JAL | PIPE_JALR)) {
+    uint32_t penalty = f & PIPE_JAL ? c->jump_penalty : c->branch_penalty;
+    pipe->jumps++;
+    pipe->flushed += penalty;
+    next += penalty;
+  }
+  pipe->next = next;
+  // the last instruction leaves WB three cycles after ID
+  timing->cycles = id + 4;
+}
+
+
+static void pipeline_stats(TIMING *timing, FILE *out) {
+  PIPELINE *pipe = (PIPELINE *)timing;
+
+  fprintf(out, "pipeline:            forwarding %s, MUL %u cycles, branch penalty %u, jump penalty %u\n",
+          pipe->config.forwarding ? "on" : "off", pipe->config.mul_latency,
+          pipe->config.branch_penalty, pipe->config.jump_penalty);
+  fprintf(out, "load-use stalls:     %llu cycles\n", (unsigned long long)pipe->load_use);
+  if (!pipe->config.forwarding) fprintf(out, "data stalls:         %llu cycles\n", (unsigned long long)pipe->data);
+  fprintf(out, "multiply stalls:     %llu cycles\n", (unsigned long long)pipe->mul);
+  fprintf(out, "branches:            %llu, %llu taken (%.2f%%), %llu jumps, %llu cycles flushed\n",
+          (unsigned long long)pipe->branches, (unsigned long long)pipe->taken,
+          pipe->branches ? 100.0 * pipe->taken / pipe->branches : 0.0,
+          (unsigned long long)pipe->jumps, (unsigned long long)pipe->flushed);
+}
+
+
+void pipeline_dispose(TIMING *timing) {
+
+  free((PIPELINE *)timing);
+}
+
+
+int pipeline_create(PIPELINE *pipe, const PIPELINE_CONFIG *config) {
+
+  if (pipe == NULL || config == NULL || config->mul_latency == 0) return -1;
+  memset(pipe, 0, sizeof(PIPELINE));
+  pipe->config = *config;
+  pipe->timing.name = "5-stage pipeline";
+  pipe->timing.retire = pipeline_retire;
+  pipe->timing.stats = pipeline_stats;
+  pipe->timing.dispose = pipeline_dispose;
+  // the first instruction is fetched in cycle 0
+  pipe->next = 1;
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include "include/predecode.h"
+
+static void predecode_label_page(PREDECODE *pd, DECODED *page, int num);
+
+
+int predecode_create(PREDECODE *pd, uint8_t *ram, uint32_t limit) {
+
+  if (pd == NULL) return -1;
+
+  pd->num_pages = (limit + (1 << PREDECODE_PAGE_BITS) - 1) >> PREDECODE_PAGE_BITS;
+  pd->pages = (DECODED **)calloc(pd->num_pages ? pd->num_pages : 1, sizeof(DECODED *));
+  if (pd->pages == NULL) return -2;
+
+  pd->limit = limit;
+  pd->ram = ram;
+  pd->labels = NULL;
+  memset(pd->scratch, 0, sizeof(pd->scratch));
+  pd->scratch[1].op = OP_LOOKUP;
+  return 0;
+}
+
+
+DECODED *predecode_fill(PREDECODE *pd, uint32_t pc) {
+  DECODED *dec = &pd->scratch[0];
+
+  if (pc < pd->limit && (pc & 3) == 0) {
+    DECODED **page = &pd->pages[pc >> PREDECODE_PAGE_BITS];
+    if (*page == NULL) {
+      // entries start zeroed: op == OP_FILL and exec == NULL, not decoded yet
+      DECODED *pg = (DECODED *)calloc(PREDECODE_PAGE_INSTS + 1, sizeof(DECODED));
+      if (pg != NULL) {
+        pg[PREDECODE_PAGE_INSTS].op = OP_LOOKUP;
+        predecode_label_page(pd, pg, PREDECODE_PAGE_INSTS + 1);
+        *page = pg;
+      }
+    }
+    if (*page != NULL) dec = &(*page)[(pc >> 2) & (PREDECODE_PAGE_INSTS - 1)];
+  }
+  core_predecode(ram_load(pd->ram, pc, 32), dec);
+  if (pd->labels) dec->label = pd->labels[dec->op];
+  return dec;
+}
+
+
+void predecode_set_labels(PREDECODE *pd, const void *const *labels) {
+
+  pd->labels = labels;
+  predecode_label_page(pd, pd->scratch, 2);
+  for (uint32_t i = 0; i < pd->num_pages; i++)
+    if (pd->pages[i]) predecode_label_page(pd, pd->pages[i], PREDECODE_PAGE_INSTS + 1);
+}
+
+
+void predecode_invalidate(PREDECODE *pd, uint32_t addr, uint8_t size) {
+  uint32_t first = addr & ~3u;
+  uint32_t last = addr + (size >> 3) - 1;
+
+  for (uint32_t a = first; a <= last && a < pd->limit; a += 4) {
+    DECODED *page = pd->pages[a >> PREDECODE_PAGE_BITS];
+    if (page) {
+      DECODED *dec = &page[(a >> 2) & (PREDECODE_PAGE_INSTS - 1)];
+      dec->exec = NULL;
+      dec->op = OP_FILL;
+      if (pd->labels) dec->label = pd->labels[OP_FILL];
+    }
+  }
+}
+
+
+void predecode_dispose(PREDECODE *pd) {
+
+  for (uint32_t i = 0; i < pd->num_pages; i++) free(pd->pages[i]);
+  free(pd->pages);
+  free(pd);
+}
+
+
+static void predecode_label_page(PREDECODE *pd, DECODED *page, int num) {
+
+  if (pd->labels == NULL) return;
+  for (int i = 0; i < num; i++) page[i].label = pd->labels[page[i].op];
+}
@@ -0,0 +1,133 @@
+#include "include/retire.h"
+#include <sched.h>
+#include <time.h>
+
+static void *retire_thread(void *arg);
+
+
+int retire_create(RETIRE *retire, int threads, const uint32_t *models, RETIRE_FN fn, void *ctx) {
+
+  if (retire == NULL) return -1;
+  memset(retire, 0, sizeof(RETIRE));
+  atomic_init(&retire->done, 0);
+  if (threads < 1 || threads > RETIRE_THREADS || models == NULL || fn == NULL) return -1;
+
+  retire->fn = fn;
+  retire->ctx = ctx;
+  for (int i = 0; i < threads; i++) {
+    RETIRE_WORKER *w = &retire->workers[i];
+    w->retire = retire;
+    w->models = models[i];
+    w->ring = (RINGBUFFER_REC *)malloc(sizeof(RINGBUFFER_REC));
+    if (w->ring == NULL) return -2;
+    if (ringbuffer_rec_create(w->ring, sizeof(RETIRE_BLOCK), RETIRE_BLOCKS) != 0) {
+      free(w->ring);
+      w->ring = NULL;
+      return -2;
+    }
+    w->decoded = (RETIRE_DECODED_ENTRY *)malloc(RETIRE_DECODED * sizeof(RETIRE_DECODED_ENTRY));
+    if (w->decoded == NULL) return -2;
+    for (int j = 0; j < RETIRE_DECODED; j++) w->decoded[j].pc = 1;
+  }
+  for (int i = 0; i < threads; i++) {
+    if (pthread_create(&retire->workers[i].thread, NULL, retire_thread, &retire->workers[i]) != 0) return -4;
+    retire->num_threads++;
+  }
+  return 0;
+}
+
+
+void retire_flush(RETIRE *retire) {
+
+  if (retire->block.count == 0) return;
+  for (int i = 0; i < retire->num_threads; i++) {
+    RINGBUFFER_REC *ring = retire->workers[i].ring;
+    RETIRE_BLOCK *block;
+    if ((block = (RETIRE_BLOCK *)ringbuffer_rec_reserve(ring)) == NULL) {
+      // the thread is behind, wait for it to free a block
+      retire->stalls++;
+      while ((block = (RETIRE_BLOCK *)ringbuffer_rec_reserve(ring)) == NULL) sched_yield();
+    }
+    memcpy(block, &retire->block, sizeof(uint32_t) + retire->block.count * sizeof(RETIRE_REC));
+    ringbuffer_rec_commit(ring);
+  }
+  retire->blocks++;
+  retire->block.count = 0;
+}
+
+
+void retire_sync(RETIRE *retire) {
+
+  retire_flush(retire);
+  for (int i = 0; i < retire->num_threads; i++) {
+    // a block is consumed once its records went to the models
+    if (ringbuffer_rec_fill(retire->workers[i].ring) == 0) continue;
+    retire->syncs++;
+    while (ringbuffer_rec_fill(retire->workers[i].ring)) sched_yield();
+  }
+}
+
+
+void retire_stats(RETIRE *retire, FILE *out) {
+
+  fprintf(out, "model threads:       %d, %llu blocks of up to %u records, %llu stalls, %llu waits\n",
+          retire->num_threads, (unsigned long long)retire->blocks, RETIRE_BLOCK_RECS,
+          (unsigned long long)retire->stalls, (unsigned long long)retire->syncs);
+  for (int i = 0; i < retire->num_threads; i++)
+    fprintf(out, "model thread %d:      %llu records, idle %llu times\n", i,
+            (unsigned long long)atomic_load(&retire->workers[i].records),
+            (unsigned long long)atomic_load(&retire->workers[i].idle));
+}
+
+
+void retire_dispose(RETIRE *retire) {
+
+  retire_flush(retire);
+  atomic_store_explicit(&retire->done, 1, memory_order_release);
+  for (int i = 0; i < retire->num_threads; i++) pthread_join(retire->workers[i].thread, NULL);
+  for (int i = 0; i < RETIRE_THREADS; i++) {
+    if (retire->workers[i].ring) ringbuffer_rec_dispose(retire->workers[i].ring);
+    free(retire->workers[i].decoded);
+  }
+  free(retire);
+}
+
+
+/* the instruction word decoded again, once per PC while it does not change */
+static inline const DECODED *retire_decode(RETIRE_WORKER *w, uint32_t pc, uint32_t raw) {
+  RETIRE_DECODED_ENTRY *e = &w->decoded[(pc >> 2) & (RETIRE_DECODED - 1)];
+
+  if (e->pc != pc || e->dec.raw != raw) {
+    core_predecode(raw, &e->dec);
+    e->pc = pc;
+  }
+  return &e->dec;
+}
+
+
+static void *retire_thread(void *arg) {
+  RETIRE_WORKER *w = (RETIRE_WORKER *)arg;
+  RETIRE *retire = w->retire;
+  struct timespec nap = {0, RETIRE_SLEEP * 1000};
+
+  while (1) {
+    const RETIRE_BLOCK *block = (const RETIRE_BLOCK *)ringbuffer_rec_peek(w->ring);
+    if (block) {
+      for (uint32_t i = 0; i < block->count; i++) {
+        const RETIRE_REC *rec = &block->recs[i];
+        retire->fn(retire->ctx, w->models, retire_decode(w, rec->pc, rec->raw), rec);
+      }
+      atomic_fetch_add_explicit(&w->records, block->count, memory_order_relaxed);
+      ringbuffer_rec_consume(w->ring);
+      continue;
+    }
+    // done is set after the last commit, so an empty ring after it is final
+    if (atomic_load_explicit(&retire->done, memory_order_acquire)) {
+      if (ringbuffer_rec_fill(w->ring) == 0) break;
+      continue;
+    }
+    atomic_fetch_add_explicit(&w->idle, 1, memory_order_relaxed);
+    nanosleep(&nap, NULL);
+  }
+  return NULL;
+}
@@ -0,0 +1,221 @@
+#include "include/reuse.h"
+
+#define REUSE_LINES_INIT    1024        // entries of the line table at first
+#define REUSE_MAX_BITS      (REUSE_SET_BITS + 6)  // largest cache in the statistics, 2^20 lines
+
+
+static inline uint32_t reuse_hash(uint32_t line, uint32_t mask) {
+  return line * 2654435761u & mask;
+}
+
+
+/* Fenwick tree: add to the time, sum of the times 1 to time */
+static inline void reuse_add(REUSE *reuse, uint32_t time, int32_t value) {
+  for (; time <= reuse->max_time; time += time & -time) reuse->tree[time] += value;
+}
+
+static inline uint32_t reuse_sum(REUSE *reuse, uint32_t time) {
+  uint32_t sum = 0;
+  for (; time; time -= time & -time) sum += reuse->tree[time];
+  return sum;
+}
+
+
+/* renumber the last accesses 1 to the lines seen, in order, and build the tree again */
+static void reuse_compact(REUSE *reuse) {
+  uint32_t n = 0;
+
+  for (uint32_t t = 1; t < reuse->now; t++) {
+    REUSE_LINE *e = &reuse->lines[reuse->owner[t]];
+    if (e->line == REUSE_EMPTY || e->time != t) continue;
+    e->time = ++n;
+    reuse->owner[n] = reuse->owner[t];
+  }
+  memset(reuse->tree, 0, (reuse->max_time + 1) * sizeof(uint32_t));
+  for (uint32_t t = 1; t <= reuse->max_time; t++) {
+    if (t <= n) reuse->tree[t]++;
+    uint32_t up = t + (t & -t);
+    if (up <= reuse->max_time) reuse->tree[up] += reuse->tree[t];
+  }
+  reuse->now = n + 1;
+}
+
+
+/* twice the entries, and twice the times: the lines seen fill at most a quarter of them */
+static int reuse_grow(REUSE *reuse) {
+  uint32_t max_lines = 2 * reuse->max_lines, max_time = 2 * max_lines;
+  REUSE_LINE *lines = (REUSE_LINE *)malloc(max_lines * sizeof(REUSE_LINE));
+  uint32_t *tree = (uint32_t *)malloc((max_time + 1) * sizeof(uint32_t));
+  uint32_t *owner = (uint32_t *)calloc(max_time + 1, sizeof(uint32_t));
+
+  if (lines == NULL || tree == NULL || owner == NULL) {
+    free(lines);
+    free(tree);
+    free(owner);
+    return -2;
+  }
+  memset(lines, 0xFF, max_lines * sizeof(REUSE_LINE));
+  for (uint32_t i = 0; i < max_lines; i++) lines[i].time = 0;
+  // the times of the lines are kept, compacted below
+  for (uint32_t i = 0; i < reuse->max_lines; i++) {
+    REUSE_LINE *e = &reuse->lines[i];
+    if (e->line == REUSE_EMPTY) continue;
+    uint32_t h = reuse_hash(e->line, max_lines - 1);
+    while (lines[h].line != REUSE_EMPTY) h = (h + 1) & (max_lines - 1);
+    lines[h] = *e;
+    if (e->time) owner[e->time] = h;
+  }
+  free(reuse->lines);
+  free(reuse->tree);
+  free(reuse->owner);
+  reuse->lines = lines;
+  reuse->tree = tree;
+  reuse->owner = owner;
+  reuse->max_lines = max_lines;
+  reuse->max_time = max_time;
+  reuse_compact(reuse);
+  return 0;
+}
+
+
+int reuse_create(REUSE *reuse, const char *name, uint32_t line) {
+
+  if (reuse == NULL) return -1;
+  memset(reuse, 0, sizeof(REUSE));
+  if (line < 4 || line > 4096 || (line & (line - 1))) return -1;
+
+  reuse->name = name;
+  reuse->line = line;
+  while ((1u << reuse->line_bits) < line) reuse->line_bits++;
+  reuse->max_lines = REUSE_LINES_INIT;
+  reuse->max_time = 2 * REUSE_LINES_INIT;
+  reuse->now = 1;
+  reuse->last = REUSE_EMPTY;
+  reuse->lines = (REUSE_LINE *)malloc(reuse->max_lines * sizeof(REUSE_LINE));
+  reuse->tree = (uint32_t *)calloc(reuse->max_time + 1, sizeof(uint32_t));
+  reuse->owner = (uint32_t *)calloc(reuse->max_time + 1, sizeof(uint32_t));
+  if (reuse->lines == NULL || reuse->tree == NULL || reuse->owner == NULL) return -2;
+  memset(reuse->lines, 0xFF, reuse->max_lines * sizeof(REUSE_LINE));
+  for (uint32_t i = 0; i < reuse->max_lines; i++) reuse->lines[i].time = 0;
+  for (int b = 0; b <= REUSE_SET_BITS; b++) {
+    reuse->stacks[b] = (uint32_t *)malloc(((size_t)REUSE_MAX_WAYS << b) * sizeof(uint32_t));
+    reuse->depth[b] = (uint8_t *)calloc((size_t)1 << b, 1);
+    if (reuse->stacks[b] == NULL || reuse->depth[b] == NULL) return -2;
+  }
+  return 0;
+}
+
+
+void reuse_access(REUSE *reuse, uint32_t addr) {
+  uint32_t line = addr >> reuse->line_bits;
+
+  // on top of all the stacks already, most of the fetches
+  if (line == reuse->last) {
+    reuse->accesses++;
+    reuse->repeats++;
+    return;
+  }
+
+  /* the entry of the line, a new one on the first access */
+  if (2 * (reuse->num_lines + 1) > reuse->max_lines && reuse_grow(reuse) != 0 &&
+      reuse->num_lines + 1 >= reuse->max_lines) return;
+  uint32_t mask = reuse->max_lines - 1;
+  uint32_t h = reuse_hash(line, mask);
+  while (reuse->lines[h].line != line && reuse->lines[h].line != REUSE_EMPTY) h = (h + 1) & mask;
+  REUSE_LINE *e = &reuse->lines[h];
+  if (e->line == REUSE_EMPTY) {
+    e->line = line;
+    reuse->num_lines++;
+  }
+  if (reuse->now > reuse->max_time) reuse_compact(reuse);
+  reuse->accesses++;
+  reuse->last = line;
+
+  /* fully associative: the lines accessed after it are the 1s after its time */
+  // entries searched in the set stacks, none for a line never seen
+  uint32_t limit = 0;
+  if (e->time) {
+    uint32_t dist = reuse->num_lines - reuse_sum(reuse, e->time);
+    reuse->full[dist ? 32 - __builtin_clz(dist) : 0]++;
+    reuse_add(reuse, e->time, -1);
+    limit = dist < REUSE_MAX_WAYS ? dist + 1 : REUSE_MAX_WAYS;
+  }
+  e->time = reuse->now++;
+  reuse->owner[e->time] = h;
+  reuse_add(reuse, e->time, 1);
+
+  /* set stacks: a set of 2^(b+1) sets holds part of the lines of its set of 2^b sets, */
+  /* so the line is no deeper there than it was in the stack before */
+  for (int b = 0; b <= REUSE_SET_BITS; b++) {
+    uint32_t set = line & ((1u << b) - 1);
+    uint32_t *stack = reuse->stacks[b] + (size_t)set * REUSE_MAX_WAYS;
+    uint32_t depth = reuse->depth[b][set];
+    uint32_t n = limit < depth ? limit : depth;
+    uint32_t p = 0;
+    while (p < n && stack[p] != line) p++;
+    if (p < n) {
+      reuse->sets[b][p]++;
+      limit = p + 1;
+    } else {
+      if (depth < REUSE_MAX_WAYS) reuse->depth[b][set]++;
+      p = depth < REUSE_MAX_WAYS ? depth : REUSE_MAX_WAYS - 1;
+      limit = limit ? REUSE_MAX_WAYS : 0;
+    }
+    memmove(stack + 1, stack, p * sizeof(uint32_t));
+    stack[0] = line;
+  }
+}
+
+
+/* size of 2^bits lines, with K or M */
+static const char *reuse_size(char *buf, uint64_t bytes) {
+  if (bytes >= (1u << 20)) sprintf(buf, "%lluM", (unsigned long long)(bytes >> 20));
+  else if (bytes >= (1u << 10)) sprintf(buf, "%lluK", (unsigned long long)(bytes >> 10));
+  else sprintf(buf, "%llu", (unsigned long long)bytes);
+  return buf;
+}
+
+
+void reuse_stats(REUSE *reuse, FILE *out) {
+  char buf[32];
+
+  fprintf(out, "%-4s stack distance:  %llu accesses, %u lines of %u bytes, LRU miss ratio (%%) by size and ways:\n",
+          reuse->name, (unsigned long long)reuse->accesses, reuse->num_lines, reuse->line);
+  if (reuse->accesses == 0) return;
+  fprintf(out, "%-4s %9s", reuse->name, "size");
+  for (uint32_t ways = 1; ways <= REUSE_MAX_WAYS; ways *= 2) fprintf(out, " %7u-way", ways);
+  fprintf(out, " %11s\n", "full");
+
+  uint64_t full_hits = reuse->repeats;
+  for (int k = 0; ; k++) {
+    fprintf(out, "%-4s %9s", reuse->name, reuse_size(buf, (uint64_t)reuse->line << k));
+    // distances below 2^k lines hit
+    full_hits += reuse->full[k];
+    for (int w = 0; (1u << w) <= REUSE_MAX_WAYS; w++) {
+      int b = k - w;
+      if (b < 0 || b > REUSE_SET_BITS) {
+        fprintf(out, " %11s", "-");
+        continue;
+      }
+      uint64_t hits = reuse->repeats;
+      for (uint32_t p = 0; p < (1u << w); p++) hits += reuse->sets[b][p];
+      fprintf(out, " %11.3f", 100.0 * (reuse->accesses - hits) / reuse->accesses);
+    }
+    fprintf(out, " %11.3f\n", 100.0 * (reuse->accesses - full_hits) / reuse->accesses);
+    // up to the first cache holding all the lines
+    if ((1ull << k) >= reuse->num_lines || k == REUSE_MAX_BITS) break;
+  }
+}
+
+
+void reuse_dispose(REUSE *reuse) {
+
+  free(reuse->lines);
+  free(reuse->tree);
+  free(reuse->owner);
+  for (int b = 0; b <= REUSE_SET_BITS; b++) {
+    free(reuse->stacks[b]);
+    free(reuse->depth[b]);
+  }
+  free(reuse);
+}
@@ -43,7 +43,7 @@ int ringbuffer_put(RINGBUFFER_TYPE *p_ringbuffer, void *p_src, unsigned int offs
 	if((p_ringbuffer->size - p_ringbuffer->fill) < lenght) return ERROR_BUF_NO_SPACE;
 	
 	end_size = (p_ringbuffer->size - p_ringbuffer->write_pos);
-	actual_posit = (unsigned char *) (((unsigned int) p_ringbuffer->memory) + p_ringbuffer->write_pos);
+	actual_posit = p_ringbuffer->memory + p_ringbuffer->write_pos;
 	
 	if(lenght > end_size)
 	{
@@ -76,18 +76,18 @@ int ringbuffer_get(RINGBUFFER_TYPE *p_ringbuffer, void *p_dst, unsigned int offs
 	if(lenght > p_ringbuffer->fill) return ERROR_NOT_ENOUGHT;
 	
 	end_size = (p_ringbuffer->size - p_ringbuffer->read_pos);
-	actual_posit = (unsigned char *) (((unsigned int) p_ringbuffer->memory) + p_ringbuffer->read_pos);
+	actual_posit = p_ringbuffer->memory + p_ringbuffer->read_pos;
 	
 	if(lenght > end_size)
 	{
-		memcpy((const void *) (dst + offset), actual_posit, end_size);
+		memcpy((void *) (dst + offset), actual_posit, end_size);
 		remain_data =  lenght - end_size;
-		memcpy((const void *) (dst + offset + end_size), p_ringbuffer->memory, remain_data);
+		memcpy((void *) (dst + offset + end_size), p_ringbuffer->memory, remain_data);
 		p_ringbuffer->read_pos = remain_data;
 	}
 	else
 	{
-		memcpy((const void *) (dst + offset), actual_posit, lenght);
+		memcpy((void *) (dst + offset), actual_posit, lenght);
 		p_ringbuffer->read_pos += lenght;
 	}
 	p_ringbuffer->fill -= lenght;
@@ -100,3 +100,33 @@ void ringbuffer_dispose(RINGBUFFER_TYPE *p_ringbuffer) {
 	free(p_ringbuffer->memory);
 	free(p_ringbuffer);
 }
+
+
+int ringbuffer_rec_create(RINGBUFFER_REC *p_ringbuffer, uint32_t rec_size, uint32_t count) {
+	uint32_t slots = 1;
+	
+	if (p_ringbuffer == NULL) return ERROR_RING_ALLOC;
+	// more than 2^31 records can not be rounded up to a power of two
+	if (count == 0 || count > 0x80000000u || rec_size == 0) return ERROR_BAD_COUNT;
+	
+	while (slots < count) slots <<= 1;
+	p_ringbuffer->memory = (unsigned char *) malloc((size_t) slots * rec_size);
+	if (p_ringbuffer->memory == NULL) return ERROR_BUF_ALLOC;
+	
+	p_ringbuffer->rec_size = rec_size;
+	p_ringbuffer->mask = slots - 1;
+	p_ringbuffer->limit = count;
+	atomic_init(&p_ringbuffer->head, 0);
+	atomic_init(&p_ringbuffer->tail, 0);
+	p_ringbuffer->tail_cache = 0;
+	p_ringbuffer->head_cache = 0;
+	
+	return 0; 
+}
+
+
+void ringbuffer_rec_dispose(RINGBUFFER_REC *p_ringbuffer) {
+	
+	free(p_ringbuffer->memory);
+	free(p_ringbuffer);
+}
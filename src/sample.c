@@ -0,0 +1,83 @@
+#include "include/sample.h"
+#include <time.h>
+
+static uint64_t sample_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+int sample_create(SAMPLER *sampler, const SAMPLE_CONFIG *config) {
+
+  if (sampler == NULL || config == NULL) return -1;
+  if (config->size == 0 || (config->period && config->size > config->period)) return -1;
+  memset(sampler, 0, sizeof(SAMPLER));
+  sampler->config = *config;
+  return 0;
+}
+
+
+/* run at most n instructions, with or without log, counted in the sampler */
+static SIM_STATUS sample_span(SAMPLER *sampler, SIM *sim, uint64_t n, int log) {
+  uint64_t start = sample_now_ns(), insts = sim->insts;
+
+  sim_set_log(sim, log);
+  SIM_STATUS status = sim_run(sim, n);
+  if (log) {
+    sampler->log_insts += sim->insts - insts;
+    sampler->log_ns += sample_now_ns() - start;
+  } else {
+    sampler->ff_insts += sim->insts - insts;
+    sampler->ff_ns += sample_now_ns() - start;
+  }
+  return status;
+}
+
+
+SIM_STATUS sample_run(SAMPLER *sampler, SIM *sim, uint64_t max_insts) {
+  const SAMPLE_CONFIG *c = &sampler->config;
+  uint64_t end = max_insts > UINT64_MAX - sim->insts ? UINT64_MAX : sim->insts + max_insts;
+  SIM_STATUS status = SIM_RUNNING;
+  uint64_t next;
+
+  /* Fast-forward to the first sample */
+  if (c->at_pc) {
+    uint64_t start = sample_now_ns(), insts = sim->insts;
+    sim_set_log(sim, 0);
+    status = sim_run_until(sim, c->pc, end - sim->insts);
+    sampler->ff_insts += sim->insts - insts;
+    sampler->ff_ns += sample_now_ns() - start;
+    next = sim_get_pc(sim) == c->pc ? sim->insts : end;
+  } else {
+    next = c->at < end ? c->at : end;
+    if (sim->insts < next) status = sample_span(sampler, sim, next - sim->insts, 0);
+  }
+
+  /* A window with log at each sample, fast-forward to the next one */
+  while (status == SIM_RUNNING && sim->insts < end && sim->insts == next) {
+    sim_mark_log(sim, sampler->samples++);
+    status = sample_span(sampler, sim, c->size < end - sim->insts ? c->size : end - sim->insts, 1);
+    if (c->period == 0) break;
+    next = next + c->period < end ? next + c->period : end;
+    if (status == SIM_RUNNING && sim->insts < next) status = sample_span(sampler, sim, next - sim->insts, 0);
+  }
+
+  /* The rest of the program without log */
+  if (status == SIM_RUNNING && sim->insts < end) status = sample_span(sampler, sim, end - sim->insts, 0);
+  sim_set_log(sim, 1);
+  return status;
+}
+
+
+void sample_stats(SAMPLER *sampler, FILE *out) {
+
+  fprintf(out, "samples:             %u of %llu instructions\n", sampler->samples,
+          (unsigned long long)sampler->config.size);
+  fprintf(out, "sampled:             %llu instructions, %.3f ms, %.2f MIPS\n",
+          (unsigned long long)sampler->log_insts, sampler->log_ns / 1e6,
+          sampler->log_ns ? sampler->log_insts * 1e3 / sampler->log_ns : 0.0);
+  fprintf(out, "fast-forward:        %llu instructions, %.3f ms, %.2f MIPS\n",
+          (unsigned long long)sampler->ff_insts, sampler->ff_ns / 1e6,
+          sampler->ff_ns ? sampler->ff_insts * 1e3 / sampler->ff_ns : 0.0);
+}
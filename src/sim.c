@@ -0,0 +1,574 @@
+#include "include/sim.h"
+#include "include/block.h"
+#include "include/bus.h"
+#include "include/cache.h"
+#include "include/jit.h"
+#include "include/predecode.h"
+#include "include/snapshot.h"
+#include "include/sys.h"
+#include "include/threaded.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+void sim_config_default(SIM_CONFIG *config) {
+
+  memset(config, 0, sizeof(SIM_CONFIG));
+  config->engine = ENGINE_PREDECODE;
+  config->log = TRACE_OFF;
+  config->log_format = TRACE_TEXT;
+  config->jit_threshold = JIT_THRESHOLD;
+  config->jit_code_size = JIT_CODE_SIZE;
+  config->ram_size = MEM_RAM_SIZE;
+  pipeline_config_default(&config->pipeline);
+  config->bpred.btb = BPRED_BTB_ENTRIES;
+  config->bpred.ras = BPRED_RAS_DEPTH;
+}
+
+
+int sim_create(SIM *sim, const SIM_CONFIG *config) {
+
+  if (sim == NULL || config == NULL) return -1;
+  memset(sim, 0, sizeof(SIM));
+  sim->config = *config;
+  sim->status = SIM_RUNNING;
+  sim->out_fd = -1;
+  sim->logging = 1;
+
+  /* Guest RAM committed as it is touched, the image is loaded at address 0 */
+  sim->ram = (RAM *)malloc(sizeof(RAM));
+  if (sim->ram == NULL) return -2;
+  if (ram_create(sim->ram, config->ram_size, config->hugepages) != 0) {
+    free(sim->ram);
+    sim->ram = NULL;
+    return -2;
+  }
+
+  /* Allocate CORE struct and its resources*/
+  /* reference: https://en.wikichip.org/wiki/risc-v/registers*/
+  CORE *core = (CORE *)calloc(1, sizeof(CORE));
+  if (core == NULL) return -2;
+  sim->core = core;
+  core->regs[2] = (uint32_t)sim->ram->size; // top of the RAM, 0 wraps to the end of a 4 GB RAM
+  core->pc = 0x0;
+  core->ram = sim->ram->base;
+
+  /* Devices above the RAM, RAM accesses below ram_limit skip the bus */
+  if (config->out_path) {
+    sim->out_fd = open(config->out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (sim->out_fd < 0) return -3;
+  }
+  core->bus = (BUS *)malloc(sizeof(BUS));
+  if (core->bus == NULL) return -2;
+  if (bus_create(core->bus, sim->out_fd >= 0 ? sim->out_fd : STDOUT_FILENO) != 0) {
+    free(core->bus);
+    core->bus = NULL;
+    return -2;
+  }
+  core->ram_limit = sim->ram->size < BUS_BASE ? (uint32_t)sim->ram->size : BUS_BASE;
+
+  /* Timing model fed by the retired instructions */
+  if (config->timing == TIMING_PIPELINE) {
+    PIPELINE *pipe = (PIPELINE *)malloc(sizeof(PIPELINE));
+    if (pipe == NULL) return -2;
+    if (pipeline_create(pipe, &config->pipeline) != 0) {
+      free(pipe);
+      return -1;
+    }
+    sim->timing = &pipe->timing;
+  }
+
+  /* Cache models fed by the fetches and the RAM accesses */
+  const CACHE_CONFIG *caches[2] = {&config->l1i, &config->l1d};
+  for (int i = 0; i < 2; i++) {
+    if (caches[i]->size == 0) continue;
+    CACHE *cache = (CACHE *)malloc(sizeof(CACHE));
+    if (cache == NULL) return -2;
+    if (i == 0) sim->l1i = cache;
+    else sim->l1d = cache;
+    int err = cache_create(cache, i == 0 ? "L1I" : "L1D", caches[i]);
+    if (err != 0) return err;
+  }
+
+  /* Branch predictors fed by the control transfers */
+  if (config->bpred.num) {
+    sim->bpred = (BPRED *)malloc(sizeof(BPRED));
+    if (sim->bpred == NULL) return -2;
+    int err = bpred_create(sim->bpred, &config->bpred);
+    if (err != 0) return err;
+  }
+
+  /* Stack distance analysis of the same accesses */
+  if (config->reuse_line) {
+    for (int i = 0; i < 2; i++) {
+      REUSE *reuse = (REUSE *)malloc(sizeof(REUSE));
+      if (reuse == NULL) return -2;
+      if (i == 0) sim->reuse_i = reuse;
+      else sim->reuse_d = reuse;
+      int err = reuse_create(reuse, i == 0 ? "I" : "D", config->reuse_line);
+      if (err != 0) return err;
+    }
+  }
+
+  /* Allocate LOG struct and the trace ringbuffer, none with TRACE_OFF */
+  if (config->log != TRACE_OFF) {
+    const char *log_path = config->log_path ? config->log_path :
+                           config->log_format == TRACE_BIN ? "log.bin" : "log.txt";
+    sim->trace = (TRACE *)malloc(sizeof(TRACE));
+    if (sim->trace == NULL) return -2;
+    if (trace_create(sim->trace, config->log, config->log_last, config->log_format,
+                     config->log_threads, log_path) != 0) {
+      free(sim->trace);
+      sim->trace = NULL;
+      return -3;
+    }
+  }
+  return 0;
+}
+
+
+/* caches over the code and the system calls, once the image is in the RAM */
+static int sim_setup_code(SIM *sim) {
+  CORE *core = sim->core;
+  uint32_t image = (uint32_t)sim->ram->image;
+
+  /* Predecode cache over the loaded code, filled as instructions execute */
+  core->pd = (PREDECODE *)malloc(sizeof(PREDECODE));
+  if (core->pd == NULL) return -2;
+  predecode_create(core->pd, core->ram, image);
+  core->code_limit = core->pd->limit;
+
+  /* System calls of ECALL, the heap starts after the image unless brk moves it */
+  core->sys = (SYS *)malloc(sizeof(SYS));
+  if (core->sys == NULL) return -2;
+  sys_create(core->sys, core->ram, core->ram_limit, sim->config.brk ? sim->config.brk : image, &core->bus->uart);
+
+  /* Block cache translated from the predecode cache, for the block engine */
+  if (sim->config.engine == ENGINE_BLOCK) {
+    core->bc = (BLOCK_CACHE *)malloc(sizeof(BLOCK_CACHE));
+    if (core->bc == NULL) return -2;
+    block_create(core->bc, core->pd);
+    if (sim->config.jit) {
+      core->bc->jit = (JIT *)malloc(sizeof(JIT));
+      if (core->bc->jit == NULL) return -2;
+      if (jit_create(core->bc->jit, image, core->ram_limit, sim->config.jit_threshold,
+                     sim->config.jit_code_size, sim->config.jit_check) != 0) {
+        fprintf(stderr, "JIT not available on this host, blocks are interpreted\n");
+        jit_dispose(core->bc->jit);
+        core->bc->jit = NULL;
+      }
+    }
+  }
+  return 0;
+}
+
+
+int sim_load_image(SIM *sim, const void *buf, size_t len) {
+
+  if (sim->core->pd) return -1;
+  int err = ram_copy_image(sim->ram, buf, len);
+  if (err != 0) return err;
+  return sim_setup_code(sim);
+}
+
+
+int sim_load_file(SIM *sim, const char *path) {
+
+  if (sim->core->pd) return -1;
+  int err = ram_map_image(sim->ram, path);
+  if (err != 0) return err;
+  return sim_setup_code(sim);
+}
+
+
+int sim_restore_snapshot(SIM *sim, const char *path) {
+  CORE *core = sim->core;
+  SNAPSHOT_HEADER h;
+
+  if (core->pd) return -1;
+  int err = snapshot_read_header(path, &h);
+  if (err != 0) return err;
+  /* the RAM of the snapshot replaces the one of the configuration, nothing uses it yet */
+  if (h.ram_size != sim->ram->size) {
+    RAM *ram = (RAM *)malloc(sizeof(RAM));
+    if (ram == NULL) return -2;
+    if (ram_create(ram, h.ram_size, sim->config.hugepages) != 0) {
+      free(ram);
+      return -2;
+    }
+    ram_dispose(sim->ram);
+    sim->ram = ram;
+    sim->config.ram_size = h.ram_size;
+    core->ram = ram->base;
+    core->ram_limit = ram->size < BUS_BASE ? (uint32_t)ram->size : BUS_BASE;
+  }
+  err = snapshot_load(path, &h, sim->ram);
+  if (err != 0) return err;
+  err = sim_setup_code(sim);
+  if (err != 0) return err;
+
+  memcpy(core->regs, h.regs, sizeof(h.regs));
+  core->regs[0] = 0;
+  core->pc = h.pc;
+  core->sys->brk_start = h.brk_start;
+  core->sys->brk = h.brk;
+  core->sys->brk_max = h.brk_max;
+  sim->insts = h.insts;
+  return 0;
+}
+
+
+int sim_save_snapshot(SIM *sim, const char *path) {
+  CORE *core = sim->core;
+  SNAPSHOT_HEADER h;
+
+  if (core->pd == NULL) return -1;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.regs, core->regs, sizeof(h.regs));
+  h.pc = (uint32_t)core->pc;
+  h.insts = sim->insts;
+  h.brk_start = core->sys->brk_start;
+  h.brk = core->sys->brk;
+  h.brk_max = core->sys->brk_max;
+  return snapshot_save(path, &h, sim->ram);
+}
+
+
+/* models fed by the retired instructions, split between the model threads */
+#define SIM_REUSE_I     0x01
+#define SIM_REUSE_D     0x02
+#define SIM_TIMING      0x04
+#define SIM_BPRED       0x08
+#define SIM_L1I         0x10
+#define SIM_L1D         0x20
+#define SIM_MODELS_ALL  0x3F
+
+
+/* a retired instruction to the models of the bits of models: the cache models, */
+/* the branch predictors, the stack distance analysis and the timing model */
+static inline void sim_retire(SIM *sim, uint32_t models, const DECODED *dec, const RETIRE_REC *rec) {
+  uint32_t pc = rec->pc, addr = rec->addr;
+  // loads and stores to the RAM, devices are not cached
+  int ram = dec->op >= OP_LB && dec->op <= OP_SW && addr < sim->core->ram_limit;
+
+  if ((models & SIM_L1I) && sim->l1i) cache_access(sim->l1i, pc, 0, pc);
+  if ((models & SIM_REUSE_I) && sim->reuse_i) reuse_access(sim->reuse_i, pc);
+  if ((models & SIM_L1D) && sim->l1d && ram) cache_access(sim->l1d, addr, dec->op >= OP_SB, pc);
+  if ((models & SIM_REUSE_D) && sim->reuse_d && ram) reuse_access(sim->reuse_d, addr);
+  if ((models & SIM_BPRED) && sim->bpred) bpred_retire(sim->bpred, dec, pc, rec->next_pc);
+  if ((models & SIM_TIMING) && sim->timing) {
+    TIMING_EVENT ev = {dec, pc, rec->next_pc, addr};
+    timing_retire(sim->timing, &ev);
+  }
+}
+
+
+/* the models of a model thread */
+static void sim_retire_thread(void *ctx, uint32_t models, const DECODED *dec, const RETIRE_REC *rec) {
+  sim_retire((SIM *)ctx, models, dec, rec);
+}
+
+
+/* start the model threads, the heaviest models first, one per thread as long as there are threads */
+static void sim_start_models(SIM *sim) {
+  const uint32_t order[6] = {SIM_REUSE_I, SIM_REUSE_D, SIM_TIMING, SIM_BPRED, SIM_L1I, SIM_L1D};
+  const void *present[6] = {sim->reuse_i, sim->reuse_d, sim->timing, sim->bpred, sim->l1i, sim->l1d};
+  uint32_t models[RETIRE_THREADS] = {0};
+  int n = 0;
+
+  for (int i = 0; i < 6; i++) n += present[i] != NULL;
+  int threads = sim->config.model_threads < n ? sim->config.model_threads : n;
+  if (threads > RETIRE_THREADS) threads = RETIRE_THREADS;
+  n = 0;
+  for (int i = 0; i < 6; i++)
+    if (present[i]) models[n++ % threads] |= order[i];
+  sim->retire = (RETIRE *)malloc(sizeof(RETIRE));
+  if (sim->retire && retire_create(sim->retire, threads, models, sim_retire_thread, sim) != 0) {
+    // the models run in the loop instead
+    retire_dispose(sim->retire);
+    sim->retire = NULL;
+  }
+}
+
+
+/* how the retired instructions go to the models: 0 without models, 1 in the loop, */
+/* 2 to the model threads, started by the first run */
+static int sim_models(SIM *sim) {
+
+  if (!sim->timing && !sim->l1i && !sim->l1d && !sim->bpred && !sim->reuse_i) return 0;
+  if (sim->config.model_threads == 0) return 1;
+  if (sim->retire == NULL) sim_start_models(sim);
+  return sim->retire ? 2 : 1;
+}
+
+
+/* switch and predecode engines, one instruction per iteration, */
+/* stopping before the instruction at stop when until is set; */
+/* with models, predecode whatever the engine and each instruction retired goes to them, */
+/* or to the model threads; */
+/* inlined in each caller, so the loop without models has no test of them */
+static inline __attribute__((always_inline)) uint64_t sim_loop_run(SIM *sim, TRACE *trace, uint64_t budget, int until, uint32_t stop, int models) {
+  CORE *core = sim->core;
+  size_t limit = sim->ram->image;
+  int decoded = models || sim->config.engine != ENGINE_SWITCH;
+  uint64_t left = budget;
+  RLOG rlog;
+
+  /* Run the code until its end*/
+  while (left) {
+    if (core->pc + 4 > limit) break;
+    if (until && core->pc == stop) break;
+    // the log record is written in place in the trace ring
+    RLOG *log = trace ? trace_reserve(trace) : &rlog;
+    if (!decoded) {
+      uint32_t inst_raw = core_load32(core, core->pc);
+      core->pc += 4;
+      log->h_pc = core->pc;
+      log->h_inst = inst_raw;
+      core_execute(core, inst_raw, log);
+    } else {
+      DECODED *dec = predecode_fetch(core->pd, core->pc);
+      core->pc += 4;
+      log->h_pc = core->pc;
+      log->h_inst = dec->raw;
+      core_execute_decoded(core, dec, log);
+      if (models == 1) {
+        RETIRE_REC rec = {log->h_pc - 4, dec->raw, log->h_rs1 + dec->imm, (uint32_t)core->pc};
+        sim_retire(sim, SIM_MODELS_ALL, dec, &rec);
+      } else if (models == 2) {
+        retire_put(sim->retire, log->h_pc - 4, dec->raw, log->h_rs1 + dec->imm, (uint32_t)core->pc);
+      }
+    }
+    left--;
+    if (trace) trace_commit(trace); //publish log struct in the ringbuffer
+    if (core->pc == 0) break;
+  }
+  return budget - left;
+}
+
+
+/* the loop compiled without the models, with them and with the model threads */
+static uint64_t sim_loop(SIM *sim, TRACE *trace, uint64_t budget, int until, uint32_t stop) {
+  return sim_loop_run(sim, trace, budget, until, stop, 0);
+}
+
+static uint64_t sim_loop_models(SIM *sim, TRACE *trace, uint64_t budget, int until, uint32_t stop) {
+  return sim_loop_run(sim, trace, budget, until, stop, 1);
+}
+
+static uint64_t sim_loop_queued(SIM *sim, TRACE *trace, uint64_t budget, int until, uint32_t stop) {
+  return sim_loop_run(sim, trace, budget, until, stop, 2);
+}
+
+
+SIM_STATUS sim_run(SIM *sim, uint64_t max_insts) {
+  CORE *core = sim->core;
+  TRACE *trace = sim->logging ? sim->trace : NULL;
+
+  if (core->pd == NULL) return SIM_EXITED;
+  if (sim->status != SIM_RUNNING || max_insts == 0) return sim->status;
+
+  /* Guest loads and stores outside the RAM fault and come back here */
+  if (sigsetjmp(sim->resume, 0)) {
+    ram_guard(NULL, NULL);
+    // core->pc is past the instruction running, like the PC of the log
+    core->pc -= 4;
+    sim->status = SIM_FAULT;
+  } else {
+    ram_guard(sim->ram, &sim->resume);
+    int models = sim_models(sim);
+    if (models == 2)
+      sim->insts += sim_loop_queued(sim, trace, max_insts, 0, 0);
+    else if (models)
+      sim->insts += sim_loop_models(sim, trace, max_insts, 0, 0);
+    else if (sim->config.engine == ENGINE_THREADED || sim->config.engine == ENGINE_BLOCK)
+      sim->insts += threaded_run(core, trace, max_insts);
+    else
+      sim->insts += sim_loop(sim, trace, max_insts, 0, 0);
+    ram_guard(NULL, NULL);
+    // returning to 0 is the end of the program, like running past the code
+    if (core->pc == 0 || core->pc + 4 > sim->ram->image) sim->status = SIM_EXITED;
+  }
+  // the models have seen every instruction of the run when it returns
+  if (sim->retire) retire_sync(sim->retire);
+
+  if (sim->status != SIM_RUNNING) sim_finish(sim);
+  return sim->status;
+}
+
+
+SIM_STATUS sim_run_until(SIM *sim, uint32_t pc, uint64_t max_insts) {
+  CORE *core = sim->core;
+  TRACE *trace = sim->logging ? sim->trace : NULL;
+
+  if (core->pd == NULL) return SIM_EXITED;
+  if (sim->status != SIM_RUNNING || max_insts == 0) return sim->status;
+
+  /* the predecode loop compares the PC of every instruction, whatever the engine; */
+  /* the predecode cache is the one of the other engines, they go on from there */
+  if (sigsetjmp(sim->resume, 0)) {
+    ram_guard(NULL, NULL);
+    core->pc -= 4;
+    sim->status = SIM_FAULT;
+  } else {
+    ram_guard(sim->ram, &sim->resume);
+    int models = sim_models(sim);
+    if (models == 2) sim->insts += sim_loop_queued(sim, trace, max_insts, 1, pc);
+    else if (models) sim->insts += sim_loop_models(sim, trace, max_insts, 1, pc);
+    else sim->insts += sim_loop(sim, trace, max_insts, 1, pc);
+    ram_guard(NULL, NULL);
+    if (core->pc != pc && (core->pc == 0 || core->pc + 4 > sim->ram->image)) sim->status = SIM_EXITED;
+  }
+  if (sim->retire) retire_sync(sim->retire);
+
+  if (sim->status != SIM_RUNNING) sim_finish(sim);
+  return sim->status;
+}
+
+
+void sim_finish(SIM *sim) {
+
+  if (sim->status == SIM_RUNNING) sim->status = SIM_EXITED;
+  /* Stream the records left in the ringbuffer to disk*/
+  if (sim->trace) trace_finish(sim->trace);
+}
+
+
+void sim_set_timing(SIM *sim, TIMING *timing) {
+
+  // the model threads start again with the new model
+  if (sim->retire) retire_dispose(sim->retire);
+  sim->retire = NULL;
+  if (sim->timing && sim->timing->dispose) sim->timing->dispose(sim->timing);
+  sim->timing = timing;
+}
+
+
+void sim_set_log(SIM *sim, int on) {
+
+  sim->logging = on;
+}
+
+
+void sim_mark_log(SIM *sim, uint32_t mark) {
+
+  if (sim->trace == NULL || sim->status != SIM_RUNNING) return;
+  RLOG *log = trace_reserve(sim->trace);
+  log->h_pc = RLOG_MARK;
+  log->h_inst = mark;
+  log->h_rd = (uint32_t)sim->insts;
+  log->h_rs1 = (uint32_t)(sim->insts >> 32);
+  log->h_rs2 = (uint32_t)sim->core->pc;
+  trace_commit(sim->trace);
+}
+
+
+SIM_STATUS sim_step(SIM *sim) {
+
+  return sim_run(sim, 1);
+}
+
+
+uint32_t sim_get_reg(SIM *sim, uint32_t n) {
+
+  return n > 0 && n < 32 ? sim->core->regs[n] : 0;
+}
+
+
+void sim_set_reg(SIM *sim, uint32_t n, uint32_t value) {
+
+  if (n > 0 && n < 32) sim->core->regs[n] = value;
+}
+
+
+uint32_t sim_get_pc(SIM *sim) {
+
+  return (uint32_t)sim->core->pc;
+}
+
+
+void sim_set_pc(SIM *sim, uint32_t pc) {
+
+  sim->core->pc = pc;
+}
+
+
+int sim_read_mem(SIM *sim, uint32_t addr, void *buf, size_t len) {
+
+  if (addr > sim->ram->size || len > sim->ram->size - addr) return -1;
+  memcpy(buf, sim->ram->base + addr, len);
+  return 0;
+}
+
+
+int sim_write_mem(SIM *sim, uint32_t addr, const void *buf, size_t len) {
+  CORE *core = sim->core;
+
+  if (addr > sim->ram->size || len > sim->ram->size - addr) return -1;
+  memcpy(sim->ram->base + addr, buf, len);
+  // drop predecoded instructions and blocks overwritten, like a guest store
+  core_code_written(core, addr, (uint32_t)len);
+  return 0;
+}
+
+
+int sim_exit_code(SIM *sim) {
+  CORE *core = sim->core;
+
+  if (core->sys && core->sys->exited) return (int)core->sys->exit_code;
+  return core->bus->halted ? (int)core->bus->exit_code : 0;
+}
+
+
+void sim_model_stats(SIM *sim, FILE *out) {
+
+  if (sim->timing) timing_stats(sim->timing, out);
+  if (sim->l1i) cache_stats(sim->l1i, out);
+  if (sim->l1d) cache_stats(sim->l1d, out);
+  if (sim->bpred) bpred_stats(sim->bpred, out);
+  if (sim->reuse_i) reuse_stats(sim->reuse_i, out);
+  if (sim->reuse_d) reuse_stats(sim->reuse_d, out);
+}
+
+
+void sim_stats(SIM *sim, FILE *out) {
+  CORE *core = sim->core;
+
+  fprintf(out, "instructions:        %llu\n", (unsigned long long)sim->insts);
+  if (sim->trace) trace_stats(sim->trace, out);
+  sim_model_stats(sim, out);
+  if (sim->retire) retire_stats(sim->retire, out);
+  if (core->bc) block_stats(core->bc, sim->insts, out);
+  if (core->bc && core->bc->jit) jit_stats(core->bc->jit, out);
+  bus_stats(core->bus, out);
+  if (core->sys) sys_stats(core->sys, out);
+}
+
+
+void sim_destroy(SIM *sim) {
+  CORE *core = sim->core;
+
+  /* Close log file*/
+  if (sim->trace) trace_dispose(sim->trace);
+  // the model threads end before their models
+  if (sim->retire) retire_dispose(sim->retire);
+  if (sim->timing && sim->timing->dispose) sim->timing->dispose(sim->timing);
+  if (sim->l1i) cache_dispose(sim->l1i);
+  if (sim->l1d) cache_dispose(sim->l1d);
+  if (sim->bpred) bpred_dispose(sim->bpred);
+  if (sim->reuse_i) reuse_dispose(sim->reuse_i);
+  if (sim->reuse_d) reuse_dispose(sim->reuse_d);
+
+  /* Deallocate CORE struct and its resources*/
+  if (core) {
+    if (core->bc && core->bc->jit) jit_dispose(core->bc->jit);
+    if (core->bc) block_dispose(core->bc);
+    if (core->pd) predecode_dispose(core->pd);
+    if (core->sys) sys_dispose(core->sys);
+    /* the guest output goes out before the simulator ends */
+    if (core->bus) bus_dispose(core->bus);
+    free(core);
+  }
+  if (sim->out_fd >= 0) close(sim->out_fd);
+  if (sim->ram) ram_dispose(sim->ram);
+  free(sim);
+}
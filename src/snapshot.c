@@ -0,0 +1,148 @@
+#include "include/snapshot.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNAPSHOT_PAGEMAP_BATCH  4096    // pagemap entries read at a time
+
+/* the page has a byte other than zero */
+static int snapshot_page_used(const uint8_t *p) {
+  const uint64_t *w = (const uint64_t *)p;
+  for (uint32_t i = 0; i < SNAPSHOT_PAGE / 8; i++)
+    if (w[i]) return 1;
+  return 0;
+}
+
+
+/* mark the pages of the RAM the guest may have written: present or swapped out */
+/* in /proc/self/pagemap, every page when it can not be read */
+static void snapshot_touched(const RAM *ram, uint8_t *touched, uint32_t pages) {
+  uint64_t entries[SNAPSHOT_PAGEMAP_BATCH];
+  int fd = (size_t)sysconf(_SC_PAGESIZE) == SNAPSHOT_PAGE ? open("/proc/self/pagemap", O_RDONLY) : -1;
+
+  memset(touched, 1, pages);
+  if (fd < 0) return;
+  uint64_t first = (uintptr_t)ram->base / SNAPSHOT_PAGE;
+  for (uint32_t i = 0; i < pages; i += SNAPSHOT_PAGEMAP_BATCH) {
+    uint32_t n = pages - i < SNAPSHOT_PAGEMAP_BATCH ? pages - i : SNAPSHOT_PAGEMAP_BATCH;
+    if (pread(fd, entries, n * sizeof(uint64_t), (first + i) * sizeof(uint64_t)) != (ssize_t)(n * sizeof(uint64_t))) {
+      memset(touched, 1, pages);
+      break;
+    }
+    // bit 63: present, bit 62: swapped
+    for (uint32_t j = 0; j < n; j++) touched[i + j] = (entries[j] >> 62) != 0;
+  }
+  close(fd);
+}
+
+
+int snapshot_save(const char *path, const SNAPSHOT_HEADER *header, const RAM *ram) {
+  uint32_t pages = (uint32_t)((ram->map_size + SNAPSHOT_PAGE - 1) / SNAPSHOT_PAGE);
+  uint32_t image_pages = (uint32_t)((ram->image + SNAPSHOT_PAGE - 1) / SNAPSHOT_PAGE);
+  SNAPSHOT_HEADER h = *header;
+  static const uint8_t pad[SNAPSHOT_PAGE];
+
+  uint8_t *touched = (uint8_t *)malloc(pages);
+  uint32_t *index = (uint32_t *)malloc((size_t)pages * sizeof(uint32_t));
+  if (touched == NULL || index == NULL) {
+    free(touched);
+    free(index);
+    return -2;
+  }
+  // image pages are mapped from the file and may not be present, read them all
+  snapshot_touched(ram, touched, pages);
+  h.num_pages = 0;
+  for (uint32_t p = 0; p < pages; p++) {
+    if ((p < image_pages || touched[p]) && snapshot_page_used(ram->base + (size_t)p * SNAPSHOT_PAGE))
+      index[h.num_pages++] = p;
+  }
+  free(touched);
+
+  memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+  h.version = SNAPSHOT_VERSION;
+  h.page_size = SNAPSHOT_PAGE;
+  h.ram_size = ram->size;
+  h.image = ram->image;
+  h.index_offset = SNAPSHOT_PAGE;
+  h.data_offset = h.index_offset + (((uint64_t)h.num_pages * sizeof(uint32_t) + SNAPSHOT_PAGE - 1) & ~(uint64_t)(SNAPSHOT_PAGE - 1));
+
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    free(index);
+    return -1;
+  }
+  size_t index_len = (size_t)h.num_pages * sizeof(uint32_t);
+  int ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+           fwrite(pad, SNAPSHOT_PAGE - sizeof(h), 1, file) == 1 &&
+           fwrite(index, 1, index_len, file) == index_len &&
+           fwrite(pad, 1, h.data_offset - h.index_offset - index_len, file) == h.data_offset - h.index_offset - index_len;
+  for (uint32_t i = 0; ok && i < h.num_pages; i++)
+    ok = fwrite(ram->base + (size_t)index[i] * SNAPSHOT_PAGE, SNAPSHOT_PAGE, 1, file) == 1;
+  free(index);
+  if (fclose(file) != 0) ok = 0;
+  return ok ? 0 : -1;
+}
+
+
+int snapshot_read_header(const char *path, SNAPSHOT_HEADER *header) {
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return -1;
+  ssize_t n = pread(fd, header, sizeof(SNAPSHOT_HEADER), 0);
+  close(fd);
+  if (n != (ssize_t)sizeof(SNAPSHOT_HEADER)) return -3;
+  if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != SNAPSHOT_VERSION || header->page_size != SNAPSHOT_PAGE) return -3;
+  return 0;
+}
+
+
+int snapshot_load(const char *path, const SNAPSHOT_HEADER *header, RAM *ram) {
+  uint32_t n = header->num_pages;
+  uint32_t pages = (uint32_t)((ram->map_size + SNAPSHOT_PAGE - 1) / SNAPSHOT_PAGE);
+  // pages are mapped when the host pages are snapshot pages, read otherwise
+  int map = (size_t)sysconf(_SC_PAGESIZE) == SNAPSHOT_PAGE;
+
+  if (header->ram_size != ram->size) return -3;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return -1;
+  // a page mapped past the end of the file would fault when the guest reads it
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+  if (header->data_offset % SNAPSHOT_PAGE || header->index_offset + (uint64_t)n * sizeof(uint32_t) > header->data_offset ||
+      header->data_offset + (uint64_t)n * SNAPSHOT_PAGE > (uint64_t)st.st_size) {
+    close(fd);
+    return -3;
+  }
+  uint32_t *index = (uint32_t *)malloc((size_t)n * sizeof(uint32_t) + 1);
+  if (index == NULL) {
+    close(fd);
+    return -2;
+  }
+  int err = pread(fd, index, (size_t)n * sizeof(uint32_t), header->index_offset) == (ssize_t)(n * sizeof(uint32_t)) ? 0 : -1;
+  // ascending pages inside the RAM, each saved once
+  for (uint32_t i = 0; err == 0 && i < n; i++)
+    if (index[i] >= pages || (i && index[i] <= index[i - 1])) err = -3;
+  for (uint32_t i = 0; err == 0 && i < n; ) {
+    // run of consecutive pages, consecutive in the file too
+    uint32_t run = 1;
+    while (i + run < n && index[i + run] == index[i] + run) run++;
+    uint8_t *addr = ram->base + (size_t)index[i] * SNAPSHOT_PAGE;
+    off_t off = header->data_offset + (off_t)i * SNAPSHOT_PAGE;
+    size_t len = (size_t)run * SNAPSHOT_PAGE;
+    if (map) {
+      if (mmap(addr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, off) == MAP_FAILED) err = -2;
+    } else if (pread(fd, addr, len, off) != (ssize_t)len) {
+      err = -1;
+    }
+    i += run;
+  }
+  free(index);
+  close(fd);
+  if (err == 0) ram->image = header->image;
+  return err;
+}
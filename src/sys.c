@@ -0,0 +1,155 @@
+#include "include/sys.h"
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+/* guest buffer [addr, addr + len) in RAM, NULL if it is not */
+static uint8_t *sys_buffer(SYS *sys, uint32_t addr, uint32_t len) {
+  if (addr > sys->ram_limit || len > sys->ram_limit - addr) return NULL;
+  return sys->ram + addr;
+}
+
+/* write all of buf to a host file descriptor */
+static int sys_write_all(int fd, const uint8_t *buf, size_t len) {
+  size_t done = 0;
+
+  while (done < len) {
+    ssize_t n = write(fd, buf + done, len - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return -1;
+    done += n;
+  }
+  return 0;
+}
+
+
+static int32_t sys_write(SYS *sys, uint32_t fd, uint32_t addr, uint32_t len) {
+  uint8_t *buf = sys_buffer(sys, addr, len);
+  LOGFMT_OUT *out = sys->out;
+
+  if (buf == NULL) return -SYS_EFAULT;
+  if (fd == 1) {
+    // small writes are gathered, the ones larger than the buffer go straight out
+    if (out->size - out->len < len) logfmt_out_flush(out);
+    if (len < out->size) {
+      memcpy(out->buf + out->len, buf, len);
+      out->len += len;
+      return (int32_t)len;
+    }
+  } else if (fd != 2) {
+    return -SYS_EBADF;
+  }
+  // keep the order of stdout and stderr
+  logfmt_out_flush(out);
+  if (sys_write_all(fd, buf, len) != 0) return -SYS_EFAULT;
+  return (int32_t)len;
+}
+
+
+static int32_t sys_read(SYS *sys, CORE *core, uint32_t fd, uint32_t addr, uint32_t len) {
+  uint8_t *buf = sys_buffer(sys, addr, len);
+  ssize_t n;
+
+  if (fd != 0) return -SYS_EBADF;
+  if (buf == NULL) return -SYS_EFAULT;
+  // a prompt written before the read shows up first
+  logfmt_out_flush(sys->out);
+  do n = read(0, buf, len); while (n < 0 && errno == EINTR);
+  if (n < 0) return -SYS_EFAULT;
+  // code read over runs as read, like a guest store
+  if (n > 0) core_code_written(core, addr, (uint32_t)n);
+  return (int32_t)n;
+}
+
+
+static uint32_t sys_brk(SYS *sys, uint32_t addr) {
+
+  if (addr < sys->brk_start || addr > sys->ram_limit) return sys->brk;
+  // memory given back and taken again reads as zero, like fresh pages
+  if (addr > sys->brk && sys->brk < sys->brk_max) {
+    uint32_t end = addr < sys->brk_max ? addr : sys->brk_max;
+    memset(sys->ram + sys->brk, 0, end - sys->brk);
+  }
+  sys->brk = addr;
+  if (addr > sys->brk_max) sys->brk_max = addr;
+  return addr;
+}
+
+
+static int32_t sys_clock_gettime(SYS *sys, uint32_t clk, uint32_t addr, int time64) {
+  uint8_t *buf = sys_buffer(sys, addr, time64 ? 16 : 8);
+  struct timespec ts;
+
+  if (clk > 7) return -SYS_EINVAL;
+  if (buf == NULL) return -SYS_EFAULT;
+  // CLOCK_REALTIME, the monotonic and CPU time clocks all read the monotonic one
+  if (clock_gettime(clk == 0 ? CLOCK_REALTIME : CLOCK_MONOTONIC, &ts) != 0) return -SYS_EINVAL;
+  if (time64) {
+    uint64_t sec = (uint64_t)ts.tv_sec, nsec = (uint64_t)ts.tv_nsec;
+    ram_store32(buf, 0, (uint32_t)sec);
+    ram_store32(buf, 4, (uint32_t)(sec >> 32));
+    ram_store32(buf, 8, (uint32_t)nsec);
+    ram_store32(buf, 12, 0);
+  } else {
+    ram_store32(buf, 0, (uint32_t)ts.tv_sec);
+    ram_store32(buf, 4, (uint32_t)ts.tv_nsec);
+  }
+  return 0;
+}
+
+
+int sys_create(SYS *sys, uint8_t *ram, uint32_t ram_limit, uint32_t image, LOGFMT_OUT *out) {
+
+  if (sys == NULL) return -1;
+  memset(sys, 0, sizeof(SYS));
+  sys->ram = ram;
+  sys->ram_limit = ram_limit;
+  sys->out = out;
+  image = (image + 15) & ~15u;
+  sys->brk_start = image < ram_limit ? image : ram_limit;
+  sys->brk = sys->brk_start;
+  sys->brk_max = sys->brk_start;
+  return 0;
+}
+
+
+int sys_ecall(SYS *sys, CORE *core, uint32_t *regs) {
+  uint32_t *a = regs + 10;      // a0-a7
+  int32_t ret;
+
+  sys->calls++;
+  switch (a[7]) {
+  case SYS_EXIT:
+  case SYS_EXIT_GROUP:
+    sys->exited = 1;
+    sys->exit_code = a[0];
+    logfmt_out_flush(sys->out);
+    // returning to 0 ends the run of the main loop, the other engines check the result
+    core->pc = 0;
+    return 1;
+  case SYS_WRITE:           ret = sys_write(sys, a[0], a[1], a[2]); break;
+  case SYS_READ:            ret = sys_read(sys, core, a[0], a[1], a[2]); break;
+  case SYS_BRK:             ret = (int32_t)sys_brk(sys, a[0]); break;
+  case SYS_CLOCK_GETTIME:   ret = sys_clock_gettime(sys, a[0], a[1], 0); break;
+  case SYS_CLOCK_GETTIME64: ret = sys_clock_gettime(sys, a[0], a[1], 1); break;
+  default:
+    sys->unknown++;
+    ret = -SYS_ENOSYS;
+  }
+  a[0] = (uint32_t)ret;
+  return 0;
+}
+
+
+void sys_stats(SYS *sys, FILE *out) {
+
+  fprintf(out, "system calls:        %llu", (unsigned long long)sys->calls);
+  if (sys->unknown) fprintf(out, " (%llu not supported)", (unsigned long long)sys->unknown);
+  fprintf(out, "\n");
+}
+
+
+void sys_dispose(SYS *sys) {
+
+  free(sys);
+}
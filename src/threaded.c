@@ -0,0 +1,223 @@
+#include "include/threaded.h"
+#include "include/block.h"
+#include "include/jit.h"
+#include "include/predecode.h"
+#include "include/sys.h"
+
+/* Handlers are reached with computed goto on GCC/Clang (direct threading), */
+/* other compilers dispatch through a switch on the OP_* of the entry */
+#if defined(__GNUC__)
+#define THREADED_GOTO
+#endif
+
+uint64_t threaded_run(CORE *core, TRACE *trace, uint64_t budget) {
+  PREDECODE *pd = core->pd;
+  BLOCK_CACHE *bc = core->bc;
+  BLOCK *b = NULL;      // block running, when using the block cache
+  JIT *jit = bc && !trace ? bc->jit : NULL;   // native blocks do not log, the JIT only runs untraced
+  BLOCK *checking = NULL;   // block run natively and then interpreted, in JIT check mode
+  uint32_t xj[33];      // registers after the native run of the checked block
+  uint32_t jpc = 0;     // next PC after the native run of the checked block
+  uint32_t limit = pd->limit;
+  uint32_t x[33];       // guest registers, x[32] is the sink for writes to x0
+  uint32_t pc = (uint32_t)core->pc;
+  uint64_t left = budget;    // instructions the run may still execute
+  DECODED *stop = NULL;      // entry patched to leave the run where the budget ends
+  DECODED saved;             // the entry before the patch
+  DECODED *d;
+  RLOG *r = NULL;       // record of the instruction running
+
+#ifdef THREADED_GOTO
+#define THREADED_LABEL(name) [OP_##name] = &&L_##name,
+  static const void *const labels[OP_COUNT] = { CORE_OPS(THREADED_LABEL) };
+  if (pd->labels != labels) predecode_set_labels(pd, labels);
+#define DISPATCH() goto *d->label
+#define STOP_PATCH(e) ((e)->label = &&L_BUDGET)
+#define STOP_PATCHED(e) ((e)->label == &&L_BUDGET)
+#else
+#define DISPATCH() goto dispatch
+#define STOP_PATCH(e) ((e)->op = OP_COUNT)
+#define STOP_PATCHED(e) ((e)->op == OP_COUNT)
+#endif
+
+/* log values read before the instruction, in its ring slot */
+#define PRE() \
+  if (trace) { r = trace_reserve(trace); r->h_rs1 = x[d->rs1]; r->h_rs2 = x[d->rs2]; }
+/* complete the log of the instruction at pc */
+#define POST() do { \
+    if (trace) { \
+      r->h_pc = pc + 4; \
+      r->h_inst = d->raw; \
+      r->h_rd = x[d->rd]; \
+      trace_commit(trace); \
+    } \
+    left--; \
+  } while (0)
+/* loads and stores keep core->pc past the instruction, for a guest access fault report */
+#define MEM() do { PRE(); core->pc = pc + 4; } while (0)
+/* fall through to the next entry of the page table */
+#define NEXT() do { POST(); pc += 4; d++; DISPATCH(); } while (0)
+/* The budget is only checked on control transfers: straight-line code runs to */
+/* the next jump or to the LOOKUP at the end of its block or page. When the budget */
+/* ends before that, the entry where it ends is patched to leave the run */
+#define STOP_AT(e, run) do { \
+    if (left < (run)) { stop = (e) + left; saved = *stop; STOP_PATCH(stop); } \
+  } while (0)
+/* undo the patch, unless a store into the code replaced the entry meanwhile */
+#define STOP_CLEAR() do { \
+    if (stop) { if (STOP_PATCHED(stop)) *stop = saved; stop = NULL; } \
+  } while (0)
+/* transfer control to target, returning to 0 ends the run like in the main loop */
+#define JUMP(target) do { uint32_t t_ = (target); POST(); pc = t_; if (pc == 0) goto out; goto jump; } while (0)
+/* a store ends the run when the guest halted, or leaves the block it overwrote */
+#define STORE(s) do { int s_ = (s); if (s_) JUMP(s_ == CORE_STORE_HALT ? 0 : pc + 4); } while (0)
+
+  memcpy(x, core->regs, sizeof(core->regs));
+  x[0] = 0;
+  x[32] = 0;
+
+jump:
+  STOP_CLEAR();
+  if (checking) {
+    jit_check_compare(jit, checking, x, pc, xj, jpc, core->ram);
+    checking = NULL;
+  }
+  // the block left was overwritten, it is freed and nothing is chained to it
+  if (bc && bc->left) {
+    block_free_dead(bc);
+    b = NULL;
+  }
+  if (left == 0) goto out;
+  if (bc && (pc & 3) == 0) {
+    // follow the chain of the block just left, or find the block and chain it
+    BLOCK *nb;
+    if (b) {
+      BLOCK_LINK *link = &b->next[pc == b->pc + 4 * b->len];
+      if (link->to && link->to->pc == pc) {
+        nb = link->to;
+        bc->chained++;
+      } else {
+        nb = block_lookup(bc, pc);
+        block_chain(link, nb);
+      }
+    } else {
+      nb = block_lookup(bc, pc);
+    }
+    if (nb == NULL) goto out;   // ran past the code
+    b = nb;
+    bc->running = b;
+    b->execs++;
+    bc->entered++;
+    if (jit) {
+      if (b->native == NULL && b->execs == jit->threshold) jit_compile(jit, bc, b);
+      // a block longer than the budget left is interpreted, it stops on the last instruction allowed
+      if (b->native && left >= b->len) {
+        jit->native_insts += b->len;
+        core->pc = pc + 4;      // a fault in native code reports the start of the block
+        if (!jit->check) {
+          pc = b->native(x, core->ram, core);
+          // a store over the block itself leaves it after the store
+          left -= bc->left ? (pc - b->pc) / 4 : b->len;
+          if (pc == 0) goto out;
+          goto jump;
+        }
+        // check mode: run natively on a copy, undo the stores, then interpret the block
+        memcpy(xj, x, sizeof(x));
+        jit->num_stores = 0;
+        jpc = b->native(xj, core->ram, core);
+        jit_check_undo(jit, core->ram);
+        if (bc->left) {
+          // the block stores over itself: translated again and interpreted, not checked
+          block_free_dead(bc);
+          if ((b = block_lookup(bc, pc)) == NULL) goto out;
+          bc->running = b;
+        } else {
+          checking = b;
+        }
+      }
+    }
+    d = b->uops;
+    STOP_AT(d, b->len);
+    DISPATCH();
+  }
+  // same end condition as the main loop: ran past the code
+  if ((uint64_t)pc + 4 > limit) goto out;
+  d = predecode_fetch(pd, pc);
+  STOP_AT(d, d == &pd->scratch[0] ? 1 : PREDECODE_PAGE_INSTS - ((pc >> 2) & (PREDECODE_PAGE_INSTS - 1)));
+  DISPATCH();
+
+#ifndef THREADED_GOTO
+dispatch:
+  switch (d->op) {
+#define THREADED_CASE(name) case OP_##name: goto L_##name;
+  CORE_OPS(THREADED_CASE)
+  default: goto out;
+  }
+#endif
+
+L_FILL:
+  // the budget ends here if a store into the code replaced the patched entry
+  if (left == 0 || (uint64_t)pc + 4 > limit) goto out;
+  d = predecode_fill(pd, pc);
+  DISPATCH();
+L_LOOKUP:
+  goto jump;
+#ifdef THREADED_GOTO
+L_BUDGET:
+  goto out;
+#endif
+
+L_NOP:   PRE(); NEXT();
+L_LB:    MEM(); x[d->wd] = (int8_t)core_load8(core, x[d->rs1] + d->imm); NEXT();
+L_LH:    MEM(); x[d->wd] = (int16_t)core_load16(core, x[d->rs1] + d->imm); NEXT();
+L_LW:    MEM(); x[d->wd] = core_load32(core, x[d->rs1] + d->imm); NEXT();
+L_LBU:   MEM(); x[d->wd] = core_load8(core, x[d->rs1] + d->imm); NEXT();
+L_LHU:   MEM(); x[d->wd] = core_load16(core, x[d->rs1] + d->imm); NEXT();
+L_SB:    MEM(); STORE(core_store8(core, x[d->rs1] + d->imm, x[d->rs2])); NEXT();
+L_SH:    MEM(); STORE(core_store16(core, x[d->rs1] + d->imm, x[d->rs2])); NEXT();
+L_SW:    MEM(); STORE(core_store32(core, x[d->rs1] + d->imm, x[d->rs2])); NEXT();
+L_ADDI:  PRE(); x[d->wd] = x[d->rs1] + d->imm; NEXT();
+L_XORI:  PRE(); x[d->wd] = x[d->rs1] ^ d->imm; NEXT();
+L_ORI:   PRE(); x[d->wd] = x[d->rs1] | d->imm; NEXT();
+L_ANDI:  PRE(); x[d->wd] = x[d->rs1] & d->imm; NEXT();
+L_ADD:   PRE(); x[d->wd] = x[d->rs1] + x[d->rs2]; NEXT();
+L_MUL:   PRE(); x[d->wd] = x[d->rs1] * x[d->rs2]; NEXT();
+L_SUB:   PRE(); x[d->wd] = x[d->rs1] - x[d->rs2]; NEXT();
+L_XOR:   PRE(); x[d->wd] = x[d->rs1] ^ x[d->rs2]; NEXT();
+L_OR:    PRE(); x[d->wd] = x[d->rs1] | x[d->rs2]; NEXT();
+L_AND:   PRE(); x[d->wd] = x[d->rs1] & x[d->rs2]; NEXT();
+L_LUI:   PRE(); x[d->wd] = d->imm; NEXT();
+L_AUIPC: PRE(); x[d->wd] = pc + d->imm; NEXT();
+L_JAL:   PRE(); x[d->wd] = pc + 4; JUMP(pc + d->imm);
+L_JALR:  PRE(); { uint32_t t = x[d->rs1] + d->imm; x[d->wd] = pc + 4; JUMP(t); }
+L_BEQ:   PRE(); if (x[d->rs1] == x[d->rs2]) JUMP(pc + d->imm); NEXT();
+L_BNE:   PRE(); if (x[d->rs1] != x[d->rs2]) JUMP(pc + d->imm); NEXT();
+L_BLT:   PRE(); if ((int32_t)x[d->rs1] < (int32_t)x[d->rs2]) JUMP(pc + d->imm); NEXT();
+L_BGE:   PRE(); if ((int32_t)x[d->rs1] >= (int32_t)x[d->rs2]) JUMP(pc + d->imm); NEXT();
+L_BLTU:  PRE(); if (x[d->rs1] < x[d->rs2]) JUMP(pc + d->imm); NEXT();
+L_BGEU:  PRE(); if (x[d->rs1] >= x[d->rs2]) JUMP(pc + d->imm); NEXT();
+L_ECALL: PRE(); if (core->sys && sys_ecall(core->sys, core, x)) JUMP(0); NEXT();
+
+out:
+  STOP_CLEAR();
+  if (checking) jit_check_compare(jit, checking, x, pc, xj, jpc, core->ram);
+  if (bc) {
+    block_free_dead(bc);
+    bc->running = NULL;
+  }
+  memcpy(core->regs, x, sizeof(core->regs));
+  core->pc = pc;
+  return budget - left;
+
+#undef PRE
+#undef POST
+#undef MEM
+#undef NEXT
+#undef JUMP
+#undef STORE
+#undef STOP_PATCH
+#undef STOP_PATCHED
+#undef STOP_AT
+#undef STOP_CLEAR
+#undef DISPATCH
+}
@@ -0,0 +1,9 @@
+#include "include/timing.h"
+
+void timing_stats(TIMING *timing, FILE *out) {
+
+  fprintf(out, "timing model:        %s\n", timing->name);
+  fprintf(out, "cycles:              %llu, CPI %.3f\n", (unsigned long long)timing->cycles,
+          timing->insts ? (double)timing->cycles / timing->insts : 0.0);
+  if (timing->stats) timing->stats(timing, out);
+}
@@ -0,0 +1,221 @@
+#include "include/trace.h"
+#include <sched.h>
+#include <unistd.h>
+#include <time.h>
+
+static int trace_text_create(TRACE *trace, int threads);
+static uint32_t trace_write_parallel(TRACE *trace);
+static void trace_close_format(TRACE *trace);
+static void *trace_writer(void *arg);
+static uint64_t trace_now_ns(void);
+
+
+int trace_create(TRACE *trace, TRACE_MODE mode, uint32_t last, TRACE_FORMAT format, int threads, const char *path) {
+
+  if (trace == NULL) return -1;
+
+  trace->mode = mode;
+  trace->format = format;
+  trace->running = 0;
+  atomic_init(&trace->done, 0);
+  trace->written = 0;
+  trace->dropped = 0;
+  trace->high_water = 0;
+  trace->stalls = 0;
+  trace->stall_ns = 0;
+  trace->ring = (RINGBUFFER_REC *)malloc(sizeof(RINGBUFFER_REC));
+  if (trace->ring == NULL) return -2;
+  int err = ringbuffer_rec_create(trace->ring, sizeof(RLOG), mode == TRACE_LAST ? last : TRACE_FULL_RECORDS);
+  if (err != 0) {
+    free(trace->ring);
+    return err == ERROR_BAD_COUNT ? -1 : -2;
+  }
+  trace->file = fopen(path, format == TRACE_BIN ? "wb" : "w");
+  if (trace->file == NULL) {
+    ringbuffer_rec_dispose(trace->ring);
+    return -3;
+  }
+  trace->fmt = NULL;
+  trace->pool = NULL;
+  if (format == TRACE_BIN ? tracebin_create(&trace->bin, trace->file) != 0 : trace_text_create(trace, threads) != 0) {
+    fclose(trace->file);
+    ringbuffer_rec_dispose(trace->ring);
+    return -2;
+  }
+  // full mode: records are written while the simulation runs
+  if (mode == TRACE_FULL) {
+    if (pthread_create(&trace->writer, NULL, trace_writer, trace) != 0) {
+      trace_close_format(trace);
+      fclose(trace->file);
+      ringbuffer_rec_dispose(trace->ring);
+      return -4;
+    }
+    trace->running = 1;
+  }
+  return 0;
+}
+
+
+RLOG *trace_make_room(TRACE *trace) {
+  RLOG *log;
+
+  if (trace->mode == TRACE_FULL) {
+    // the writer thread is behind, wait for it to free a slot
+    uint64_t start = trace_now_ns();
+    while ((log = (RLOG *)ringbuffer_rec_reserve(trace->ring)) == NULL) sched_yield();
+    trace->stalls++;
+    trace->stall_ns += trace_now_ns() - start;
+    return log;
+  }
+  ringbuffer_rec_consume(trace->ring);
+  trace->dropped++;
+  return (RLOG *)ringbuffer_rec_reserve(trace->ring);
+}
+
+
+uint32_t trace_write(TRACE *trace) {
+  const RLOG *rec;
+  uint32_t n = 0, max = UINT32_MAX;
+
+  // with the pool, come back to it once a chunk of records went one by one
+  if (trace->pool) {
+    n = trace_write_parallel(trace);
+    max = LOGPAR_CHUNK;
+  }
+  while (max-- && (rec = (const RLOG *)ringbuffer_rec_peek(trace->ring)) != NULL) {
+    if (trace->format == TRACE_BIN) tracebin_put(&trace->bin, rec);
+    else logfmt_out_put(&trace->out, trace->fmt, rec);
+    ringbuffer_rec_consume(trace->ring);
+    n++;
+  }
+  trace->written += n;
+  return n;
+}
+
+
+void trace_finish(TRACE *trace) {
+
+  if (trace->running) {
+    atomic_store_explicit(&trace->done, 1, memory_order_release);
+    pthread_join(trace->writer, NULL);
+    trace->running = 0;
+  }
+  while (trace_write(trace)) ;
+  if (trace->format == TRACE_TEXT) logfmt_out_flush(&trace->out);
+}
+
+
+void trace_stats(TRACE *trace, FILE *out) {
+
+  fprintf(out, "log records written: %llu\n", (unsigned long long)trace->written);
+  if (trace->mode == TRACE_LAST) {
+    fprintf(out, "log records dropped: %llu\n", (unsigned long long)trace->dropped);
+    return;
+  }
+  fprintf(out, "log queue:           %u records, high-water %u (%.1f%%)\n", trace->ring->limit,
+          trace->high_water, 100.0 * trace->high_water / trace->ring->limit);
+  fprintf(out, "log queue stalls:    %llu, %.3f ms waiting for the writer\n",
+          (unsigned long long)trace->stalls, trace->stall_ns / 1e6);
+}
+
+
+void trace_dispose(TRACE *trace) {
+
+  trace_finish(trace);
+  trace_close_format(trace);
+  fclose(trace->file);
+  ringbuffer_rec_dispose(trace->ring);
+  free(trace);
+}
+
+
+/* Text records are formatted in a buffer written straight to the file descriptor */
+/* with more than one thread, long runs of records are formatted by a LOGPAR pool */
+static int trace_text_create(TRACE *trace, int threads) {
+
+  trace->pool = NULL;
+  trace->fmt = (LOGFMT *)malloc(sizeof(LOGFMT));
+  if (trace->fmt == NULL) return -2;
+  logfmt_init(trace->fmt);
+  if (logfmt_out_create(&trace->out, fileno(trace->file), LOGFMT_OUT_SIZE) != 0) {
+    free(trace->fmt);
+    return -2;
+  }
+  trace->pool = (LOGPAR *)malloc(sizeof(LOGPAR));
+  if (trace->pool && logpar_create(trace->pool, threads) != 0) {
+    free(trace->pool);
+    trace->pool = NULL;
+  }
+  if (trace->pool && trace->pool->num_threads == 1) {
+    logpar_dispose(trace->pool);
+    trace->pool = NULL;
+  }
+  return 0;
+}
+
+
+/* format the pending records in runs of at least one LOGPAR_CHUNK with the pool, */
+/* at the file position left by the buffered writes */
+static uint32_t trace_write_parallel(TRACE *trace) {
+  const void *recs;
+  uint32_t n = 0, span;
+  int fd = trace->out.fd;
+
+  while ((span = ringbuffer_rec_span(trace->ring, &recs)) >= LOGPAR_CHUNK) {
+    logfmt_out_flush(&trace->out);
+    off_t pos = lseek(fd, 0, SEEK_CUR);
+    int64_t bytes = pos < 0 ? -1 : logpar_write(trace->pool, fd, pos, (const RLOG *)recs, span);
+    if (bytes < 0 || lseek(fd, pos + bytes, SEEK_SET) < 0) {
+      // not seekable or failed: the records left go through the buffered writes
+      logpar_dispose(trace->pool);
+      trace->pool = NULL;
+      break;
+    }
+    ringbuffer_rec_consume_n(trace->ring, span);
+    n += span;
+  }
+  return n;
+}
+
+
+/* write what the format still holds */
+static void trace_close_format(TRACE *trace) {
+
+  if (trace->format == TRACE_BIN) {
+    tracebin_close(&trace->bin);
+  } else {
+    logfmt_out_dispose(&trace->out);
+    if (trace->pool) logpar_dispose(trace->pool);
+    free(trace->fmt);
+  }
+}
+
+
+/* Writer thread of full mode: drain the ring until the simulation ends */
+static void *trace_writer(void *arg) {
+  TRACE *trace = (TRACE *)arg;
+  struct timespec nap = {0, TRACE_WRITER_SLEEP * 1000};
+
+  while (1) {
+    uint32_t fill = ringbuffer_rec_fill(trace->ring);
+    if (fill > trace->high_water) trace->high_water = fill;
+    if (fill) {
+      trace_write(trace);
+      continue;
+    }
+    // done is set after the last commit, so an empty ring after it is final
+    if (atomic_load_explicit(&trace->done, memory_order_acquire)) {
+      if (ringbuffer_rec_fill(trace->ring) == 0) break;
+      continue;
+    }
+    nanosleep(&nap, NULL);
+  }
+  return NULL;
+}
+
+
+static uint64_t trace_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
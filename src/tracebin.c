@@ -0,0 +1,264 @@
+#include "include/tracebin.h"
+
+static const char tracebin_magic[8] = "RVTRACE";
+static const char tracebin_index_magic[4] = {'R', 'V', 'T', 'X'};
+
+#define TRACEBIN_HEADER   16
+#define TRACEBIN_TRAILER  24
+
+/* little-endian integers and varints */
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+  return p + 4;
+}
+static uint8_t *put_u64(uint8_t *p, uint64_t v) {
+  return put_u32(put_u32(p, (uint32_t)v), (uint32_t)(v >> 32));
+}
+static uint32_t get_u32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static uint64_t get_u64(const uint8_t *p) {
+  return get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+static inline uint8_t *put_varint(uint8_t *p, uint32_t v) {
+  while (v >= 0x80) {
+    *p++ = v | 0x80;
+    v >>= 7;
+  }
+  *p++ = v;
+  return p;
+}
+/* delta of two values as a varint, small in both directions */
+static inline uint8_t *put_delta(uint8_t *p, uint32_t v, uint32_t prev) {
+  int32_t d = (int32_t)(v - prev);
+  return put_varint(p, ((uint32_t)d << 1) ^ (uint32_t)(d >> 31));
+}
+/* NULL when the varint runs past end */
+static inline const uint8_t *get_delta(const uint8_t *p, const uint8_t *end, uint32_t *v) {
+  uint32_t u = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (p == end) return NULL;
+    uint8_t b = *p++;
+    u |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *v += (u >> 1) ^ -(u & 1);
+      return p;
+    }
+  }
+  return NULL;
+}
+
+
+int tracebin_create(TRACEBIN *tb, FILE *file) {
+  uint8_t header[TRACEBIN_HEADER];
+
+  if (tb == NULL) return -1;
+
+  tb->buf = (uint8_t *)malloc(TRACEBIN_BLOCK_RECORDS * TRACEBIN_MAX_RECORD);
+  tb->max_blocks = 64;
+  tb->index = (TRACEBIN_INDEX *)malloc(tb->max_blocks * sizeof(TRACEBIN_INDEX));
+  if (tb->buf == NULL || tb->index == NULL) {
+    free(tb->buf);
+    free(tb->index);
+    return -2;
+  }
+  tb->file = file;
+  tb->len = 0;
+  tb->count = 0;
+  tb->records = 0;
+  tb->num_blocks = 0;
+  memset(&tb->state, 0, sizeof(tb->state));
+
+  memcpy(header, tracebin_magic, 8);
+  put_u32(put_u32(header + 8, TRACEBIN_VERSION), TRACEBIN_BLOCK_RECORDS);
+  fwrite(header, 1, sizeof(header), file);
+  tb->offset = sizeof(header);
+  return 0;
+}
+
+
+/* write the block being built and start a new one */
+static void tracebin_flush(TRACEBIN *tb) {
+  uint8_t header[8];
+
+  if (tb->count == 0) return;
+  if (tb->num_blocks == tb->max_blocks) {
+    TRACEBIN_INDEX *index = (TRACEBIN_INDEX *)realloc(tb->index, 2 * tb->max_blocks * sizeof(TRACEBIN_INDEX));
+    if (index) {
+      tb->index = index;
+      tb->max_blocks *= 2;
+    }
+  }
+  if (tb->num_blocks < tb->max_blocks) {
+    tb->index[tb->num_blocks].offset = tb->offset;
+    tb->index[tb->num_blocks].first = tb->records;
+    tb->num_blocks++;
+  }
+  put_u32(put_u32(header, tb->len), tb->count);
+  fwrite(header, 1, sizeof(header), tb->file);
+  fwrite(tb->buf, 1, tb->len, tb->file);
+  tb->offset += sizeof(header) + tb->len;
+  tb->records += tb->count;
+  tb->len = 0;
+  tb->count = 0;
+  memset(&tb->state, 0, sizeof(tb->state));
+}
+
+
+void tracebin_put(TRACEBIN *tb, const RLOG *rec) {
+  TRACEBIN_STATE *st = &tb->state;
+  uint8_t *start = tb->buf + tb->len;
+  uint8_t *p = start + 5;
+  uint8_t flags = 0;
+  uint32_t inst = rec->h_inst;
+  uint32_t rd = (inst >> 7) & 0x1F, rs1 = (inst >> 15) & 0x1F, rs2 = (inst >> 20) & 0x1F;
+
+  if (rec->h_pc != st->pc + 4) {
+    flags |= TRACEBIN_PC;
+    p = put_delta(p, rec->h_pc, st->pc + 4);
+  }
+  st->pc = rec->h_pc;
+  // sources are read before the instruction writes rd, same order when decoding
+  if (rec->h_rs1 != st->regs[rs1]) {
+    flags |= TRACEBIN_RS1;
+    p = put_delta(p, rec->h_rs1, st->regs[rs1]);
+    st->regs[rs1] = rec->h_rs1;
+  }
+  if (rec->h_rs2 != st->regs[rs2]) {
+    flags |= TRACEBIN_RS2;
+    p = put_delta(p, rec->h_rs2, st->regs[rs2]);
+    st->regs[rs2] = rec->h_rs2;
+  }
+  if (rec->h_rd != st->regs[rd]) {
+    flags |= TRACEBIN_RD;
+    p = put_delta(p, rec->h_rd, st->regs[rd]);
+    st->regs[rd] = rec->h_rd;
+  }
+  start[0] = flags;
+  put_u32(start + 1, inst);
+  tb->len += p - start;
+  if (++tb->count == TRACEBIN_BLOCK_RECORDS) tracebin_flush(tb);
+}
+
+
+void tracebin_close(TRACEBIN *tb) {
+  uint8_t entry[16], trailer[TRACEBIN_TRAILER];
+
+  tracebin_flush(tb);
+  for (uint32_t i = 0; i < tb->num_blocks; i++) {
+    put_u64(put_u64(entry, tb->index[i].offset), tb->index[i].first);
+    fwrite(entry, 1, sizeof(entry), tb->file);
+  }
+  put_u32(put_u64(put_u64(trailer, tb->offset), tb->records), tb->num_blocks);
+  memcpy(trailer + 20, tracebin_index_magic, 4);
+  fwrite(trailer, 1, sizeof(trailer), tb->file);
+  free(tb->buf);
+  free(tb->index);
+  tb->buf = NULL;
+  tb->index = NULL;
+}
+
+
+int tracebin_open(TRACEBIN_READER *rd, FILE *file) {
+  uint8_t header[TRACEBIN_HEADER], trailer[TRACEBIN_TRAILER], entry[16];
+
+  if (rd == NULL) return -1;
+  memset(rd, 0, sizeof(*rd));
+  rd->file = file;
+
+  if (fseek(file, 0, SEEK_SET) != 0 || fread(header, 1, sizeof(header), file) != sizeof(header)) return -3;
+  if (memcmp(header, tracebin_magic, 8) != 0 || get_u32(header + 8) != TRACEBIN_VERSION) return -3;
+  if (fseek(file, -TRACEBIN_TRAILER, SEEK_END) != 0 || fread(trailer, 1, sizeof(trailer), file) != sizeof(trailer)) return -3;
+  if (memcmp(trailer + 20, tracebin_index_magic, 4) != 0) return -3;
+
+  rd->records = get_u64(trailer + 8);
+  rd->num_blocks = get_u32(trailer + 16);
+  rd->index = (TRACEBIN_INDEX *)malloc((rd->num_blocks ? rd->num_blocks : 1) * sizeof(TRACEBIN_INDEX));
+  rd->buf = (uint8_t *)malloc(TRACEBIN_BLOCK_RECORDS * TRACEBIN_MAX_RECORD);
+  if (rd->index == NULL || rd->buf == NULL) return -2;
+  if (fseek(file, (long)get_u64(trailer), SEEK_SET) != 0) return -3;
+  for (uint32_t i = 0; i < rd->num_blocks; i++) {
+    if (fread(entry, 1, sizeof(entry), file) != sizeof(entry)) return -3;
+    rd->index[i].offset = get_u64(entry);
+    rd->index[i].first = get_u64(entry + 8);
+  }
+  return tracebin_seek(rd, 0);
+}
+
+
+/* load block number b of the index */
+static int tracebin_load(TRACEBIN_READER *rd, uint32_t b) {
+  uint8_t header[8];
+
+  if (fseek(rd->file, (long)rd->index[b].offset, SEEK_SET) != 0) return -3;
+  if (fread(header, 1, sizeof(header), rd->file) != sizeof(header)) return -3;
+  rd->len = get_u32(header);
+  rd->left = get_u32(header + 4);
+  if (rd->len > TRACEBIN_BLOCK_RECORDS * TRACEBIN_MAX_RECORD || rd->left > TRACEBIN_BLOCK_RECORDS) return -3;
+  if (fread(rd->buf, 1, rd->len, rd->file) != rd->len) return -3;
+  rd->pos = 0;
+  rd->block = b + 1;
+  memset(&rd->state, 0, sizeof(rd->state));
+  return 0;
+}
+
+
+int tracebin_seek(TRACEBIN_READER *rd, uint64_t record) {
+  RLOG rec;
+  uint32_t b = 0;
+
+  rd->left = 0;
+  rd->block = 0;
+  if (record >= rd->records) {
+    rd->block = rd->num_blocks;
+    return 0;
+  }
+  // last block starting at or before the record, then decode up to it
+  while (b + 1 < rd->num_blocks && rd->index[b + 1].first <= record) b++;
+  if (tracebin_load(rd, b) != 0) return -3;
+  for (uint64_t n = rd->index[b].first; n < record; n++)
+    if (tracebin_next(rd, &rec) != 1) return -3;
+  return 0;
+}
+
+
+int tracebin_next(TRACEBIN_READER *rd, RLOG *rec) {
+  TRACEBIN_STATE *st = &rd->state;
+  const uint8_t *p, *end;
+
+  while (rd->left == 0) {
+    if (rd->block >= rd->num_blocks) return 0;
+    if (tracebin_load(rd, rd->block) != 0) return -3;
+  }
+  p = rd->buf + rd->pos;
+  end = rd->buf + rd->len;
+  if (end - p < 5) return -3;
+
+  uint8_t flags = p[0];
+  uint32_t inst = get_u32(p + 1);
+  uint32_t rd_ = (inst >> 7) & 0x1F, rs1 = (inst >> 15) & 0x1F, rs2 = (inst >> 20) & 0x1F;
+  p += 5;
+  st->pc += 4;
+  if ((flags & TRACEBIN_PC) && !(p = get_delta(p, end, &st->pc))) return -3;
+  if ((flags & TRACEBIN_RS1) && !(p = get_delta(p, end, &st->regs[rs1]))) return -3;
+  rec->h_rs1 = st->regs[rs1];
+  if ((flags & TRACEBIN_RS2) && !(p = get_delta(p, end, &st->regs[rs2]))) return -3;
+  rec->h_rs2 = st->regs[rs2];
+  if ((flags & TRACEBIN_RD) && !(p = get_delta(p, end, &st->regs[rd_]))) return -3;
+  rec->h_rd = st->regs[rd_];
+  rec->h_pc = st->pc;
+  rec->h_inst = inst;
+
+  rd->pos = p - rd->buf;
+  rd->left--;
+  return 1;
+}
+
+
+void tracebin_dispose(TRACEBIN_READER *rd) {
+
+  free(rd->buf);
+  free(rd->index);
+  rd->buf = NULL;
+  rd->index = NULL;
+}
@@ -0,0 +1,54 @@
+# Hot loop over every instruction the JIT compiles, stores and loads of each
+# width, a misaligned load and a write to x0. Ends by jumping to 0.
+  li s0, 300
+  lui s1, 0x7c0
+  li a0, -7
+  li a1, 13
+loop:
+  add a2, a0, a1
+  sub a3, a0, a1
+  mul a4, a2, a3
+  xor a5, a4, a0
+  or a6, a5, a1
+  and a7, a6, a4
+  addi t0, a7, -100
+  xori t1, t0, 0x555
+  ori t2, t1, -256
+  andi t3, t2, 0x7f
+  sw a4, 0(s1)
+  sh a5, 4(s1)
+  sb a6, 7(s1)
+  lw t4, 0(s1)
+  lh t5, 4(s1)
+  lhu t6, 4(s1)
+  lb s2, 7(s1)
+  lbu s3, 7(s1)
+  lw s4, 2(s1)       # misaligned
+  auipc s5, 3
+  lui s6, 0xfffff
+  add a0, a0, t4
+  xor a1, a1, s2
+  blt a0, a1, b1
+  addi s7, s7, 1
+b1:
+  bge a0, a1, b2
+  addi s8, s8, 1
+b2:
+  bltu a0, a1, b3
+  addi s9, s9, 1
+b3:
+  bgeu a0, a1, b4
+  addi s10, s10, 1
+b4:
+  beq a0, a1, b5
+  addi s11, s11, 1
+b5:
+  jal ra, fn
+  addi s0, s0, -1
+  bne s0, zero, loop
+  li t6, 0
+  jalr x0, 0(t6)
+fn:
+  addi x0, ra, 4      # write to x0
+  add gp, gp, a0
+  jalr x0, 0(ra)
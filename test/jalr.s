@@ -0,0 +1,14 @@
+# JALR reads rs1 before it writes rd: "jalr ra, 16(ra)" jumps to the ra of the
+# auipc plus 16. Writes to x0 are dropped and logged as zero. The exit code is 2.
+  auipc ra, 0
+  jalr ra, 16(ra)
+  li a0, 1
+  j exit
+  li a0, 2                  # ra + 16
+  add x0, ra, ra
+  auipc t0, 0
+  add t0, t0, x0
+  jalr x0, 12(t0)           # to exit
+exit:
+  li a7, 93
+  ecall
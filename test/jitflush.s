@@ -0,0 +1,585 @@
+# More hot blocks than a 16K JIT code buffer holds, run with --jit-code=16K so
+# the buffer is flushed again and again. Ends by jumping to 0.
+  li s0, 20
+  lui s1, 0x7c0
+loop:
+  addi a0, a0, 1
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 0(s1)
+  lw a4, 12(s1)
+  add a5, a5, a4
+  beq zero, zero, b0
+b0:
+  addi a0, a0, 2
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 4(s1)
+  lw a4, 16(s1)
+  add a5, a5, a4
+  beq zero, zero, b1
+b1:
+  addi a0, a0, 3
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 8(s1)
+  lw a4, 20(s1)
+  add a5, a5, a4
+  beq zero, zero, b2
+b2:
+  addi a0, a0, 4
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 12(s1)
+  lw a4, 24(s1)
+  add a5, a5, a4
+  beq zero, zero, b3
+b3:
+  addi a0, a0, 5
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 16(s1)
+  lw a4, 28(s1)
+  add a5, a5, a4
+  beq zero, zero, b4
+b4:
+  addi a0, a0, 6
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 20(s1)
+  lw a4, 0(s1)
+  add a5, a5, a4
+  beq zero, zero, b5
+b5:
+  addi a0, a0, 7
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 24(s1)
+  lw a4, 4(s1)
+  add a5, a5, a4
+  beq zero, zero, b6
+b6:
+  addi a0, a0, 8
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 28(s1)
+  lw a4, 8(s1)
+  add a5, a5, a4
+  beq zero, zero, b7
+b7:
+  addi a0, a0, 9
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 0(s1)
+  lw a4, 12(s1)
+  add a5, a5, a4
+  beq zero, zero, b8
+b8:
+  addi a0, a0, 10
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 4(s1)
+  lw a4, 16(s1)
+  add a5, a5, a4
+  beq zero, zero, b9
+b9:
+  addi a0, a0, 11
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 8(s1)
+  lw a4, 20(s1)
+  add a5, a5, a4
+  beq zero, zero, b10
+b10:
+  addi a0, a0, 12
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 12(s1)
+  lw a4, 24(s1)
+  add a5, a5, a4
+  beq zero, zero, b11
+b11:
+  addi a0, a0, 13
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 16(s1)
+  lw a4, 28(s1)
+  add a5, a5, a4
+  beq zero, zero, b12
+b12:
+  addi a0, a0, 14
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 20(s1)
+  lw a4, 0(s1)
+  add a5, a5, a4
+  beq zero, zero, b13
+b13:
+  addi a0, a0, 15
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 24(s1)
+  lw a4, 4(s1)
+  add a5, a5, a4
+  beq zero, zero, b14
+b14:
+  addi a0, a0, 16
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 28(s1)
+  lw a4, 8(s1)
+  add a5, a5, a4
+  beq zero, zero, b15
+b15:
+  addi a0, a0, 17
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 0(s1)
+  lw a4, 12(s1)
+  add a5, a5, a4
+  beq zero, zero, b16
+b16:
+  addi a0, a0, 18
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 4(s1)
+  lw a4, 16(s1)
+  add a5, a5, a4
+  beq zero, zero, b17
+b17:
+  addi a0, a0, 19
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 8(s1)
+  lw a4, 20(s1)
+  add a5, a5, a4
+  beq zero, zero, b18
+b18:
+  addi a0, a0, 20
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 12(s1)
+  lw a4, 24(s1)
+  add a5, a5, a4
+  beq zero, zero, b19
+b19:
+  addi a0, a0, 21
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 16(s1)
+  lw a4, 28(s1)
+  add a5, a5, a4
+  beq zero, zero, b20
+b20:
+  addi a0, a0, 22
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 20(s1)
+  lw a4, 0(s1)
+  add a5, a5, a4
+  beq zero, zero, b21
+b21:
+  addi a0, a0, 23
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 24(s1)
+  lw a4, 4(s1)
+  add a5, a5, a4
+  beq zero, zero, b22
+b22:
+  addi a0, a0, 24
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 28(s1)
+  lw a4, 8(s1)
+  add a5, a5, a4
+  beq zero, zero, b23
+b23:
+  addi a0, a0, 25
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 0(s1)
+  lw a4, 12(s1)
+  add a5, a5, a4
+  beq zero, zero, b24
+b24:
+  addi a0, a0, 26
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 4(s1)
+  lw a4, 16(s1)
+  add a5, a5, a4
+  beq zero, zero, b25
+b25:
+  addi a0, a0, 27
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 8(s1)
+  lw a4, 20(s1)
+  add a5, a5, a4
+  beq zero, zero, b26
+b26:
+  addi a0, a0, 28
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 12(s1)
+  lw a4, 24(s1)
+  add a5, a5, a4
+  beq zero, zero, b27
+b27:
+  addi a0, a0, 29
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 16(s1)
+  lw a4, 28(s1)
+  add a5, a5, a4
+  beq zero, zero, b28
+b28:
+  addi a0, a0, 30
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 20(s1)
+  lw a4, 0(s1)
+  add a5, a5, a4
+  beq zero, zero, b29
+b29:
+  addi a0, a0, 31
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 24(s1)
+  lw a4, 4(s1)
+  add a5, a5, a4
+  beq zero, zero, b30
+b30:
+  addi a0, a0, 32
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 28(s1)
+  lw a4, 8(s1)
+  add a5, a5, a4
+  beq zero, zero, b31
+b31:
+  addi a0, a0, 33
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 0(s1)
+  lw a4, 12(s1)
+  add a5, a5, a4
+  beq zero, zero, b32
+b32:
+  addi a0, a0, 34
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 4(s1)
+  lw a4, 16(s1)
+  add a5, a5, a4
+  beq zero, zero, b33
+b33:
+  addi a0, a0, 35
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 8(s1)
+  lw a4, 20(s1)
+  add a5, a5, a4
+  beq zero, zero, b34
+b34:
+  addi a0, a0, 36
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 12(s1)
+  lw a4, 24(s1)
+  add a5, a5, a4
+  beq zero, zero, b35
+b35:
+  addi a0, a0, 37
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 16(s1)
+  lw a4, 28(s1)
+  add a5, a5, a4
+  beq zero, zero, b36
+b36:
+  addi a0, a0, 38
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 20(s1)
+  lw a4, 0(s1)
+  add a5, a5, a4
+  beq zero, zero, b37
+b37:
+  addi a0, a0, 39
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 24(s1)
+  lw a4, 4(s1)
+  add a5, a5, a4
+  beq zero, zero, b38
+b38:
+  addi a0, a0, 40
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 28(s1)
+  lw a4, 8(s1)
+  add a5, a5, a4
+  beq zero, zero, b39
+b39:
+  addi a0, a0, 41
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 0(s1)
+  lw a4, 12(s1)
+  add a5, a5, a4
+  beq zero, zero, b40
+b40:
+  addi a0, a0, 42
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 4(s1)
+  lw a4, 16(s1)
+  add a5, a5, a4
+  beq zero, zero, b41
+b41:
+  addi a0, a0, 43
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 8(s1)
+  lw a4, 20(s1)
+  add a5, a5, a4
+  beq zero, zero, b42
+b42:
+  addi a0, a0, 44
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 12(s1)
+  lw a4, 24(s1)
+  add a5, a5, a4
+  beq zero, zero, b43
+b43:
+  addi a0, a0, 45
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 16(s1)
+  lw a4, 28(s1)
+  add a5, a5, a4
+  beq zero, zero, b44
+b44:
+  addi a0, a0, 46
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 20(s1)
+  lw a4, 0(s1)
+  add a5, a5, a4
+  beq zero, zero, b45
+b45:
+  addi a0, a0, 47
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 24(s1)
+  lw a4, 4(s1)
+  add a5, a5, a4
+  beq zero, zero, b46
+b46:
+  addi a0, a0, 48
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 28(s1)
+  lw a4, 8(s1)
+  add a5, a5, a4
+  beq zero, zero, b47
+b47:
+  addi a0, a0, 49
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 0(s1)
+  lw a4, 12(s1)
+  add a5, a5, a4
+  beq zero, zero, b48
+b48:
+  addi a0, a0, 50
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 4(s1)
+  lw a4, 16(s1)
+  add a5, a5, a4
+  beq zero, zero, b49
+b49:
+  addi a0, a0, 51
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 8(s1)
+  lw a4, 20(s1)
+  add a5, a5, a4
+  beq zero, zero, b50
+b50:
+  addi a0, a0, 52
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 12(s1)
+  lw a4, 24(s1)
+  add a5, a5, a4
+  beq zero, zero, b51
+b51:
+  addi a0, a0, 53
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 16(s1)
+  lw a4, 28(s1)
+  add a5, a5, a4
+  beq zero, zero, b52
+b52:
+  addi a0, a0, 54
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 20(s1)
+  lw a4, 0(s1)
+  add a5, a5, a4
+  beq zero, zero, b53
+b53:
+  addi a0, a0, 55
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 24(s1)
+  lw a4, 4(s1)
+  add a5, a5, a4
+  beq zero, zero, b54
+b54:
+  addi a0, a0, 56
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 28(s1)
+  lw a4, 8(s1)
+  add a5, a5, a4
+  beq zero, zero, b55
+b55:
+  addi a0, a0, 57
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 0(s1)
+  lw a4, 12(s1)
+  add a5, a5, a4
+  beq zero, zero, b56
+b56:
+  addi a0, a0, 58
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 4(s1)
+  lw a4, 16(s1)
+  add a5, a5, a4
+  beq zero, zero, b57
+b57:
+  addi a0, a0, 59
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 8(s1)
+  lw a4, 20(s1)
+  add a5, a5, a4
+  beq zero, zero, b58
+b58:
+  addi a0, a0, 60
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 12(s1)
+  lw a4, 24(s1)
+  add a5, a5, a4
+  beq zero, zero, b59
+b59:
+  addi a0, a0, 61
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 16(s1)
+  lw a4, 28(s1)
+  add a5, a5, a4
+  beq zero, zero, b60
+b60:
+  addi a0, a0, 62
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 20(s1)
+  lw a4, 0(s1)
+  add a5, a5, a4
+  beq zero, zero, b61
+b61:
+  addi a0, a0, 63
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 24(s1)
+  lw a4, 4(s1)
+  add a5, a5, a4
+  beq zero, zero, b62
+b62:
+  addi a0, a0, 64
+  xor a1, a1, a0
+  add a2, a2, a1
+  mul a3, a2, a0
+  sw a3, 28(s1)
+  lw a4, 8(s1)
+  add a5, a5, a4
+  beq zero, zero, b63
+b63:
+  addi s0, s0, -1
+  bne s0, zero, loop
+  li t6, 0
+  jalr x0, 0(t6)
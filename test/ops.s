@@ -0,0 +1,54 @@
+# Every instruction the simulator implements, and two it does not (slli, sll) that
+# run as no-ops. Ends by jumping to 0.
+  addi sp, sp, -16
+  lui t0, 0x12345
+  addi t0, t0, 0x678
+  auipc t1, 1
+  xori t2, t0, -1
+  ori t3, t0, 0x0f0
+  andi t4, t0, 0x0ff
+  slli t5, t0, 3         # not implemented, a no-op
+  add a0, t0, t2
+  sub a1, t0, t3
+  mul a2, t0, t4
+  xor a3, a0, a1
+  or a4, a0, a1
+  and a5, a0, a1
+  sll a6, a0, a1         # not implemented, a no-op
+  sw t0, 0(sp)
+  sh t0, 4(sp)
+  sb t0, 6(sp)
+  lw s1, 0(sp)
+  lh s2, 4(sp)
+  lhu s3, 4(sp)
+  lb s4, 6(sp)
+  lbu s5, 0(sp)
+  li a0, 3
+loop:
+  addi a0, a0, -1
+  bne a0, zero, loop
+  li a1, -5
+  li a2, 7
+  blt a1, a2, l1
+  nop
+l1:
+  bge a2, a1, l2
+  nop
+l2:
+  bltu a2, a1, l3
+  nop
+l3:
+  bgeu a1, a2, l4
+  nop
+l4:
+  beq a1, a1, l5
+  nop
+l5:
+  jal f
+  j over
+  nop
+f:
+  addi x0, x0, 5
+  ret
+over:
+  jalr x0, 0(zero)
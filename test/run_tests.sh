@@ -0,0 +1,88 @@
+#!/bin/sh
+
+# Runs every test/*.bin on each engine and compares the exit code, the output
+# and log.txt with the switch engine, runs the native blocks against the
+# interpreter (--jit-check), and decodes the binary trace back with trace2log.
+# Run it from anywhere after ./compile.sh; the .s sources are next to each .bin.
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+SIM=$ROOT/riscv_sim
+TRACE2LOG=$ROOT/trace2log
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+fails=0
+
+fail() {
+  echo "FAIL $name: $1"
+  fails=$((fails + 1))
+}
+
+for bin in "$ROOT"/test/*.bin; do
+  name=$(basename "$bin" .bin)
+  before=$fails
+  mkdir "$WORK/$name" && cd "$WORK/$name" || exit 1
+
+  "$SIM" --engine=switch "$bin" </dev/null >switch.out
+  code=$?
+  mv log.txt switch.log
+
+  for engine in predecode threaded block; do
+    "$SIM" --engine=$engine "$bin" </dev/null >$engine.out
+    rc=$?
+    [ $rc -eq $code ] || fail "$engine exit code $rc, switch $code"
+    cmp -s $engine.out switch.out || fail "$engine output differs from switch"
+    cmp -s log.txt switch.log || fail "$engine log.txt differs from switch"
+  done
+
+  # native blocks only run without log, each one is compared with the interpreter
+  "$SIM" --jit --jit-check --jit-threshold=2 --no-log --stats "$bin" </dev/null >jit.out 2>jit.err
+  rc=$?
+  if grep -q "JIT not available" jit.err; then
+    echo "skip $name: JIT not available on this host"
+  else
+    [ $rc -eq $code ] || fail "jit-check exit code $rc, switch $code"
+    cmp -s jit.out switch.out || fail "jit-check output differs from switch"
+    grep -q "(0 mismatches)" jit.err || fail "native blocks differ from the interpreter"
+    "$SIM" --jit --jit-threshold=2 --no-log "$bin" </dev/null >jit.out
+    rc=$?
+    [ $rc -eq $code ] || fail "jit exit code $rc, switch $code"
+    cmp -s jit.out switch.out || fail "jit output differs from switch"
+  fi
+
+  # binary trace decoded back to the same log.txt
+  "$SIM" --log-format=bin "$bin" </dev/null >/dev/null
+  if "$TRACE2LOG" log.bin trace.txt >/dev/null; then
+    cmp -s trace.txt switch.log || fail "trace2log of log.bin differs from log.txt"
+  else
+    fail "trace2log can not decode log.bin"
+  fi
+
+  [ $fails -eq $before ] && echo "ok   $name (exit code $code)"
+done
+
+# a full JIT code buffer is flushed and the hot blocks are compiled again after it
+name=jitflush
+cd "$WORK" || exit 1
+"$SIM" --jit --jit-threshold=2 --jit-code=16K --log=off --stats "$ROOT/test/jitflush.bin" </dev/null >/dev/null 2>jit.err
+if ! grep -q "JIT not available" jit.err; then
+  flushes=$(sed -n 's/^jit blocks compiled: .*rejected, \([0-9]*\) flushes.*/\1/p' jit.err)
+  if [ "${flushes:-0}" -ge 2 ]; then
+    echo "ok   $name ($flushes flushes)"
+  else
+    fail "no block compiled after the code buffer was flushed"
+  fi
+fi
+
+# the RAM is whole pages, so the first byte past it faults
+name=ram
+if "$SIM" --ram=5000 --log=off "$ROOT/test/ops.bin" </dev/null >/dev/null 2>&1; then
+  fail "a RAM size that is not a multiple of the page size was accepted"
+else
+  echo "ok   $name (partial page refused)"
+fi
+
+if [ $fails -ne 0 ]; then
+  echo "$fails failures"
+  exit 1
+fi
+echo "all tests passed"
@@ -0,0 +1,44 @@
+# Self-modifying code: stores over instructions of the block running.
+# Every engine must run the instructions stored, the exit code is 86.
+  li s0, 10
+  li s1, 0
+  li s2, 1
+  lui t0, 0x700
+  addi t0, t0, 0x393        # t0 = li t2, 7
+  lui t3, 0x100
+  addi t3, t3, 0x393        # t3 = li t2, 1
+
+# the store overwrites the next instruction, then puts it back
+first:
+  auipc t1, 0
+  addi t1, t1, 12           # first_target
+  sw t0, 0(t1)
+first_target:
+  li t2, 1
+  add s1, s1, t2
+  sw t3, 0(t1)
+  addi s0, s0, -1
+  bne s0, zero, first       # s1 = 70
+
+# a block run many times, native with the JIT, overwrites itself on its last run
+  li s0, 10
+second:
+  bne s0, s2, pick_data
+  auipc t1, 0
+  addi t1, t1, 24           # second_target
+  j store
+pick_data:
+  auipc t1, 0
+  addi t1, t1, 40           # data
+store:
+  sw t0, 0(t1)
+second_target:
+  li t2, 1
+  add s1, s1, t2
+  addi s0, s0, -1
+  bne s0, zero, second      # s1 = 70 + 9 + 7
+  mv a0, s1
+  li a7, 93
+  ecall
+data:
+  .word 0
@@ -0,0 +1,113 @@
+/* Throughput of the log.txt formatting: fprintf per field against logfmt */
+#include "../src/include/common.h"
+#include "../src/include/logfmt.h"
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_RECORDS   (1 << 21)
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the log.txt loop of main.c before logfmt */
+static void print_record(FILE *out, const RLOG *rec) {
+  INST inst;
+  char mne[64];
+  core_decode(rec->h_inst, &inst);
+  core_disasm(rec->h_inst, mne, sizeof(mne));
+  fprintf(out,"PC=%08x\n", rec->h_pc);
+  fprintf(out,"[%08x]\n", rec->h_inst);
+  fprintf(out,"x%02d=%08x\n", inst.rd, rec->h_rd);
+  fprintf(out,"x%02d=%08x\n", inst.rs1, rec->h_rs1);
+  fprintf(out,"x%02d=%08x\n", inst.rs2, rec->h_rs2);
+  fprintf(out,"%s\n", mne);
+}
+
+static void report(const char *name, size_t bytes, double secs) {
+  printf("%-28s %8.1f MB/s  (%.3f s, %zu bytes)\n", name, bytes / secs / 1e6, secs, bytes);
+}
+
+int main(int argc, char *argv[]) {
+  // a loop body worth of instructions, every format of the log
+  static const uint32_t words[] = {
+    0x00000513, 0x00a00593, 0x02b50633, 0x00c6a023, 0x0006a703, 0x00470713, 0xfe0718e3,
+    0x40b50533, 0x0005c683, 0x00d70023, 0x123452b7, 0x00001317, 0x008000ef, 0x00008067,
+    0x00b57463, 0x00f6e6b3, 0x00b54533, 0x0ff57513, 0x00c59603, 0x01061683, 0xffc10113,
+  };
+  uint32_t n = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : BENCH_RECORDS;
+  RLOG *recs = (RLOG *)malloc((size_t)n * sizeof(RLOG));
+  LOGFMT *fmt = (LOGFMT *)malloc(sizeof(LOGFMT));
+  char *text = (char *)malloc((size_t)n * LOGFMT_MAX_RECORD);
+  if (n == 0 || recs == NULL || fmt == NULL || text == NULL) {
+    printf("FAIL to allocate %u records.\n", n);
+    return -1;
+  }
+  uint32_t seed = 12345;
+  for (uint32_t i = 0; i < n; i++) {
+    seed = seed * 1103515245 + 12345;
+    recs[i].h_pc = 4 * (i % 4096) + 4;
+    recs[i].h_inst = words[i % (sizeof(words) / sizeof(words[0]))];
+    recs[i].h_rd = seed;
+    recs[i].h_rs1 = seed >> 7;
+    recs[i].h_rs2 = i;
+  }
+
+  // reference bytes from fprintf, and the time it takes
+  char *ref = NULL;
+  size_t ref_len = 0;
+  FILE *mem = open_memstream(&ref, &ref_len);
+  double t = now();
+  for (uint32_t i = 0; i < n; i++) print_record(mem, &recs[i]);
+  fflush(mem);
+  report("fprintf (memory)", ref_len, now() - t);
+
+  logfmt_init(fmt);
+  t = now();
+  size_t len = 0;
+  for (uint32_t i = 0; i < n; i++) len += logfmt_record(fmt, text + len, &recs[i]);
+  report("logfmt (memory)", len, now() - t);
+  if (len != ref_len || memcmp(text, ref, len) != 0) {
+    printf("logfmt output differs from fprintf\n");
+    return -1;
+  }
+
+  int fd = open("/dev/null", O_WRONLY);
+  LOGFMT_OUT out;
+  if (fd < 0 || logfmt_out_create(&out, fd, LOGFMT_OUT_SIZE) != 0) {
+    printf("FAIL to open /dev/null.\n");
+    return -1;
+  }
+  FILE *null = fdopen(dup(fd), "w");
+  t = now();
+  for (uint32_t i = 0; i < n; i++) print_record(null, &recs[i]);
+  fflush(null);
+  report("fprintf (/dev/null)", ref_len, now() - t);
+  logfmt_init(fmt);
+  t = now();
+  for (uint32_t i = 0; i < n; i++) logfmt_out_put(&out, fmt, &recs[i]);
+  logfmt_out_flush(&out);
+  report("logfmt + write (/dev/null)", len, now() - t);
+
+  char hex[8];
+  uint32_t sink = 0;
+  t = now();
+  for (uint32_t i = 0; i < n * 4; i++) {
+    logfmt_hex8(hex, i * 2654435761u);
+    sink += hex[i & 7];
+  }
+  report("logfmt_hex8", (size_t)n * 4 * 8, now() - t);
+
+  logfmt_out_dispose(&out);
+  fclose(null);
+  close(fd);
+  fclose(mem);
+  free(ref);
+  free(text);
+  free(fmt);
+  free(recs);
+  return sink == 0xFFFFFFFF;
+}
@@ -0,0 +1,90 @@
+/* Cost per guest access: the size switch over byte accesses against the width accessors */
+#include "../src/include/common.h"
+#include "../src/include/mem.h"
+#include <time.h>
+
+#define BENCH_ACCESSES  (1 << 26)
+#define BENCH_RAM       (1 << 20)
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the accessors of mem.c before the width accessors, called from another file like core.c did */
+__attribute__((noinline)) static uint32_t old_load(uint8_t *mem, uint32_t addr, uint8_t size) {
+  switch (size) {
+  case 8:  return (uint32_t)mem[addr];
+  case 16: return (uint32_t)mem[addr] | ((uint32_t)mem[addr + 1] << 8);
+  case 32: return (uint32_t)mem[addr] | ((uint32_t)mem[addr + 1] << 8) |
+                  ((uint32_t)mem[addr + 2] << 16) | ((uint32_t)mem[addr + 3] << 24);
+  default: ;
+  }
+  return 0;
+}
+
+__attribute__((noinline)) static void old_store(uint8_t *mem, uint32_t addr, uint32_t value, uint8_t size) {
+  switch (size) {
+  case 8:  mem[addr] = (uint8_t)value; break;
+  case 16: mem[addr] = (uint8_t)value; mem[addr + 1] = (uint8_t)(value >> 8); break;
+  case 32: mem[addr] = (uint8_t)value; mem[addr + 1] = (uint8_t)(value >> 8);
+           mem[addr + 2] = (uint8_t)(value >> 16); mem[addr + 3] = (uint8_t)(value >> 24); break;
+  default: ;
+  }
+}
+
+static void report(const char *name, uint32_t n, double secs) {
+  printf("%-28s %6.2f ns/access  (%.3f s)\n", name, secs * 1e9 / n, secs);
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t n = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : BENCH_ACCESSES;
+  uint8_t *ram = (uint8_t *)calloc(BENCH_RAM + 4, 1);
+  if (n == 0 || ram == NULL) {
+    printf("FAIL to allocate the RAM.\n");
+    return -1;
+  }
+  // the same address stream for every run: word, half and byte accesses, some unaligned
+  static const uint8_t sizes[8] = {32, 32, 8, 32, 16, 32, 8, 32};
+  uint32_t sum = 0, addr, seed;
+  double t;
+
+#define BENCH_LOOP(body) \
+  seed = 12345; \
+  t = now(); \
+  for (uint32_t i = 0; i < n; i++) { \
+    seed = seed * 1103515245 + 12345; \
+    addr = (seed >> 8) & (BENCH_RAM - 1); \
+    uint8_t size = sizes[i & 7]; \
+    (void)size; \
+    body; \
+  }
+
+  BENCH_LOOP(old_store(ram, addr, seed, size));
+  report("size switch store", n, now() - t);
+  BENCH_LOOP(sum += old_load(ram, addr, size));
+  report("size switch load", n, now() - t);
+
+  // width chosen per access like a decoded instruction does, one call per width
+  BENCH_LOOP(switch (i & 7) {
+    case 2: case 6: ram_store8(ram, addr, seed); break;
+    case 4: ram_store16(ram, addr, seed); break;
+    default: ram_store32(ram, addr, seed);
+  });
+  report("width accessor store", n, now() - t);
+  uint32_t check = 0;
+  BENCH_LOOP(switch (i & 7) {
+    case 2: case 6: check += ram_load8(ram, addr); break;
+    case 4: check += ram_load16(ram, addr); break;
+    default: check += ram_load32(ram, addr);
+  });
+  report("width accessor load", n, now() - t);
+
+  if (check != sum) {
+    printf("width accessors read other values than the size switch\n");
+    return -1;
+  }
+  free(ram);
+  return 0;
+}
@@ -0,0 +1,120 @@
+/* Convert a binary trace (--log-format=bin) to the log.txt layout */
+#include "../src/include/common.h"
+#include "../src/include/logfmt.h"
+#include "../src/include/logpar.h"
+#include "../src/include/tracebin.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+#define TRACE2LOG_WINDOW  (1 << 22)     // records decoded before formatting them in parallel
+
+static void usage(const char *prog) {
+  printf("usage: %s [--from=N] [--count=N] [--threads=N] log.bin [log.txt]\n", prog);
+  printf("  --from=N    first instruction to print, 0 is the first one (default 0)\n");
+  printf("  --count=N   instructions to print (default all)\n");
+  printf("  --threads=N threads formatting a seekable output (default one per CPU)\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *in_path = NULL, *out_path = NULL;
+  uint64_t from = 0, count = UINT64_MAX;
+  int threads = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    char *end;
+    if (strncmp(arg, "--from=", 7) == 0) {
+      from = strtoull(arg + 7, &end, 0);
+      if (arg[7] == 0 || *end != 0) { usage(argv[0]); return -1; }
+    } else if (strncmp(arg, "--count=", 8) == 0) {
+      count = strtoull(arg + 8, &end, 0);
+      if (arg[8] == 0 || *end != 0) { usage(argv[0]); return -1; }
+    } else if (strncmp(arg, "--threads=", 10) == 0) {
+      threads = strtol(arg + 10, &end, 0);
+      if (arg[10] == 0 || *end != 0 || threads < 0) { usage(argv[0]); return -1; }
+    } else if (strncmp(arg, "--", 2) == 0) {
+      usage(argv[0]);
+      return -1;
+    } else if (in_path == NULL) {
+      in_path = arg;
+    } else if (out_path == NULL) {
+      out_path = arg;
+    } else {
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (in_path == NULL) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  FILE *in = fopen(in_path, "rb");
+  if (!in) {
+    printf("FAIL to open the file.\n");
+    return -1;
+  }
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    printf("FAIL to open the output file.\n");
+    fclose(in);
+    return -1;
+  }
+
+  TRACEBIN_READER rd;
+  LOGFMT *fmt = (LOGFMT *)malloc(sizeof(LOGFMT));
+  RLOG *recs = (RLOG *)malloc(TRACE2LOG_WINDOW * sizeof(RLOG));
+  LOGFMT_OUT text;
+  if (fmt == NULL || recs == NULL || logfmt_out_create(&text, fileno(out), LOGFMT_OUT_SIZE) != 0) {
+    printf("FAIL to allocate the output buffer.\n");
+    return -1;
+  }
+  logfmt_init(fmt);
+
+  // a seekable output is written in place by a LOGPAR pool, a pipe or
+  // a file in append mode (pwrite ignores the offset) one record after the other
+  off_t pos = lseek(fileno(out), 0, SEEK_CUR);
+  LOGPAR *pool = NULL;
+  if (pos >= 0 && threads != 1 && !(fcntl(fileno(out), F_GETFL) & O_APPEND)) {
+    pool = (LOGPAR *)malloc(sizeof(LOGPAR));
+    if (pool && logpar_create(pool, threads) != 0) {
+      free(pool);
+      pool = NULL;
+    }
+    if (pool && pool->num_threads == 1) {
+      logpar_dispose(pool);
+      pool = NULL;
+    }
+  }
+
+  int err = tracebin_open(&rd, in);
+  if (err == 0) err = tracebin_seek(&rd, from);
+  while (err == 0 && count) {
+    size_t n = 0;
+    int r = 1;
+    while (n < TRACE2LOG_WINDOW && n < count && (r = tracebin_next(&rd, &recs[n])) == 1) n++;
+    count -= n;
+    if (pool) {
+      int64_t bytes = logpar_write(pool, fileno(out), pos, recs, n);
+      if (bytes < 0) err = -1;
+      else pos += bytes;
+    } else {
+      for (size_t i = 0; i < n; i++) logfmt_out_put(&text, fmt, &recs[i]);
+    }
+    if (r <= 0) {
+      err = r;
+      break;
+    }
+  }
+  logfmt_out_dispose(&text);
+  if (text.error) err = -1;
+  if (err != 0) fprintf(stderr, "Bad binary trace: %s\n", in_path);
+
+  if (pool) logpar_dispose(pool);
+  tracebin_dispose(&rd);
+  free(recs);
+  free(fmt);
+  fclose(in);
+  if (out != stdout) fclose(out);
+  return err != 0 ? -1 : 0;
+}